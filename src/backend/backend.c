@@ -0,0 +1,238 @@
+#include "control_protocol.h"
+#include "log.h"
+#include "metrics.h"
+#include "snapshot.h"
+#include "sources.h"
+#include "state_export.h"
+#include "trace.h"
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib-unix.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <signal.h>
+
+/*
+ * cwidgets-backend, for the split mode of cWidgets: owns the connections to
+ * UPower, PipeWire, NetworkManager, BlueZ and hyprland without GTK, and
+ * publishes what they report through the shared state of state_export.c.
+ * The bar of a cWidgets started with CWIDGETS_BACKEND=1 only renders it, so
+ * restarting the bar does not connect to those backends again, and any number
+ * of UIs share one set of connections.
+ *
+ * The socket on $XDG_RUNTIME_DIR/cwidgets/backend.sock only wakes the UIs up.
+ * Every client gets a CONTROL_STATE_CHANGED frame when it connects and after
+ * every change, then reads the state from the mapping. Changes within one
+ * main loop iteration go out as one frame. The frames are a few bytes, so a
+ * client whose socket is full is not reading at all and is dropped, it reads
+ * the whole state again once it reconnects.
+ */
+typedef struct {
+  GSocket *socket;
+  GSource *source;
+} BackendClient;
+
+typedef struct {
+  GSocket *listener;
+  GSource *source;
+  gchar *path;
+  GPtrArray *clients; // BackendClient
+  // SnapshotField changed since the last frame
+  guint32 pending_fields;
+  guint notify_id;
+} BackendServer;
+
+static BackendServer server = {0};
+
+static void client_free(gpointer data) {
+  BackendClient *client = data;
+  g_source_destroy(client->source);
+  g_source_unref(client->source);
+  g_socket_close(client->socket, NULL);
+  g_object_unref(client->socket);
+  g_free(client);
+}
+
+static void client_drop(BackendClient *client) {
+  g_ptr_array_remove(server.clients, client);
+}
+
+// Returns FALSE if the client has to be dropped
+static gboolean client_send(BackendClient *client, guint32 fields) {
+  g_autofree gchar *arg = g_strdup_printf("%u", fields);
+  g_autoptr(GByteArray) frame = g_byte_array_new();
+  control_frame_append(frame, CONTROL_STATE_CHANGED,
+                       (const gchar *const[]){arg, NULL});
+  gssize sent = g_socket_send(client->socket, (gchar *)frame->data,
+                              frame->len, NULL, NULL);
+  return sent == (gssize)frame->len;
+}
+
+// Clients send nothing, so this is the end of the connection
+static gboolean on_client_readable(GSocket *socket, GIOCondition condition,
+                                   gpointer user_data) {
+  // Destroys this source too
+  client_drop(user_data);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean on_listener_readable(GSocket *listener, GIOCondition condition,
+                                     gpointer user_data) {
+  while (TRUE) {
+    GError *error = NULL;
+    GSocket *socket = g_socket_accept(listener, NULL, &error);
+    if (!socket) {
+      if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+        g_warning("Backend: could not accept: %s", error->message);
+      g_error_free(error);
+      return G_SOURCE_CONTINUE;
+    }
+
+    g_socket_set_blocking(socket, FALSE);
+    BackendClient *client = g_new0(BackendClient, 1);
+    client->socket = socket;
+    client->source =
+        g_socket_create_source(socket, G_IO_IN | G_IO_HUP | G_IO_ERR, NULL);
+    g_source_set_name(client->source, "backend-client");
+    g_source_set_callback(client->source, G_SOURCE_FUNC(on_client_readable),
+                          client, NULL);
+    g_source_attach(client->source, NULL);
+    g_ptr_array_add(server.clients, client);
+
+    // Everything known is new to it
+    if (!client_send(client, snapshot_get()->known))
+      client_drop(client);
+  }
+}
+
+static gboolean on_notify(gpointer user_data) {
+  server.notify_id = 0;
+  guint32 fields = server.pending_fields;
+  server.pending_fields = 0;
+
+  // Backwards, dropping a client removes it
+  for (guint i = server.clients->len; i-- > 0;) {
+    BackendClient *client = g_ptr_array_index(server.clients, i);
+    if (!client_send(client, fields)) {
+      g_message("Backend: dropping a client that does not read");
+      client_drop(client);
+    }
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// After state_export_init, so the mapping is written when the UIs read it
+static void on_snapshot_changed(guint32 fields, gpointer user_data) {
+  server.pending_fields |= fields;
+  if (server.notify_id || !server.listener)
+    return;
+  server.notify_id = g_idle_add(on_notify, NULL);
+  g_source_set_name_by_id(server.notify_id, "backend-notify");
+}
+
+// TRUE if another backend answers on path
+static gboolean socket_in_use(GSocketAddress *address) {
+  g_autoptr(GSocket) socket = g_socket_new(
+      G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT,
+      NULL);
+  return socket && g_socket_connect(socket, address, NULL, NULL);
+}
+
+static gboolean backend_listen(GError **error) {
+  server.path = control_backend_socket_path();
+  g_autofree gchar *dir = g_path_get_dirname(server.path);
+  g_mkdir_with_parents(dir, 0700);
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new(server.path);
+
+  if (socket_in_use(address)) {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                "%s is served by another cwidgets-backend", server.path);
+    return FALSE;
+  }
+  // Left over by a crash
+  g_unlink(server.path);
+
+  server.listener =
+      g_socket_new(G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM,
+                   G_SOCKET_PROTOCOL_DEFAULT, error);
+  if (!server.listener ||
+      !g_socket_bind(server.listener, address, FALSE, error) ||
+      !g_socket_listen(server.listener, error)) {
+    g_clear_object(&server.listener);
+    return FALSE;
+  }
+  g_socket_set_blocking(server.listener, FALSE);
+
+  server.clients = g_ptr_array_new_with_free_func(client_free);
+  server.source = g_socket_create_source(server.listener, G_IO_IN, NULL);
+  g_source_set_name(server.source, "backend-listener");
+  g_source_set_callback(server.source, G_SOURCE_FUNC(on_listener_readable),
+                        NULL, NULL);
+  g_source_attach(server.source, NULL);
+  return TRUE;
+}
+
+// Closes every connection, the UIs keep showing the last state
+static void backend_stop(void) {
+  if (!server.listener)
+    return;
+  g_clear_handle_id(&server.notify_id, g_source_remove);
+  g_clear_pointer(&server.clients, g_ptr_array_unref);
+  g_source_destroy(server.source);
+  g_clear_pointer(&server.source, g_source_unref);
+  g_socket_close(server.listener, NULL);
+  g_clear_object(&server.listener);
+  g_unlink(server.path);
+}
+
+static gboolean on_terminate(gpointer user_data) {
+  g_main_loop_quit(user_data);
+  return G_SOURCE_REMOVE;
+}
+
+int main(int argc, char *argv[]) {
+  GError *error = NULL;
+  GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+
+  // Also takes over stderr
+  init_logger("cwidgets-backend.log");
+  redirect_glib_logs();
+  metrics_init();
+  TRACE_INIT();
+
+  LOG("Backend started");
+
+  if (!backend_listen(&error)) {
+    g_printerr("cwidgets-backend: %s\n", error->message);
+    g_error_free(error);
+    close_logger();
+    return 1;
+  }
+
+  // Starts out with the last known state, like the bar
+  snapshot_init();
+  // There is nothing to serve without it
+  if (!state_export_init()) {
+    g_printerr("cwidgets-backend: could not export the state\n");
+    backend_stop();
+    close_logger();
+    return 1;
+  }
+  snapshot_connect_changed(on_snapshot_changed, NULL);
+  sources_start(loop);
+
+  // Lets the snapshot be written on the way out
+  g_unix_signal_add(SIGTERM, on_terminate, loop);
+  g_unix_signal_add(SIGINT, on_terminate, loop);
+
+  g_main_loop_run(loop);
+
+  LOG("Backend exiting");
+  backend_stop();
+  state_export_stop();
+  snapshot_flush();
+  TRACE_WRITE();
+  close_logger();
+
+  return 0;
+}
@@ -0,0 +1,257 @@
+#include "backend_client.h"
+#include "control_protocol.h"
+#include "snapshot.h"
+#include "state_export.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define READ_CHUNK 256
+#define RETRY_SECONDS 1
+
+/*
+ * The split mode of cWidgets, see backend.c. The widgets do not connect to
+ * their backends but follow the snapshot, and this writes what
+ * cwidgets-backend publishes into it: on every CONTROL_STATE_CHANGED frame
+ * the shared state is copied out of the mapping, and the fields that changed
+ * are set in the snapshot. The workspaces are left alone, hyprland is still
+ * followed by this process.
+ *
+ * If the backend is not running or goes away, the widgets keep the last
+ * state and connecting is retried every RETRY_SECONDS. The mapping is opened
+ * again with every connection, a new backend may have created a new file.
+ */
+typedef struct {
+  BackendReadyFunc ready;
+  gpointer ready_data;
+  gboolean was_ready;
+  GSocket *socket;
+  GSource *source;
+  GByteArray *in;
+  // Mapped on the first frame, the backend writes it before accepting
+  const StateExport *shared;
+  guint retry_id;
+  // Logged once until it connects again
+  gboolean warned;
+} BackendClient;
+
+static BackendClient client = {0};
+
+static void try_connect(void);
+
+// In split mode with CWIDGETS_BACKEND=1
+gboolean backend_client_enabled(void) {
+  return g_strcmp0(g_getenv("CWIDGETS_BACKEND"), "1") == 0;
+}
+
+static gboolean map_state(GError **error) {
+  g_autofree gchar *path = state_export_path();
+  struct stat st;
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    int saved_errno = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+                "%s: %s", path, g_strerror(saved_errno));
+    if (fd >= 0)
+      close(fd);
+    return FALSE;
+  }
+  if (st.st_size < (off_t)sizeof(StateExport)) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "%s is written by another version", path);
+    close(fd);
+    return FALSE;
+  }
+
+  void *map = mmap(NULL, sizeof(StateExport), PROT_READ, MAP_SHARED, fd, 0);
+  int saved_errno = errno;
+  close(fd);
+  if (map == MAP_FAILED) {
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+                "%s: %s", path, g_strerror(saved_errno));
+    return FALSE;
+  }
+  client.shared = map;
+  return TRUE;
+}
+
+// Returns FALSE if the state cannot be read
+static gboolean apply_state(guint32 fields) {
+  GError *error = NULL;
+  Snapshot s;
+
+  if (!client.shared && !map_state(&error)) {
+    g_warning("Backend: could not map the state: %s", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+  if (!state_export_read(client.shared, &s)) {
+    g_warning("Backend: could not read the state, is cwidgets-backend of "
+              "another version?");
+    return FALSE;
+  }
+
+  fields &= s.known;
+  if (fields & SNAPSHOT_BATTERY)
+    snapshot_set_battery(s.battery_percentage, s.battery_charging);
+  if (fields & SNAPSHOT_AUDIO)
+    snapshot_set_audio(s.audio_muted, s.audio_level);
+  if (fields & SNAPSHOT_WIFI) {
+    s.wifi_ssid[sizeof(s.wifi_ssid) - 1] = '\0';
+    snapshot_set_wifi(s.wifi_ssid[0] ? s.wifi_ssid : NULL, s.wifi_strength);
+  }
+  if (fields & SNAPSHOT_BLUETOOTH)
+    snapshot_set_bluetooth(s.bluetooth_connected);
+
+  if (!client.was_ready) {
+    client.was_ready = TRUE;
+    if (client.ready)
+      client.ready(client.ready_data);
+  }
+  return TRUE;
+}
+
+static void client_disconnect(void) {
+  if (client.source) {
+    g_source_destroy(client.source);
+    g_clear_pointer(&client.source, g_source_unref);
+  }
+  if (client.socket) {
+    g_socket_close(client.socket, NULL);
+    g_clear_object(&client.socket);
+  }
+  if (client.in)
+    g_byte_array_set_size(client.in, 0);
+  if (client.shared) {
+    munmap((gpointer)client.shared, sizeof(StateExport));
+    client.shared = NULL;
+  }
+}
+
+static gboolean on_retry(gpointer user_data) {
+  client.retry_id = 0;
+  try_connect();
+  return G_SOURCE_REMOVE;
+}
+
+static void schedule_retry(void) {
+  client.retry_id = g_timeout_add_seconds(RETRY_SECONDS, on_retry, NULL);
+  g_source_set_name_by_id(client.retry_id, "backend-retry");
+}
+
+// Returns FALSE if the backend sent garbage or its state cannot be read
+static gboolean client_process(void) {
+  gsize consumed = 0;
+  while (consumed < client.in->len) {
+    guint8 type;
+    g_auto(GStrv) args = NULL;
+    gssize n = control_frame_parse(client.in->data + consumed,
+                                   client.in->len - consumed, &type, &args);
+    if (n < 0)
+      return FALSE;
+    if (n == 0)
+      break;
+    consumed += n;
+
+    // Frames of a newer backend are skipped
+    if (type != CONTROL_STATE_CHANGED)
+      continue;
+    guint32 fields =
+        args[0] ? (guint32)g_ascii_strtoull(args[0], NULL, 10) : G_MAXUINT32;
+    if (!apply_state(fields))
+      return FALSE;
+  }
+  g_byte_array_remove_range(client.in, 0, consumed);
+  return TRUE;
+}
+
+static gboolean on_readable(GSocket *socket, GIOCondition condition,
+                            gpointer user_data) {
+  gboolean closed = FALSE;
+
+  while (TRUE) {
+    GError *error = NULL;
+    guint old_len = client.in->len;
+    g_byte_array_set_size(client.in, old_len + READ_CHUNK);
+    gssize len = g_socket_receive(socket, (gchar *)client.in->data + old_len,
+                                  READ_CHUNK, NULL, &error);
+    g_byte_array_set_size(client.in, old_len + MAX(len, 0));
+
+    if (len > 0)
+      continue;
+    if (len < 0 && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      g_error_free(error);
+      break;
+    }
+    g_clear_error(&error);
+    closed = TRUE;
+    break;
+  }
+
+  if (!client_process() || closed) {
+    g_message("Backend: lost cwidgets-backend, keeping the last state");
+    // Destroys this source too
+    client_disconnect();
+    schedule_retry();
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean backend_connect(GError **error) {
+  g_autofree gchar *path = control_backend_socket_path();
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new(path);
+  g_autoptr(GSocket) socket =
+      g_socket_new(G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM,
+                   G_SOCKET_PROTOCOL_DEFAULT, error);
+  if (!socket || !g_socket_connect(socket, address, NULL, error))
+    return FALSE;
+
+  g_socket_set_blocking(socket, FALSE);
+  client.socket = g_steal_pointer(&socket);
+  client.source = g_socket_create_source(client.socket,
+                                         G_IO_IN | G_IO_HUP | G_IO_ERR, NULL);
+  g_source_set_name(client.source, "backend-client");
+  g_source_set_callback(client.source, G_SOURCE_FUNC(on_readable), NULL,
+                        NULL);
+  g_source_attach(client.source, NULL);
+  return TRUE;
+}
+
+static void try_connect(void) {
+  GError *error = NULL;
+
+  if (!backend_connect(&error)) {
+    if (!client.warned)
+      g_message("Backend: waiting for cwidgets-backend: %s", error->message);
+    client.warned = TRUE;
+    g_error_free(error);
+    schedule_retry();
+    return;
+  }
+  client.warned = FALSE;
+  g_message("Backend: connected to cwidgets-backend");
+}
+
+/*
+ * Follows cwidgets-backend, ready is called once its state is first applied.
+ * Call it after snapshot_init.
+ */
+void backend_client_start(BackendReadyFunc ready, gpointer user_data) {
+  client.ready = ready;
+  client.ready_data = user_data;
+  client.in = g_byte_array_new();
+  try_connect();
+}
+
+void backend_client_stop(void) {
+  g_clear_handle_id(&client.retry_id, g_source_remove);
+  client_disconnect();
+  g_clear_pointer(&client.in, g_byte_array_unref);
+}
@@ -0,0 +1,13 @@
+#ifndef BACKEND_CLIENT_H
+#define BACKEND_CLIENT_H
+
+#include <glib.h>
+
+// Called once, when the first state of cwidgets-backend is in the snapshot
+typedef void (*BackendReadyFunc)(gpointer user_data);
+
+gboolean backend_client_enabled(void);
+void backend_client_start(BackendReadyFunc ready, gpointer user_data);
+void backend_client_stop(void);
+
+#endif // !BACKEND_CLIENT_H
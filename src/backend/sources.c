@@ -0,0 +1,270 @@
+#include "sources.h"
+#include "bt.h"
+#include "log.h"
+#include "metrics.h"
+#include "networking.h"
+#include "snapshot.h"
+#include "trace.h"
+#include <NetworkManager.h>
+#include <gio/gio.h>
+#include <glib-object.h>
+#include <glib.h>
+#include <wp/wp.h>
+
+#define UPOWER_DISPLAY_DEVICE "/org/freedesktop/UPower/devices/DisplayDevice"
+
+/*
+ * The backends of cwidgets-backend. Each one writes what it reports into the
+ * snapshot, normalized like the bar widgets do it: the battery percentage and
+ * whether it charges, the volume of the default sink in percent, the ssid and
+ * strength of the active access point, and whether any bluetooth device is
+ * connected.
+ *
+ * A backend that cannot connect only leaves its part of the state unknown.
+ */
+typedef struct {
+  GMainLoop *loop;
+  GDBusConnection *system_bus;
+  GDBusProxy *battery;
+  WpCore *core;
+  WpObjectManager *om;
+  WpPlugin *mixer_api;
+  WpPlugin *def_nodes_api;
+  guint pending_plugins;
+  guint32 default_sink_id;
+  NMDeviceWifi *wifi_device;
+  NMAccessPoint *ap;
+} Sources;
+
+static Sources sources = {0};
+
+static void battery_update(GDBusProxy *proxy) {
+  g_autoptr(GVariant) percentage =
+      g_dbus_proxy_get_cached_property(proxy, "Percentage");
+  g_autoptr(GVariant) state_v =
+      g_dbus_proxy_get_cached_property(proxy, "State");
+  if (!percentage || !state_v)
+    return;
+
+  guint32 state = g_variant_get_uint32(state_v);
+  snapshot_set_battery((gint)g_variant_get_double(percentage),
+                       state == 1 /*Charging*/ || state == 4 /*Fully charged*/);
+}
+
+static void on_battery_changed(GDBusProxy *proxy, GVariant *changed_properties,
+                               GStrv invalidated_properties,
+                               gpointer user_data) {
+  TRACE_SPAN("upower: properties changed");
+  metrics_inc(METRICS_BATTERY_SIGNALS);
+  battery_update(proxy);
+}
+
+static void on_battery_proxy_ready(GObject *source, GAsyncResult *res,
+                                   gpointer user_data) {
+  GError *error = NULL;
+  sources.battery = g_dbus_proxy_new_finish(res, &error);
+  if (!sources.battery) {
+    g_warning("Backend: no battery: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  g_signal_connect(sources.battery, "g-properties-changed",
+                   G_CALLBACK(on_battery_changed), NULL);
+  battery_update(sources.battery);
+}
+
+static void on_bt_connected(Bluetooth *bluetooth, gboolean connected,
+                            gpointer user_data) {
+  TRACE_SPAN("bluez: connected");
+  snapshot_set_bluetooth(connected);
+}
+
+static void on_bluetooth_ready(const GError *error, gpointer user_data) {
+  if (error) {
+    g_warning("Backend: no bluetooth: %s", error->message);
+    return;
+  }
+
+  g_autoptr(Bluetooth) bt = bluetooth_get_default();
+  bluetooth_install_signals(bt);
+  g_signal_connect(bt, "connected", G_CALLBACK(on_bt_connected), NULL);
+  bluetooth_call_signals(bt);
+}
+
+static void on_bus_ready(GObject *source, GAsyncResult *res,
+                         gpointer user_data) {
+  GError *error = NULL;
+  sources.system_bus = g_bus_get_finish(res, &error);
+  if (!sources.system_bus) {
+    g_warning("Backend: no system bus: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  g_dbus_proxy_new(sources.system_bus, G_DBUS_PROXY_FLAGS_NONE, NULL,
+                   "org.freedesktop.UPower", UPOWER_DISPLAY_DEVICE,
+                   "org.freedesktop.UPower.Device", NULL,
+                   on_battery_proxy_ready, NULL);
+  bluetooth_connect(sources.system_bus, on_bluetooth_ready, NULL);
+}
+
+static void on_strength_changed(NMAccessPoint *ap, GParamSpec *pspec,
+                                gpointer user_data) {
+  TRACE_SPAN("network: strength changed");
+  metrics_inc(METRICS_NETWORK_SIGNALS);
+  g_autofree gchar *ssid = ap_get_ssid(ap);
+  // Like the bar, an access point without a name changes nothing
+  if (ssid)
+    snapshot_set_wifi(ssid, nm_access_point_get_strength(ap));
+}
+
+static void on_active_ap_changed(NMDeviceWifi *device, GParamSpec *pspec,
+                                 gpointer user_data) {
+  TRACE_SPAN("network: access point changed");
+  metrics_inc(METRICS_NETWORK_SIGNALS);
+
+  if (sources.ap)
+    g_signal_handlers_disconnect_by_func(sources.ap, on_strength_changed,
+                                         NULL);
+  g_clear_object(&sources.ap);
+
+  NMAccessPoint *ap = nm_device_wifi_get_active_access_point(device);
+  if (!ap) {
+    snapshot_set_wifi(NULL, 0);
+    return;
+  }
+  sources.ap = g_object_ref(ap);
+  g_signal_connect(ap, "notify::strength", G_CALLBACK(on_strength_changed),
+                   NULL);
+  on_strength_changed(ap, NULL, NULL);
+}
+
+static void on_network_ready(const GError *error, gpointer user_data) {
+  if (error) {
+    g_warning("Backend: no NetworkManager: %s", error->message);
+    return;
+  }
+
+  sources.wifi_device = net_get_wifi_device();
+  if (!sources.wifi_device) {
+    g_message("Backend: no wifi device");
+    return;
+  }
+  g_signal_connect(sources.wifi_device, "notify::active-access-point",
+                   G_CALLBACK(on_active_ap_changed), NULL);
+  on_active_ap_changed(sources.wifi_device, NULL, NULL);
+}
+
+static void audio_update(guint32 node_id) {
+  GVariant *variant = NULL;
+  gboolean mute = FALSE;
+  gdouble volume = 1.0;
+
+  g_signal_emit_by_name(sources.mixer_api, "get-volume", node_id, &variant);
+  if (!variant) {
+    LOG_WARNING("Node %u does not support volume", node_id);
+    return;
+  }
+  g_variant_lookup(variant, "volume", "d", &volume);
+  g_variant_lookup(variant, "mute", "b", &mute);
+  g_variant_unref(variant);
+
+  // The bar shows no more than three digits
+  gint level = (gint)(volume * 100);
+  if (level < 0 || level > 999) {
+    g_message("Backend: audio level out of range: %d", level);
+    return;
+  }
+  snapshot_set_audio(mute, level);
+}
+
+static void on_mixer_changed(WpPlugin *mixer_api, guint32 node_id,
+                             gpointer user_data) {
+  TRACE_SPAN("pipewire: mixer changed");
+  metrics_inc(METRICS_AUDIO_SIGNALS);
+  if (node_id == sources.default_sink_id)
+    audio_update(node_id);
+}
+
+static void on_def_nodes_changed(WpPlugin *def_nodes_api,
+                                 gpointer user_data) {
+  metrics_inc(METRICS_AUDIO_SIGNALS);
+  g_signal_emit_by_name(def_nodes_api, "get-default-node", "Audio/Sink",
+                        &sources.default_sink_id);
+  audio_update(sources.default_sink_id);
+}
+
+static void on_om_installed(WpObjectManager *om, gpointer user_data) {
+  sources.mixer_api = wp_plugin_find(sources.core, "mixer-api");
+  sources.def_nodes_api = wp_plugin_find(sources.core, "default-nodes-api");
+  if (!sources.mixer_api || !sources.def_nodes_api) {
+    g_warning("Backend: could not find the mixer and default nodes plugins");
+    return;
+  }
+
+  g_signal_connect(sources.mixer_api, "changed", G_CALLBACK(on_mixer_changed),
+                   NULL);
+  g_signal_connect(sources.def_nodes_api, "changed",
+                   G_CALLBACK(on_def_nodes_changed), NULL);
+  on_def_nodes_changed(sources.def_nodes_api, NULL);
+}
+
+static void on_plugin_loaded(WpCore *core, GAsyncResult *res,
+                             gpointer user_data) {
+  GError *error = NULL;
+
+  if (!wp_core_load_component_finish(core, res, &error)) {
+    g_warning("Backend: no PipeWire: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  // Like the bar, the volume is read once the object manager is installed
+  if (--sources.pending_plugins == 0) {
+    g_autoptr(WpPlugin) mixer_api = wp_plugin_find(core, "mixer-api");
+    g_object_set(mixer_api, "scale", 1 /* cubic */, NULL);
+    wp_object_manager_request_object_features(sources.om, WP_TYPE_NODE,
+                                              WP_OBJECT_FEATURES_ALL);
+    wp_core_install_object_manager(core, sources.om);
+  }
+}
+
+static void start_pipewire(void) {
+  wp_init(WP_INIT_PIPEWIRE | WP_INIT_SPA_TYPES | WP_INIT_SET_PW_LOG);
+  sources.core = wp_core_new(g_main_context_default(), NULL, NULL);
+  sources.om = wp_object_manager_new();
+  wp_object_manager_add_interest(sources.om, WP_TYPE_NODE,
+                                 WP_CONSTRAINT_TYPE_PW_PROPERTY, "media.class",
+                                 "=s", "Audio/Sink", NULL);
+  g_signal_connect(sources.om, "installed", G_CALLBACK(on_om_installed),
+                   NULL);
+
+  sources.pending_plugins++;
+  wp_core_load_component(sources.core,
+                         "libwireplumber-module-default-nodes-api", "module",
+                         NULL, NULL, NULL,
+                         (GAsyncReadyCallback)on_plugin_loaded, NULL);
+
+  sources.pending_plugins++;
+  wp_core_load_component(sources.core, "libwireplumber-module-mixer-api",
+                         "module", NULL, NULL, NULL,
+                         (GAsyncReadyCallback)on_plugin_loaded, NULL);
+
+  if (!wp_core_connect(sources.core)) {
+    g_warning("Backend: could not connect to PipeWire");
+    return;
+  }
+
+  // Like cWidgets, the backend exits with PipeWire
+  g_signal_connect_swapped(sources.core, "disconnected",
+                           G_CALLBACK(g_main_loop_quit), sources.loop);
+}
+
+// The backends connect concurrently, call it after snapshot_init
+void sources_start(GMainLoop *loop) {
+  sources.loop = loop;
+  g_bus_get(G_BUS_TYPE_SYSTEM, NULL, on_bus_ready, NULL);
+  start_pipewire();
+  net_init(on_network_ready, NULL);
+}
@@ -0,0 +1,8 @@
+#ifndef SOURCES_H
+#define SOURCES_H
+
+#include <glib.h>
+
+void sources_start(GMainLoop *loop);
+
+#endif // !SOURCES_H
@@ -1,4 +1,13 @@
 #include "audio.h"
+#include "indicator_strip.h"
+#include "log.h"
+#include "metrics.h"
+#include "snapshot.h"
+#include "stable_label.h"
+#include "status_icons.h"
+#include "trace.h"
+#include "updates.h"
+#include "util.h"
 #include <glib-object.h>
 #include <glib.h>
 #include <glibconfig.h>
@@ -13,21 +22,63 @@
 #include <wp/proxy.h>
 
 static const char ICON_MUTED[] = "audio-volume-muted-symbolic";
-static const char ICON_LOW[] = "audio-volume-low-symbolic";
-static const char ICON_MEDIUM[] = "audio-volume-medium-symbolic";
-static const char ICON_HIGH[] = "audio-volume-high-symbolic";
-static const char ICON_OVERAMPLIFIED[] = "audio-volume-overamplified-symbolic";
 
 static const gchar *sink_media_class = "Audio/Sink";
 
+// The label keeps this width, louder than 100% grows it
+#define WIDEST_LEVEL "100"
+
 typedef struct {
   GtkWidget *image;
   GtkWidget *label;
+  // Instead of image and label with CWIDGETS_INDICATOR_STRIP=1
+  IndicatorStrip *strip;
   guint32 default_sink_id;
+  // Latest values, shown by apply_audio_ui
+  gboolean muted;
+  int audio_level;
   WpPlugin *mixer_api;
   WpPlugin *def_nodes_api;
 } AudioState;
 
+static GtkWidget *audio_label_new(void) {
+  GtkWidget *label = stable_label_new(WIDEST_LEVEL);
+  gtk_widget_set_name(label, "volume");
+  return label;
+}
+
+static void audio_ui_set(GtkWidget *image, GtkWidget *label, gboolean muted,
+                         int audio_level) {
+  char audio_str[4];
+  snprintf(audio_str, sizeof(audio_str), "%d", audio_level);
+
+  stable_label_set_text(STABLE_LABEL(label), audio_str);
+  gtk_widget_set_visible(label, !muted && audio_level != 0);
+  status_icons_set(image, STATUS_ICONS_AUDIO,
+                   status_icons_audio_index(muted, audio_level));
+}
+
+static void audio_indicator_set(IndicatorStrip *strip, gboolean muted,
+                                int audio_level) {
+  char audio_str[4];
+  snprintf(audio_str, sizeof(audio_str), "%d", audio_level);
+
+  indicator_strip_set_text(strip, INDICATOR_AUDIO, audio_str);
+  indicator_strip_set_text_visible(strip, INDICATOR_AUDIO,
+                                   !muted && audio_level != 0);
+  guint icon = status_icons_audio_index(muted, audio_level);
+  indicator_strip_set_status_icon(strip, INDICATOR_AUDIO, STATUS_ICONS_AUDIO,
+                                  icon);
+}
+
+static void apply_audio_ui(gpointer data) {
+  AudioState *as = data;
+  if (as->strip)
+    audio_indicator_set(as->strip, as->muted, as->audio_level);
+  else
+    audio_ui_set(as->image, as->label, as->muted, as->audio_level);
+}
+
 static void update_audio_ui(AudioState *as, gboolean muted, int audio_level) {
   if (audio_level == -1) {
     g_message("No active audio\n");
@@ -41,27 +92,12 @@ static void update_audio_ui(AudioState *as, gboolean muted, int audio_level) {
     g_message("Audio level is too low: %d", audio_level);
     return;
   }
-  char audio_str[4];
-  snprintf(audio_str, sizeof(audio_str), "%d", audio_level);
-  const char *icon_name;
-  if (muted) {
-    icon_name = ICON_MUTED;
-  } else if (audio_level == 0) {
-    icon_name = ICON_MUTED;
-    muted = TRUE;
-  } else if (audio_level < 33) {
-    icon_name = ICON_LOW;
-  } else if (audio_level < 66) {
-    icon_name = ICON_MEDIUM;
-  } else if (audio_level <= 100) {
-    icon_name = ICON_HIGH;
-  } else {
-    icon_name = ICON_OVERAMPLIFIED;
-  }
 
-  gtk_label_set_text(GTK_LABEL(as->label), audio_str);
-  gtk_widget_set_visible(as->label, !muted);
-  gtk_image_set_from_icon_name(GTK_IMAGE(as->image), icon_name);
+  as->muted = muted;
+  as->audio_level = audio_level;
+  snapshot_set_audio(muted, audio_level);
+  bar_post_update(as->strip ? GTK_WIDGET(as->strip) : as->label,
+                  apply_audio_ui, as);
 }
 
 static void update_volume_info(AudioState *as, guint32 node_id) {
@@ -71,7 +107,7 @@ static void update_volume_info(AudioState *as, guint32 node_id) {
 
   g_signal_emit_by_name(as->mixer_api, "get-volume", node_id, &variant);
   if (!variant) {
-    fprintf(stderr, "Node %d does not support volume\n", node_id);
+    LOG_WARNING("Node %u does not support volume", node_id);
     return;
   }
   g_variant_lookup(variant, "volume", "d", &volume);
@@ -83,6 +119,8 @@ static void update_volume_info(AudioState *as, guint32 node_id) {
 
 static void on_mixer_changed(WpPlugin *mixer_api, guint32 node_id,
                              gpointer user_data) {
+  TRACE_SPAN("pipewire: mixer changed");
+  metrics_inc(METRICS_AUDIO_SIGNALS);
   AudioState *as = (AudioState *)user_data;
 
   if (node_id == as->default_sink_id) {
@@ -91,6 +129,7 @@ static void on_mixer_changed(WpPlugin *mixer_api, guint32 node_id,
 }
 
 static void on_def_nodes_changed(WpPlugin *def_node_api, gpointer user_data) {
+  metrics_inc(METRICS_AUDIO_SIGNALS);
   AudioState *as = (AudioState *)user_data;
 
   if (def_node_api) {
@@ -101,35 +140,112 @@ static void on_def_nodes_changed(WpPlugin *def_node_api, gpointer user_data) {
   }
 }
 
-// Uses mixer api and default nodes api to handle stuff
-void start_audio_widget(GtkWidget *box, WpCore *core) {
-  GtkWidget *audio_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
-  GtkWidget *image = gtk_image_new_from_icon_name(ICON_MUTED);
-  GtkWidget *label = gtk_label_new("...");
+static void audio_state_free(gpointer data) {
+  AudioState *as = data;
+  g_clear_object(&as->mixer_api);
+  g_clear_object(&as->def_nodes_api);
+  free(as);
+}
 
-  AudioState *as = calloc(1, sizeof(AudioState));
-  as->image = image;
-  as->label = label;
+static void on_snapshot_changed(guint32 fields, gpointer user_data) {
+  AudioState *as = user_data;
+  const Snapshot *snapshot = snapshot_get();
+  if (!(fields & SNAPSHOT_AUDIO))
+    return;
 
-  gtk_box_append(GTK_BOX(audio_box), image);
-  gtk_box_append(GTK_BOX(audio_box), label);
+  as->muted = snapshot->audio_muted;
+  as->audio_level = snapshot->audio_level;
+  bar_post_update(as->strip ? GTK_WIDGET(as->strip) : as->label,
+                  apply_audio_ui, as);
+}
 
-  gtk_box_append(GTK_BOX(box), audio_box);
+/*
+ * Uses mixer api and default nodes api to handle stuff, owner holds as.
+ * Without a core it follows the snapshot, as written by backend_client.c.
+ */
+static void audio_connect(AudioState *as, WpCore *core, GtkWidget *owner) {
+  g_object_set_data_full(G_OBJECT(owner), "audio-state", as,
+                         audio_state_free);
+
+  if (!core) {
+    snapshot_connect_owned(on_snapshot_changed, as, owner);
+    on_snapshot_changed(snapshot_get()->known, as);
+    return;
+  }
 
+  // The plugins outlive the bar
   as->mixer_api = wp_plugin_find(core, "mixer-api");
   if (as->mixer_api) {
-    g_signal_connect(as->mixer_api, "changed", G_CALLBACK(on_mixer_changed),
-                     as);
+    signal_connect_owned(as->mixer_api, "changed",
+                         G_CALLBACK(on_mixer_changed), as, owner);
   } else {
     g_warning("Could not find mixer-api plugin");
   }
   as->def_nodes_api = wp_plugin_find(core, "default-nodes-api");
   if (as->def_nodes_api) {
-    g_signal_connect(as->def_nodes_api, "changed",
-                     G_CALLBACK(on_def_nodes_changed), as);
+    signal_connect_owned(as->def_nodes_api, "changed",
+                         G_CALLBACK(on_def_nodes_changed), as, owner);
 
     on_def_nodes_changed(as->def_nodes_api, as);
   } else {
     g_warning("Could not find def_node-api plugin");
   }
 }
+
+void start_audio_widget(GtkWidget *box, WpCore *core) {
+  GtkWidget *audio_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+  GtkWidget *image = gtk_image_new_from_icon_name(ICON_MUTED);
+  GtkWidget *label = audio_label_new();
+  stable_label_set_text(STABLE_LABEL(label), "...");
+
+  const Snapshot *snapshot = snapshot_get();
+  if (snapshot->known & SNAPSHOT_AUDIO)
+    audio_ui_set(image, label, snapshot->audio_muted, snapshot->audio_level);
+
+  AudioState *as = calloc(1, sizeof(AudioState));
+  as->image = image;
+  as->label = label;
+
+  gtk_box_append(GTK_BOX(audio_box), image);
+  gtk_box_append(GTK_BOX(audio_box), label);
+
+  gtk_box_append(GTK_BOX(box), audio_box);
+  audio_connect(as, core, audio_box);
+}
+
+// Shows the last known volume, or a placeholder until start_audio_indicator
+void audio_indicator_init(IndicatorStrip *strip) {
+  const Snapshot *snapshot = snapshot_get();
+
+  indicator_strip_set_widest(strip, INDICATOR_AUDIO, WIDEST_LEVEL);
+  indicator_strip_set_visible(strip, INDICATOR_AUDIO, TRUE);
+  if (snapshot->known & SNAPSHOT_AUDIO) {
+    audio_indicator_set(strip, snapshot->audio_muted, snapshot->audio_level);
+  } else {
+    audio_indicator_set(strip, TRUE, 0);
+    indicator_strip_set_placeholder(strip, INDICATOR_AUDIO, TRUE);
+  }
+}
+
+void start_audio_indicator(IndicatorStrip *strip, WpCore *core) {
+  AudioState *as = calloc(1, sizeof(AudioState));
+  as->strip = strip;
+
+  indicator_strip_set_placeholder(strip, INDICATOR_AUDIO, FALSE);
+  audio_connect(as, core, GTK_WIDGET(strip));
+}
+
+// The last known volume, NULL if there is none
+GtkWidget *audio_snapshot_new(void) {
+  const Snapshot *snapshot = snapshot_get();
+  if (!(snapshot->known & SNAPSHOT_AUDIO))
+    return NULL;
+
+  GtkWidget *audio_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+  GtkWidget *image = gtk_image_new();
+  GtkWidget *label = audio_label_new();
+  gtk_box_append(GTK_BOX(audio_box), image);
+  gtk_box_append(GTK_BOX(audio_box), label);
+  audio_ui_set(image, label, snapshot->audio_muted, snapshot->audio_level);
+  return audio_box;
+}
@@ -1,9 +1,13 @@
 #ifndef AUDIO_H
 #define AUDIO_H
 
+#include "indicator_strip.h"
 #include "wp/wp.h"
 #include <gtk/gtk.h>
 
 void start_audio_widget(GtkWidget *box, WpCore *core);
+GtkWidget *audio_snapshot_new(void);
+void audio_indicator_init(IndicatorStrip *strip);
+void start_audio_indicator(IndicatorStrip *strip, WpCore *core);
 
 #endif // !AUDIO_H
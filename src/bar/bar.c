@@ -3,9 +3,17 @@
 #include "battery/battery.h"
 #include "bluetooth/bt.h"
 #include "date_time/date_time.h"
+#include "indicator_strip.h"
+#include "layout_stats.h"
+#include "networking.h"
 #include "quicksettings/quicksettings.h"
+#include "snapshot.h"
+#include "startup.h"
+#include "trace.h"
+#include "updates.h"
 #include "util.h"
 #include "wifi/wifi_icon.h"
+#include "window_title/window_title.h"
 #include "workspaces/workspaces.h"
 #include <gio/gio.h>
 #include <glib-object.h>
@@ -13,16 +21,144 @@
 #include <gtk/gtk.h>
 #include <gtk4-layer-shell/gtk4-layer-shell.h>
 
+// bluetooth_icon is the slot or the indicator strip
+static void apply_bt_connected(gpointer data) {
+  GtkWidget *bluetooth_icon = data;
+  gboolean connected =
+      GPOINTER_TO_INT(g_object_get_data(G_OBJECT(bluetooth_icon), "connected"));
+  if (INDICATOR_IS_STRIP(bluetooth_icon))
+    indicator_strip_set_visible(INDICATOR_STRIP(bluetooth_icon),
+                                INDICATOR_BLUETOOTH, connected);
+  else
+    gtk_widget_set_visible(bluetooth_icon, connected);
+}
+
 static void on_bt_connected(Bluetooth *bluetooth, gboolean connected,
                             gpointer user_data) {
+  TRACE_SPAN("bluez: connected");
+  GtkWidget *bluetooth_icon = user_data;
+  g_object_set_data(G_OBJECT(bluetooth_icon), "connected",
+                    GINT_TO_POINTER(connected));
+  snapshot_set_bluetooth(connected);
+  bar_post_update(bluetooth_icon, apply_bt_connected, bluetooth_icon);
+}
+
+static void on_snapshot_changed(guint32 fields, gpointer user_data) {
   GtkWidget *bluetooth_icon = user_data;
-  gtk_widget_set_visible(bluetooth_icon, connected);
+  const Snapshot *snapshot = snapshot_get();
+  if (!(fields & SNAPSHOT_BLUETOOTH))
+    return;
+
+  g_object_set_data(G_OBJECT(bluetooth_icon), "connected",
+                    GINT_TO_POINTER(snapshot->bluetooth_connected));
+  bar_post_update(bluetooth_icon, apply_bt_connected, bluetooth_icon);
+}
+
+// In split mode it follows the snapshot, see backend_client.c
+static void connect_bluetooth(MainContext *ctx, GtkWidget *bluetooth_icon) {
+  if (ctx->split) {
+    snapshot_connect_owned(on_snapshot_changed, bluetooth_icon,
+                           bluetooth_icon);
+    on_snapshot_changed(snapshot_get()->known, bluetooth_icon);
+    return;
+  }
+
+  g_autoptr(Bluetooth) bt = bluetooth_get_default();
+  signal_connect_owned(bt, "connected", G_CALLBACK(on_bt_connected),
+                       bluetooth_icon, bluetooth_icon);
+  bluetooth_call_signals(bt);
+}
+
+// The widgets get no backend in split mode, they follow the snapshot then
+static void fill_battery(MainContext *ctx, GtkWidget *slot) {
+  gtk_box_set_spacing(GTK_BOX(slot), 10);
+  start_battery_widget(slot, ctx->split ? NULL : ctx->dbus_connection);
+}
+
+// The slot is the icon, hidden while nothing is connected
+static void fill_bluetooth(MainContext *ctx, GtkWidget *slot) {
+  gtk_box_append(GTK_BOX(slot),
+                 gtk_image_new_from_icon_name("bluetooth-symbolic"));
+  connect_bluetooth(ctx, slot);
+}
+
+static void fill_audio(MainContext *ctx, GtkWidget *slot) {
+  start_audio_widget(slot, ctx->split ? NULL : ctx->core);
+}
+
+static void fill_wifi(MainContext *ctx, GtkWidget *slot) {
+  NMDeviceWifi *wifi_device = ctx->split ? NULL : net_get_wifi_device();
+  add_wifi_widget(slot, wifi_device, ctx->split);
+  g_clear_object(&wifi_device);
+}
+
+// In split mode the widgets wait for cwidgets-backend instead
+static StartupBackend slot_backend(MainContext *ctx, StartupBackend backend) {
+  return ctx->split ? STARTUP_BACKEND_STATE : backend;
+}
+
+// Shows the last known values in the slot until its backend is ready
+static GtkWidget *snapshot_slot(GtkWidget *slot, GtkWidget *snapshot) {
+  if (snapshot)
+    startup_slot_set_placeholder(slot, snapshot);
+  return slot;
+}
+
+static gboolean bluetooth_snapshot_connected(void) {
+  const Snapshot *snapshot = snapshot_get();
+  return (snapshot->known & SNAPSHOT_BLUETOOTH) &&
+         snapshot->bluetooth_connected;
+}
+
+static GtkWidget *bluetooth_snapshot_new(void) {
+  if (!bluetooth_snapshot_connected())
+    return NULL;
+  return gtk_image_new_from_icon_name("bluetooth-symbolic");
+}
+
+static void fill_strip_bluetooth(MainContext *ctx, GtkWidget *strip) {
+  connect_bluetooth(ctx, strip);
+}
+
+static void fill_strip_audio(MainContext *ctx, GtkWidget *strip) {
+  start_audio_indicator(INDICATOR_STRIP(strip), ctx->split ? NULL : ctx->core);
+}
+
+static void fill_strip_wifi(MainContext *ctx, GtkWidget *strip) {
+  NMDeviceWifi *wifi_device = ctx->split ? NULL : net_get_wifi_device();
+  add_wifi_indicator(INDICATOR_STRIP(strip), wifi_device, ctx->split);
+  g_clear_object(&wifi_device);
+}
+
+/*
+ * The bluetooth, volume, wifi, time and date widgets drawn by one widget,
+ * see indicator_strip.c. Shows the last known values or dimmed placeholders
+ * like the slots until the backends are ready.
+ */
+static GtkWidget *indicator_strip_bar_new(MainContext *ctx) {
+  GtkWidget *strip = indicator_strip_new();
+  IndicatorStrip *indicators = INDICATOR_STRIP(strip);
+
+  indicator_strip_set_icon_name(indicators, INDICATOR_BLUETOOTH,
+                                "bluetooth-symbolic");
+  indicator_strip_set_visible(indicators, INDICATOR_BLUETOOTH,
+                              bluetooth_snapshot_connected());
+  audio_indicator_init(indicators);
+  wifi_indicator_init(indicators);
+  start_date_time_indicator(indicators);
+
+  startup_when_ready(slot_backend(ctx, STARTUP_BACKEND_BLUEZ),
+                     fill_strip_bluetooth, strip);
+  startup_when_ready(slot_backend(ctx, STARTUP_BACKEND_PIPEWIRE),
+                     fill_strip_audio, strip);
+  startup_when_ready(slot_backend(ctx, STARTUP_BACKEND_NETWORK),
+                     fill_strip_wifi, strip);
+  return strip;
 }
 
 GtkWidget *bar_init_window(GdkDisplay *display, GdkMonitor *monitor) {
   GdkRectangle geometry;
   gdk_monitor_get_geometry(monitor, &geometry);
-  g_object_unref(monitor);
   GtkWidget *window = gtk_window_new();
   char buffer[32];
   snprintf(buffer, sizeof(buffer), "bar");
@@ -47,22 +183,36 @@ GtkWidget *bar_init_window(GdkDisplay *display, GdkMonitor *monitor) {
   return window;
 }
 
-void bar(GdkDisplay *display, GdkMonitor *monitor, GDBusConnection *conneciton,
-         WpCore *core) {
+/*
+ * Widgets of backends that are not connected yet show the last known values
+ * or a placeholder, see startup.c and snapshot.c
+ *
+ * The monitor has to outlive the window, destroy it before unplugging
+ */
+GtkWidget *bar(GdkDisplay *display, GdkMonitor *monitor, MainContext *ctx) {
   GtkWidget *window = bar_init_window(display, monitor);
+  startup_watch_first_paint(window);
+  layout_stats_watch_window(window);
+  // Before the widgets, so it is suspended before they handle a change
+  bar_updates_attach(window, monitor);
   GtkWidget *box = gtk_center_box_new();
   gtk_widget_set_hexpand(box, TRUE);
   gtk_widget_add_css_class(box, "bar");
 
   GtkWidget *battery_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
-  start_battery_widget(battery_box, conneciton);
+  gtk_box_append(GTK_BOX(battery_box),
+                 snapshot_slot(startup_slot_new(
+                                   slot_backend(ctx, STARTUP_BACKEND_DBUS),
+                                   fill_battery, "battery-missing-symbolic"),
+                               battery_snapshot_new()));
+  start_window_title_widget(battery_box);
 
   GtkWidget *workspaces_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 2);
   gtk_widget_add_css_class(workspaces_box, "workspaces");
   gtk_widget_set_hexpand(workspaces_box, TRUE);
   gtk_widget_set_halign(workspaces_box, GTK_ALIGN_CENTER);
   gtk_box_append(GTK_BOX(workspaces_box), gtk_label_new("Workspaces"));
-  g_thread_new("workspace", listen_to_hyprland_socket, workspaces_box);
+  start_workspaces_widget(workspaces_box, monitor);
 
   GtkWidget *right_button = gtk_button_new();
   gtk_widget_add_css_class(right_button, "toggle-button");
@@ -70,24 +220,38 @@ void bar(GdkDisplay *display, GdkMonitor *monitor, GDBusConnection *conneciton,
   g_signal_connect_swapped(right_button, "clicked",
                            G_CALLBACK(toggle_quick_settings), monitor);
 
-  GtkWidget *right_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 13);
-  gtk_button_set_child(GTK_BUTTON(right_button), right_box);
-
-  GtkWidget *bluetooth_icon =
-      gtk_image_new_from_icon_name("bluetooth-symbolic");
-  Bluetooth *bt = bluetooth_get_default();
-  g_signal_connect(bt, "connected", G_CALLBACK(on_bt_connected),
-                   bluetooth_icon);
-  bluetooth_call_signals(bt);
-  gtk_box_append(GTK_BOX(right_box), bluetooth_icon);
+  if (indicator_strip_enabled()) {
+    gtk_button_set_child(GTK_BUTTON(right_button),
+                         indicator_strip_bar_new(ctx));
+  } else {
+    GtkWidget *right_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 13);
+    gtk_button_set_child(GTK_BUTTON(right_button), right_box);
 
-  start_audio_widget(right_box, core);
-  add_wifi_widget(right_box);
-  start_date_time_widget(right_box);
+    gtk_box_append(
+        GTK_BOX(right_box),
+        snapshot_slot(
+            startup_slot_new(slot_backend(ctx, STARTUP_BACKEND_BLUEZ),
+                             fill_bluetooth, NULL),
+            bluetooth_snapshot_new()));
+    gtk_box_append(
+        GTK_BOX(right_box),
+        snapshot_slot(
+            startup_slot_new(slot_backend(ctx, STARTUP_BACKEND_PIPEWIRE),
+                             fill_audio, "audio-volume-muted-symbolic"),
+            audio_snapshot_new()));
+    gtk_box_append(
+        GTK_BOX(right_box),
+        snapshot_slot(
+            startup_slot_new(slot_backend(ctx, STARTUP_BACKEND_NETWORK),
+                             fill_wifi, "network-wireless-offline-symbolic"),
+            wifi_snapshot_new()));
+    start_date_time_widget(right_box);
+  }
 
   gtk_center_box_set_start_widget(GTK_CENTER_BOX(box), battery_box);
   gtk_center_box_set_center_widget(GTK_CENTER_BOX(box), workspaces_box);
   gtk_center_box_set_end_widget(GTK_CENTER_BOX(box), right_button);
 
   gtk_window_set_child(GTK_WINDOW(window), box);
+  return window;
 }
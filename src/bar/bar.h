@@ -1,11 +1,10 @@
 #ifndef BAR_H
 #define BAR_H
 
-#include "wp/wp.h"
+#include "main.h"
 #include <gtk/gtk.h>
 
 GtkWidget *bar_init_window(GdkDisplay *display, GdkMonitor *monitor);
-void bar(GdkDisplay *display, GdkMonitor *monitor, GDBusConnection *conneciton,
-         WpCore *core);
+GtkWidget *bar(GdkDisplay *display, GdkMonitor *monitor, MainContext *ctx);
 
 #endif // !DEBUG
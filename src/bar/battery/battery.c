@@ -6,6 +6,13 @@
 #include "gtk/gtk.h"
 #include "gtk/gtkrevealer.h"
 #include "gtk/gtkshortcut.h"
+#include "metrics.h"
+#include "snapshot.h"
+#include "spawn_broker.h"
+#include "stable_label.h"
+#include "status_icons.h"
+#include "trace.h"
+#include "updates.h"
 #include "util.h"
 #include <dirent.h>
 #include <stddef.h>
@@ -14,10 +21,19 @@
 
 char *dbus_path = "/org/freedesktop/UPower/devices/DisplayDevice";
 
+// The label keeps this width, so the bar does not move as the level changes
+#define WIDEST_PERCENTAGE "100%"
+
 struct BatteryWidgets {
   GtkWidget *label;
   GtkWidget *image;
+  GDBusProxy *proxy;
+  // Cancels creating the proxy if the bar goes away first
+  GCancellable *cancellable;
   double energyFull;
+  // Latest values, shown by battery_ui_apply
+  int percentage;
+  gboolean charging;
 };
 
 struct PowerProfile {
@@ -25,34 +41,41 @@ struct PowerProfile {
   char *cmd;
 };
 
-static void battery_ui_refresh(gpointer data, int energy, gboolean charging) {
-  struct BatteryWidgets *bw = data;
-  GtkWidget *label = bw->label;
-  GtkWidget *image = bw->image;
-  double energyFull = bw->energyFull;
-
-  int percentage = (int)((energy * 100) / energyFull);
-  int last_digit = percentage % 10;
-  int level_icon = (percentage / 10) * 10;
-  if (last_digit >= 5)
-    level_icon += 10;
-
-  char *state = charging ? "-charging" : "";
-  char icon_name[36];
-  snprintf(icon_name, sizeof(icon_name), "battery-level-%d%s-symbolic",
-           level_icon, state);
+static GtkWidget *battery_label_new(void) {
+  GtkWidget *label = stable_label_new(WIDEST_PERCENTAGE);
+  gtk_widget_set_name(label, "battery");
+  return label;
+}
 
+static void battery_ui_set(GtkWidget *image, GtkWidget *label, int percentage,
+                           gboolean charging) {
   char percent_str[8];
   snprintf(percent_str, sizeof(percent_str), "%d%%", percentage);
 
-  gtk_label_set_label(GTK_LABEL(label), percent_str);
-  gtk_image_set_from_icon_name(GTK_IMAGE(image), icon_name);
+  stable_label_set_text(STABLE_LABEL(label), percent_str);
+  status_icons_set(image, STATUS_ICONS_BATTERY,
+                   status_icons_battery_index(percentage, charging));
+}
+
+static void battery_ui_apply(gpointer data) {
+  struct BatteryWidgets *bw = data;
+  battery_ui_set(bw->image, bw->label, bw->percentage, bw->charging);
+}
+
+static void battery_ui_refresh(gpointer data, int energy, gboolean charging) {
+  struct BatteryWidgets *bw = data;
+  bw->percentage = (int)((energy * 100) / bw->energyFull);
+  bw->charging = charging;
+  snapshot_set_battery(bw->percentage, charging);
+  bar_post_update(bw->label, battery_ui_apply, bw);
 }
 
 static void on_proxy_properties_changed(GDBusProxy *proxy,
                                         GVariant *changed_properties,
                                         GStrv invalidated_properties,
                                         gpointer user_data) {
+  TRACE_SPAN("upower: properties changed");
+  metrics_inc(METRICS_BATTERY_SIGNALS);
   GVariantIter *iter;
   const gchar *key;
   GVariant *value;
@@ -119,6 +142,49 @@ int initial_sync(GDBusProxy *proxy, struct BatteryWidgets *bw) {
   return 0;
 }
 
+static void on_proxy_ready(GObject *source, GAsyncResult *res,
+                           gpointer user_data) {
+  GError *error = NULL;
+  GDBusProxy *proxy = g_dbus_proxy_new_finish(res, &error);
+
+  if (!proxy) {
+    // Cancelled when the widgets are gone, user_data with them
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_printerr("Failed to create proxy: %s\n", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  struct BatteryWidgets *bw = user_data;
+  bw->proxy = proxy;
+  initial_sync(proxy, bw);
+
+  // Connect to PropertiesChanged via proxy
+  g_signal_connect(proxy, "g-properties-changed",
+                   G_CALLBACK(on_proxy_properties_changed), bw);
+}
+
+static void on_snapshot_changed(guint32 fields, gpointer user_data) {
+  struct BatteryWidgets *bw = user_data;
+  const Snapshot *snapshot = snapshot_get();
+  if (!(fields & SNAPSHOT_BATTERY))
+    return;
+
+  bw->percentage = snapshot->battery_percentage;
+  bw->charging = snapshot->battery_charging;
+  bar_post_update(bw->label, battery_ui_apply, bw);
+}
+
+static void battery_widgets_free(gpointer data) {
+  struct BatteryWidgets *bw = data;
+  g_cancellable_cancel(bw->cancellable);
+  g_clear_object(&bw->cancellable);
+  if (bw->proxy)
+    g_signal_handlers_disconnect_by_data(bw->proxy, bw);
+  g_clear_object(&bw->proxy);
+  free(bw);
+}
+
 static void on_battery_button_click(GtkButton *self, gpointer data) {
   GtkWidget *revealer = data;
   gboolean open = gtk_revealer_get_child_revealed(GTK_REVEALER(revealer));
@@ -127,30 +193,15 @@ static void on_battery_button_click(GtkButton *self, gpointer data) {
 
 static void on_power_profile_button_click(GtkButton *self, gpointer data) {
   char *cmd = data;
-  GError *error = NULL;
-  gboolean success =
-      g_spawn_sync(NULL, // working dir
-                   (gchar *[]){"powerprofilesctl", "set", cmd, NULL},
-                   NULL,                // envp
-                   G_SPAWN_SEARCH_PATH, // flags
-                   NULL,                // child setup
-                   NULL,                // user data
-                   NULL,                // stdout
-                   NULL,                // stderr
-                   NULL,                // exit status
-                   &error);
-
-  if (!success) {
-    g_printerr("Error: %s\n", error->message);
-    g_error_free(error);
-  }
+  SPAWN("powerprofilesctl", "set", cmd);
 }
 
 void start_battery_widget(GtkWidget *box, GDBusConnection *connection) {
   GtkWidget *battery_button = gtk_button_new();
   GtkWidget *battery_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
   GtkWidget *image = gtk_image_new_from_icon_name("battery-symbolic");
-  GtkWidget *label = gtk_label_new("...");
+  GtkWidget *label = battery_label_new();
+  stable_label_set_text(STABLE_LABEL(label), "...");
 
   GdkCursor *pointer = get_pointer_cursor();
   gtk_widget_set_cursor(battery_button, pointer);
@@ -189,27 +240,46 @@ void start_battery_widget(GtkWidget *box, GDBusConnection *connection) {
   g_signal_connect(battery_button, "clicked",
                    G_CALLBACK(on_battery_button_click), revealer);
 
+  const Snapshot *snapshot = snapshot_get();
+  if (snapshot->known & SNAPSHOT_BATTERY)
+    battery_ui_set(image, label, snapshot->battery_percentage,
+                   snapshot->battery_charging);
+
   struct BatteryWidgets *bw = calloc(1, sizeof(struct BatteryWidgets));
   bw->label = label;
   bw->image = image;
-
-  // Create proxy for the battery device
-  GError *error = NULL;
-  GDBusProxy *proxy =
-      g_dbus_proxy_new_sync(connection, G_DBUS_PROXY_FLAGS_NONE,
-                            NULL, // Interface info (NULL = auto introspect)
-                            "org.freedesktop.UPower", dbus_path,
-                            "org.freedesktop.UPower.Device", NULL, &error);
-
-  if (!proxy) {
-    g_printerr("Failed to create proxy: %s\n", error->message);
-    g_error_free(error);
+  bw->cancellable = g_cancellable_new();
+  g_object_set_data_full(G_OBJECT(label), "battery-widgets", bw,
+                         battery_widgets_free);
+
+  // Without a connection it follows the snapshot, see backend_client.c
+  if (!connection) {
+    snapshot_connect_owned(on_snapshot_changed, bw, label);
+    on_snapshot_changed(snapshot->known, bw);
     return;
   }
 
-  initial_sync(proxy, bw);
+  // Create proxy for the battery device, until then the label shows the
+  // last known value or "..."
+  g_dbus_proxy_new(connection, G_DBUS_PROXY_FLAGS_NONE,
+                   NULL, // Interface info (NULL = auto introspect)
+                   "org.freedesktop.UPower", dbus_path,
+                   "org.freedesktop.UPower.Device", bw->cancellable,
+                   on_proxy_ready, bw);
+}
 
-  // Connect to PropertiesChanged via proxy
-  g_signal_connect(proxy, "g-properties-changed",
-                   G_CALLBACK(on_proxy_properties_changed), bw);
+// The last known battery state, NULL if there is none
+GtkWidget *battery_snapshot_new(void) {
+  const Snapshot *snapshot = snapshot_get();
+  if (!(snapshot->known & SNAPSHOT_BATTERY))
+    return NULL;
+
+  GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+  GtkWidget *image = gtk_image_new();
+  GtkWidget *label = battery_label_new();
+  gtk_box_append(GTK_BOX(box), image);
+  gtk_box_append(GTK_BOX(box), label);
+  battery_ui_set(image, label, snapshot->battery_percentage,
+                 snapshot->battery_charging);
+  return box;
 }
@@ -5,5 +5,6 @@
 #include <gtk/gtk.h>
 
 void start_battery_widget(GtkWidget *box, GDBusConnection *connection);
+GtkWidget *battery_snapshot_new(void);
 
 #endif // !BATTERY_H
@@ -2,36 +2,101 @@
 #include "glib.h"
 #include "gtk/gtk.h"
 #include "gtk/gtkshortcut.h"
+#include "indicator_strip.h"
+#include "stable_label.h"
+#include "updates.h"
 
 static const gchar FORMAT_MINUTES[] = "%H:%M";
 static const gchar FORMAT_SECONDS[] = "%H:%M:%S";
 static const gchar *current_format = FORMAT_MINUTES;
+// With tabular digits every time is as wide as these
+static const gchar WIDEST_MINUTES[] = "00:00";
+static const gchar WIDEST_SECONDS[] = "00:00:00";
+static const gchar WIDEST_DATE[] = "00.00.00";
 
 typedef struct {
   GtkWidget *date_label;
   GtkWidget *time_label;
+  // Instead of the labels with CWIDGETS_INDICATOR_STRIP=1
+  IndicatorStrip *strip;
+  guint timeout_id;
 } DateTimeWidgets;
 
-static gboolean on_timeout(gpointer data) {
+// Formats the time when applied, a suspended bar shows the current time
+static void apply_date_time(gpointer data) {
   DateTimeWidgets *dtw = data;
-  GDateTime *now = g_date_time_new_now_local();
-  gchar *time_formatted = g_date_time_format(now, current_format);
-  gchar *date_formatted = g_date_time_format(now, "%d.%m.%y");
+  g_autoptr(GDateTime) now = g_date_time_new_now_local();
+  g_autofree gchar *time_formatted = g_date_time_format(now, current_format);
+  g_autofree gchar *date_formatted = g_date_time_format(now, "%d.%m.%y");
+
+  if (dtw->strip) {
+    indicator_strip_set_text(dtw->strip, INDICATOR_TIME, time_formatted);
+    indicator_strip_set_text(dtw->strip, INDICATOR_DATE, date_formatted);
+    return;
+  }
+  // Only redraws, the labels keep their width
+  stable_label_set_text(STABLE_LABEL(dtw->time_label), time_formatted);
+  stable_label_set_text(STABLE_LABEL(dtw->date_label), date_formatted);
+}
+
+static void date_time_start(DateTimeWidgets *dtw);
 
-  gtk_label_set_text(GTK_LABEL(dtw->time_label), time_formatted);
-  gtk_label_set_text(GTK_LABEL(dtw->date_label), date_formatted);
+static void on_resumed(gpointer data) { date_time_start(data); }
 
+// Stops while the bar is suspended, on_resumed starts it again
+static gboolean on_timeout(gpointer data) {
+  DateTimeWidgets *dtw = data;
+  GtkWidget *widget = dtw->strip ? GTK_WIDGET(dtw->strip) : dtw->time_label;
+
+  if (bar_updates_when_resumed(widget, on_resumed, dtw)) {
+    dtw->timeout_id = 0;
+    return G_SOURCE_REMOVE;
+  }
+  bar_post_update(widget, apply_date_time, dtw);
   return G_SOURCE_CONTINUE;
 }
 
+// Shows the time right away, then every second
+static void date_time_start(DateTimeWidgets *dtw) {
+  if (!on_timeout(dtw))
+    return;
+  dtw->timeout_id = g_timeout_add(1000, on_timeout, dtw);
+  g_source_set_name_by_id(dtw->timeout_id, "date-time");
+}
+
+static void date_time_widgets_free(gpointer data) {
+  DateTimeWidgets *dtw = data;
+  g_clear_handle_id(&dtw->timeout_id, g_source_remove);
+  g_free(dtw);
+}
+
 void start_date_time_widget(GtkWidget *box) {
   DateTimeWidgets *dtw = g_new0(DateTimeWidgets, 1);
-  dtw->date_label = gtk_label_new("DATE");
-  dtw->time_label = gtk_label_new("TIME");
+  dtw->date_label = stable_label_new(WIDEST_DATE);
+  dtw->time_label = stable_label_new(
+      current_format == FORMAT_SECONDS ? WIDEST_SECONDS : WIDEST_MINUTES);
+  gtk_widget_set_name(dtw->date_label, "date");
+  gtk_widget_set_name(dtw->time_label, "clock");
+  g_object_set_data_full(G_OBJECT(dtw->time_label), "date-time-widgets", dtw,
+                         date_time_widgets_free);
 
   gtk_box_append(GTK_BOX(box), dtw->time_label);
   gtk_box_append(GTK_BOX(box), dtw->date_label);
 
-  g_timeout_add(1000, on_timeout, dtw);
-  on_timeout(dtw);
+  date_time_start(dtw);
+}
+
+void start_date_time_indicator(IndicatorStrip *strip) {
+  DateTimeWidgets *dtw = g_new0(DateTimeWidgets, 1);
+  dtw->strip = strip;
+  indicator_strip_set_widest(
+      strip, INDICATOR_TIME,
+      current_format == FORMAT_SECONDS ? WIDEST_SECONDS : WIDEST_MINUTES);
+  indicator_strip_set_widest(strip, INDICATOR_DATE, WIDEST_DATE);
+  indicator_strip_set_visible(strip, INDICATOR_TIME, TRUE);
+  indicator_strip_set_visible(strip, INDICATOR_DATE, TRUE);
+  g_object_set_data_full(G_OBJECT(strip), "date-time-widgets", dtw,
+                         date_time_widgets_free);
+
+  date_time_start(dtw);
 }
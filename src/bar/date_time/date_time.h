@@ -1,8 +1,10 @@
 #ifndef DATE_TIME_H
 #define DATE_TIME_H
 
+#include "indicator_strip.h"
 #include <gtk/gtk.h>
 
 void start_date_time_widget(GtkWidget *box);
+void start_date_time_indicator(IndicatorStrip *strip);
 
 #endif // !DATE_TIME_H
@@ -0,0 +1,444 @@
+#include "indicator_strip.h"
+#include "layout_stats.h"
+#include "status_icons.h"
+#include <glib-object.h>
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <pango/pangocairo.h>
+
+// Between an icon and its text, in parts of the font size
+#define ICON_TEXT_SPACING_EM 0.3
+
+/*
+ * The bluetooth, volume, wifi, time and date indicators of the bar as one
+ * widget, enabled with CWIDGETS_INDICATOR_STRIP=1.
+ *
+ * Instead of a box of boxes with images and labels, every indicator is one
+ * "indicator" node that draws its icon and text itself: icons from the
+ * status icon cache and one PangoLayout per text, kept until the font
+ * changes. Texts reserve the width of their widest value like StableLabel,
+ * so most updates only redraw. That is 6 css nodes per bar, the strip and
+ * its 5 indicators.
+ *
+ * The indicators are only there to be styled, see "indicators" in
+ * style.scss: the spacing of the indicators is the border-spacing of the
+ * strip, icons are as large as the font of their indicator, and a
+ * placeholder gets the .placeholder class like the slots of startup.c. Each
+ * indicator also has its id as a class, like .audio or .time.
+ *
+ * Every indicator has its own tooltip, and indicator_strip_get_at is the
+ * one under a point.
+ */
+
+#define INDICATOR_ITEM_TYPE indicator_item_get_type()
+G_DECLARE_FINAL_TYPE(IndicatorItem, indicator_item, INDICATOR, ITEM,
+                     GtkWidget)
+
+struct _IndicatorItem {
+  GtkWidget parent_instance;
+  // Either a status icon or a named one, or no icon if neither is set
+  gboolean has_status_icon;
+  StatusIconSet set;
+  guint index;
+  gchar *icon_name;
+  // Looked up from icon_name, dropped with the icon theme, scale or font
+  GdkPaintable *named_icon;
+  // NULL without text
+  PangoLayout *text;
+  PangoLayout *widest;
+  gboolean text_visible;
+  // To tell font changes from other style changes
+  PangoFontDescription *font;
+  // In pixels, from the font
+  int icon_size;
+  int spacing;
+};
+
+G_DEFINE_TYPE(IndicatorItem, indicator_item, GTK_TYPE_WIDGET)
+
+struct _IndicatorStrip {
+  GtkWidget parent_instance;
+  // IndicatorItem, in the order of IndicatorId
+  GtkWidget *items[INDICATOR_N];
+};
+
+G_DEFINE_TYPE(IndicatorStrip, indicator_strip, GTK_TYPE_WIDGET)
+
+// The css classes of the indicators
+static const gchar *const indicator_names[INDICATOR_N] = {
+    [INDICATOR_BLUETOOTH] = "bluetooth", [INDICATOR_AUDIO] = "audio",
+    [INDICATOR_WIFI] = "wifi",           [INDICATOR_TIME] = "time",
+    [INDICATOR_DATE] = "date",
+};
+
+static gboolean has_icon(IndicatorItem *self) {
+  return self->has_status_icon || self->icon_name;
+}
+
+static gboolean has_text(IndicatorItem *self) {
+  return self->text && self->text_visible;
+}
+
+static void text_size(IndicatorItem *self, int *width, int *height) {
+  int text_width, text_height, widest_width, widest_height;
+  pango_layout_get_pixel_size(self->text, &text_width, &text_height);
+  pango_layout_get_pixel_size(self->widest, &widest_width, &widest_height);
+  *width = MAX(text_width, widest_width);
+  *height = MAX(text_height, widest_height);
+}
+
+// Font size of the css node in pixels
+static double font_pixels(GtkWidget *widget) {
+  PangoContext *context = gtk_widget_get_pango_context(widget);
+  const PangoFontDescription *font =
+      pango_context_get_font_description(context);
+  double size = pango_units_to_double(pango_font_description_get_size(font));
+  if (pango_font_description_get_size_is_absolute(font))
+    return size;
+
+  double dpi = pango_cairo_context_get_resolution(context);
+  return size * (dpi > 0 ? dpi : 96) / 72;
+}
+
+/*
+ * Returns FALSE if the font did not change, hover and the like only change
+ * the color
+ */
+static gboolean item_update_font(IndicatorItem *self) {
+  GtkWidget *widget = GTK_WIDGET(self);
+  const PangoFontDescription *font =
+      pango_context_get_font_description(gtk_widget_get_pango_context(widget));
+  if (self->font && pango_font_description_equal(self->font, font))
+    return FALSE;
+
+  g_clear_pointer(&self->font, pango_font_description_free);
+  self->font = pango_font_description_copy(font);
+  double size = font_pixels(widget);
+  self->icon_size = MAX((int)(size + 0.5), 1);
+  self->spacing = (int)(size * ICON_TEXT_SPACING_EM + 0.5);
+  g_clear_object(&self->named_icon);
+  if (self->text) {
+    pango_layout_context_changed(self->text);
+    pango_layout_context_changed(self->widest);
+  }
+  return TRUE;
+}
+
+static GdkPaintable *item_icon(IndicatorItem *self) {
+  GtkWidget *widget = GTK_WIDGET(self);
+
+  if (self->has_status_icon)
+    return status_icons_lookup(widget, self->set, self->index);
+  if (!self->named_icon) {
+    GtkIconTheme *theme =
+        gtk_icon_theme_get_for_display(gtk_widget_get_display(widget));
+    self->named_icon = GDK_PAINTABLE(gtk_icon_theme_lookup_icon(
+        theme, self->icon_name, NULL, self->icon_size,
+        gtk_widget_get_scale_factor(widget), GTK_TEXT_DIR_NONE, 0));
+  }
+  return self->named_icon;
+}
+
+static void item_drop_named_icon(IndicatorItem *self) {
+  if (!self->named_icon)
+    return;
+  g_clear_object(&self->named_icon);
+  gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+static void indicator_item_measure(GtkWidget *widget,
+                                   GtkOrientation orientation, int for_size,
+                                   int *minimum, int *natural,
+                                   int *minimum_baseline,
+                                   int *natural_baseline) {
+  IndicatorItem *self = INDICATOR_ITEM(widget);
+  int size = 0;
+  layout_stats_count(widget, LAYOUT_STATS_MEASURE);
+  item_update_font(self);
+
+  if (has_icon(self))
+    size = self->icon_size;
+
+  if (has_text(self)) {
+    int width, height;
+    text_size(self, &width, &height);
+    if (orientation == GTK_ORIENTATION_HORIZONTAL)
+      size += (size > 0 ? self->spacing : 0) + width;
+    else
+      size = MAX(size, height);
+  }
+
+  *minimum = *natural = size;
+}
+
+static void indicator_item_size_allocate(GtkWidget *widget, int width,
+                                         int height, int baseline) {
+  layout_stats_count(widget, LAYOUT_STATS_ALLOCATE);
+}
+
+static void indicator_item_snapshot(GtkWidget *widget,
+                                    GtkSnapshot *snapshot) {
+  IndicatorItem *self = INDICATOR_ITEM(widget);
+  int height = gtk_widget_get_height(widget);
+  float x = 0;
+  GdkRGBA color;
+  gtk_widget_get_color(widget, &color);
+
+  if (has_icon(self)) {
+    GdkPaintable *icon = item_icon(self);
+    int size = self->icon_size;
+    gtk_snapshot_save(snapshot);
+    gtk_snapshot_translate(snapshot,
+                           &GRAPHENE_POINT_INIT(0, (height - size) / 2.0f));
+    if (GTK_IS_SYMBOLIC_PAINTABLE(icon))
+      gtk_symbolic_paintable_snapshot_symbolic(GTK_SYMBOLIC_PAINTABLE(icon),
+                                               snapshot, size, size, &color,
+                                               1);
+    else if (icon)
+      gdk_paintable_snapshot(icon, snapshot, size, size);
+    gtk_snapshot_restore(snapshot);
+    x += size + self->spacing;
+  }
+
+  if (has_text(self)) {
+    int width, text_height, reserved_width, reserved_height;
+    pango_layout_get_pixel_size(self->text, &width, &text_height);
+    text_size(self, &reserved_width, &reserved_height);
+
+    // Centered in the reserved width
+    gtk_snapshot_save(snapshot);
+    gtk_snapshot_translate(
+        snapshot, &GRAPHENE_POINT_INIT(x + (reserved_width - width) / 2.0f,
+                                       (height - text_height) / 2.0f));
+    gtk_snapshot_append_layout(snapshot, self->text, &color);
+    gtk_snapshot_restore(snapshot);
+  }
+}
+
+static void indicator_item_css_changed(GtkWidget *widget,
+                                       GtkCssStyleChange *change) {
+  GTK_WIDGET_CLASS(indicator_item_parent_class)->css_changed(widget, change);
+  if (item_update_font(INDICATOR_ITEM(widget)))
+    gtk_widget_queue_resize(widget);
+}
+
+static void indicator_item_dispose(GObject *object) {
+  IndicatorItem *self = INDICATOR_ITEM(object);
+
+  g_clear_pointer(&self->icon_name, g_free);
+  g_clear_object(&self->named_icon);
+  g_clear_object(&self->text);
+  g_clear_object(&self->widest);
+  g_clear_pointer(&self->font, pango_font_description_free);
+
+  G_OBJECT_CLASS(indicator_item_parent_class)->dispose(object);
+}
+
+static void indicator_item_class_init(IndicatorItemClass *klass) {
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+  object_class->dispose = indicator_item_dispose;
+  widget_class->measure = indicator_item_measure;
+  widget_class->size_allocate = indicator_item_size_allocate;
+  widget_class->snapshot = indicator_item_snapshot;
+  widget_class->css_changed = indicator_item_css_changed;
+
+  gtk_widget_class_set_css_name(widget_class, "indicator");
+}
+
+static void indicator_item_init(IndicatorItem *self) {
+  gtk_widget_set_name(GTK_WIDGET(self), "indicator");
+  g_signal_connect(self, "notify::scale-factor",
+                   G_CALLBACK(item_drop_named_icon), NULL);
+}
+
+static PangoLayout *create_layout(IndicatorItem *self) {
+  PangoLayout *layout = gtk_widget_create_pango_layout(GTK_WIDGET(self), NULL);
+  PangoAttrList *attrs = pango_attr_list_new();
+  pango_attr_list_insert(attrs, pango_attr_font_features_new("tnum"));
+  pango_layout_set_attributes(layout, attrs);
+  pango_attr_list_unref(attrs);
+  return layout;
+}
+
+static void ensure_text(IndicatorItem *self) {
+  if (self->text)
+    return;
+  self->text = create_layout(self);
+  self->widest = create_layout(self);
+  self->text_visible = TRUE;
+}
+
+static IndicatorItem *get_item(IndicatorStrip *self, IndicatorId id) {
+  return INDICATOR_ITEM(self->items[id]);
+}
+
+static void drop_named_icons(IndicatorStrip *self) {
+  for (guint i = 0; i < INDICATOR_N; i++)
+    item_drop_named_icon(get_item(self, i));
+}
+
+static void indicator_strip_root(GtkWidget *widget) {
+  GTK_WIDGET_CLASS(indicator_strip_parent_class)->root(widget);
+
+  GtkIconTheme *theme =
+      gtk_icon_theme_get_for_display(gtk_widget_get_display(widget));
+  g_signal_connect_object(theme, "changed", G_CALLBACK(drop_named_icons),
+                          widget, G_CONNECT_SWAPPED);
+}
+
+static void indicator_strip_unroot(GtkWidget *widget) {
+  GtkIconTheme *theme =
+      gtk_icon_theme_get_for_display(gtk_widget_get_display(widget));
+  g_signal_handlers_disconnect_by_func(theme, drop_named_icons, widget);
+
+  GTK_WIDGET_CLASS(indicator_strip_parent_class)->unroot(widget);
+}
+
+static void indicator_strip_dispose(GObject *object) {
+  IndicatorStrip *self = INDICATOR_STRIP(object);
+
+  for (guint i = 0; i < INDICATOR_N; i++)
+    g_clear_pointer(&self->items[i], gtk_widget_unparent);
+
+  G_OBJECT_CLASS(indicator_strip_parent_class)->dispose(object);
+}
+
+static void indicator_strip_class_init(IndicatorStripClass *klass) {
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+  object_class->dispose = indicator_strip_dispose;
+  widget_class->root = indicator_strip_root;
+  widget_class->unroot = indicator_strip_unroot;
+
+  // Horizontal, spaced by the border-spacing of the strip
+  gtk_widget_class_set_layout_manager_type(widget_class, GTK_TYPE_BOX_LAYOUT);
+  gtk_widget_class_set_css_name(widget_class, "indicators");
+}
+
+static void indicator_strip_init(IndicatorStrip *self) {
+  gtk_widget_set_name(GTK_WIDGET(self), "indicators");
+
+  for (guint i = 0; i < INDICATOR_N; i++) {
+    self->items[i] = g_object_new(INDICATOR_ITEM_TYPE, NULL);
+    gtk_widget_add_css_class(self->items[i], indicator_names[i]);
+    gtk_widget_set_visible(self->items[i], FALSE);
+    gtk_widget_set_parent(self->items[i], GTK_WIDGET(self));
+  }
+}
+
+gboolean indicator_strip_enabled(void) {
+  return g_strcmp0(g_getenv("CWIDGETS_INDICATOR_STRIP"), "1") == 0;
+}
+
+// Every indicator starts out hidden
+GtkWidget *indicator_strip_new(void) {
+  return g_object_new(INDICATOR_STRIP_TYPE, NULL);
+}
+
+void indicator_strip_set_status_icon(IndicatorStrip *self, IndicatorId id,
+                                     StatusIconSet set, guint index) {
+  IndicatorItem *item = get_item(self, id);
+  if (item->has_status_icon && item->set == set && item->index == index)
+    return;
+
+  gboolean resize = !has_icon(item);
+  g_clear_pointer(&item->icon_name, g_free);
+  g_clear_object(&item->named_icon);
+  item->has_status_icon = TRUE;
+  item->set = set;
+  item->index = index;
+  if (resize)
+    gtk_widget_queue_resize(GTK_WIDGET(item));
+  else
+    gtk_widget_queue_draw(GTK_WIDGET(item));
+}
+
+void indicator_strip_set_icon_name(IndicatorStrip *self, IndicatorId id,
+                                   const gchar *icon_name) {
+  IndicatorItem *item = get_item(self, id);
+  if (g_strcmp0(item->icon_name, icon_name) == 0)
+    return;
+
+  gboolean resize = !has_icon(item) || !icon_name;
+  g_free(item->icon_name);
+  item->icon_name = g_strdup(icon_name);
+  g_clear_object(&item->named_icon);
+  item->has_status_icon = FALSE;
+  if (resize)
+    gtk_widget_queue_resize(GTK_WIDGET(item));
+  else
+    gtk_widget_queue_draw(GTK_WIDGET(item));
+}
+
+// Only redraws while the text fits into the widest one
+void indicator_strip_set_text(IndicatorStrip *self, IndicatorId id,
+                              const gchar *text) {
+  IndicatorItem *item = get_item(self, id);
+  ensure_text(item);
+  if (g_strcmp0(pango_layout_get_text(item->text), text) == 0)
+    return;
+
+  int old_width, old_height, width, height;
+  text_size(item, &old_width, &old_height);
+  pango_layout_set_text(item->text, text ? text : "", -1);
+  text_size(item, &width, &height);
+  if (width != old_width || height != old_height)
+    gtk_widget_queue_resize(GTK_WIDGET(item));
+  else
+    gtk_widget_queue_draw(GTK_WIDGET(item));
+}
+
+void indicator_strip_set_widest(IndicatorStrip *self, IndicatorId id,
+                                const gchar *widest) {
+  IndicatorItem *item = get_item(self, id);
+  ensure_text(item);
+  pango_layout_set_text(item->widest, widest ? widest : "", -1);
+  gtk_widget_queue_resize(GTK_WIDGET(item));
+}
+
+void indicator_strip_set_text_visible(IndicatorStrip *self, IndicatorId id,
+                                      gboolean visible) {
+  IndicatorItem *item = get_item(self, id);
+  ensure_text(item);
+  if (item->text_visible == visible)
+    return;
+  item->text_visible = visible;
+  gtk_widget_queue_resize(GTK_WIDGET(item));
+}
+
+void indicator_strip_set_tooltip(IndicatorStrip *self, IndicatorId id,
+                                 const gchar *tooltip) {
+  GtkWidget *item = self->items[id];
+  if (g_strcmp0(gtk_widget_get_tooltip_text(item), tooltip) == 0)
+    return;
+  gtk_widget_set_tooltip_text(item, tooltip);
+}
+
+void indicator_strip_set_visible(IndicatorStrip *self, IndicatorId id,
+                                 gboolean visible) {
+  gtk_widget_set_visible(self->items[id], visible);
+}
+
+// Dims the indicator like the placeholders of startup.c
+void indicator_strip_set_placeholder(IndicatorStrip *self, IndicatorId id,
+                                     gboolean placeholder) {
+  if (placeholder)
+    gtk_widget_add_css_class(self->items[id], "placeholder");
+  else
+    gtk_widget_remove_css_class(self->items[id], "placeholder");
+}
+
+// The indicator at x, y in widget coordinates, or INDICATOR_NONE
+gint indicator_strip_get_at(IndicatorStrip *self, double x, double y) {
+  GtkWidget *picked =
+      gtk_widget_pick(GTK_WIDGET(self), x, y, GTK_PICK_DEFAULT);
+
+  for (guint i = 0; i < INDICATOR_N; i++) {
+    if (picked && picked == self->items[i])
+      return i;
+  }
+  return INDICATOR_NONE;
+}
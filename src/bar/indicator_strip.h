@@ -0,0 +1,49 @@
+#ifndef INDICATOR_STRIP_H
+#define INDICATOR_STRIP_H
+
+#include "status_icons.h"
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+// In the order they are shown
+typedef enum {
+  INDICATOR_BLUETOOTH,
+  INDICATOR_AUDIO,
+  INDICATOR_WIFI,
+  INDICATOR_TIME,
+  INDICATOR_DATE,
+  INDICATOR_N,
+} IndicatorId;
+
+#define INDICATOR_NONE -1
+
+#define INDICATOR_STRIP_TYPE indicator_strip_get_type()
+G_DECLARE_FINAL_TYPE(IndicatorStrip, indicator_strip, INDICATOR /*Module*/,
+                     STRIP /*Object name*/, GtkWidget)
+
+gboolean indicator_strip_enabled(void);
+GtkWidget *indicator_strip_new(void);
+
+void indicator_strip_set_status_icon(IndicatorStrip *self, IndicatorId id,
+                                     StatusIconSet set, guint index);
+void indicator_strip_set_icon_name(IndicatorStrip *self, IndicatorId id,
+                                   const gchar *icon_name);
+void indicator_strip_set_text(IndicatorStrip *self, IndicatorId id,
+                              const gchar *text);
+void indicator_strip_set_widest(IndicatorStrip *self, IndicatorId id,
+                                const gchar *widest);
+void indicator_strip_set_text_visible(IndicatorStrip *self, IndicatorId id,
+                                      gboolean visible);
+void indicator_strip_set_tooltip(IndicatorStrip *self, IndicatorId id,
+                                 const gchar *tooltip);
+void indicator_strip_set_visible(IndicatorStrip *self, IndicatorId id,
+                                 gboolean visible);
+void indicator_strip_set_placeholder(IndicatorStrip *self, IndicatorId id,
+                                     gboolean placeholder);
+gint indicator_strip_get_at(IndicatorStrip *self, double x, double y);
+
+G_END_DECLS
+
+#endif // !INDICATOR_STRIP_H
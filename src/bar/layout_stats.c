@@ -0,0 +1,100 @@
+#include "layout_stats.h"
+#include <glib.h>
+#include <gtk/gtk.h>
+
+// Counts are logged and reset this often
+#define REPORT_INTERVAL_SECONDS 10
+
+/*
+ * Debug counters for size negotiation, enabled with CWIDGETS_LAYOUT_STATS=1.
+ *
+ * Counts the layout phases of every watched window and the measure and
+ * allocate passes of widgets that report them, by widget name. An idle bar
+ * should log no layouts at all, a clock tick only redraws.
+ */
+typedef struct {
+  gboolean enabled;
+  // Widget or window name -> guint64[LAYOUT_STATS_N_PASSES]
+  GHashTable *counts;
+  // Layout phases of all watched windows
+  guint64 layouts;
+} LayoutStats;
+
+static LayoutStats stats = {0};
+
+static const gchar *pass_names[LAYOUT_STATS_N_PASSES] = {
+    [LAYOUT_STATS_MEASURE] = "measure",
+    [LAYOUT_STATS_ALLOCATE] = "allocate",
+};
+
+static gboolean on_report(gpointer user_data) {
+  g_autoptr(GString) report = g_string_new("Layout stats:");
+  g_string_append_printf(report, " %" G_GUINT64_FORMAT " window layouts",
+                         stats.layouts);
+
+  GHashTableIter iter;
+  gpointer name, counts;
+  g_hash_table_iter_init(&iter, stats.counts);
+  while (g_hash_table_iter_next(&iter, &name, &counts)) {
+    guint64 *c = counts;
+    g_string_append_printf(report, ", %s", (const gchar *)name);
+    for (guint i = 0; i < LAYOUT_STATS_N_PASSES; i++)
+      g_string_append_printf(report, " %" G_GUINT64_FORMAT " %s", c[i],
+                             pass_names[i]);
+  }
+  g_message("%s", report->str);
+
+  stats.layouts = 0;
+  g_hash_table_remove_all(stats.counts);
+  return G_SOURCE_CONTINUE;
+}
+
+gboolean layout_stats_enabled(void) {
+  static gsize initialized = 0;
+  if (g_once_init_enter(&initialized)) {
+    stats.enabled = g_strcmp0(g_getenv("CWIDGETS_LAYOUT_STATS"), "1") == 0;
+    if (stats.enabled) {
+      stats.counts =
+          g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+      g_timeout_add_seconds(REPORT_INTERVAL_SECONDS, on_report, NULL);
+    }
+    g_once_init_leave(&initialized, 1);
+  }
+  return stats.enabled;
+}
+
+// Counted by gtk_widget_get_name, so give the widgets telling names
+void layout_stats_count(GtkWidget *widget, LayoutStatsPass pass) {
+  if (!layout_stats_enabled())
+    return;
+
+  const gchar *name = gtk_widget_get_name(widget);
+  guint64 *counts = g_hash_table_lookup(stats.counts, name);
+  if (!counts) {
+    counts = g_new0(guint64, LAYOUT_STATS_N_PASSES);
+    g_hash_table_insert(stats.counts, g_strdup(name), counts);
+  }
+  counts[pass]++;
+}
+
+static void on_layout(GdkFrameClock *frame_clock, gpointer user_data) {
+  stats.layouts++;
+}
+
+static void on_window_map(GtkWidget *window, gpointer user_data) {
+  g_signal_handlers_disconnect_by_func(window, on_window_map, user_data);
+  GdkFrameClock *frame_clock = gtk_widget_get_frame_clock(window);
+  if (frame_clock)
+    g_signal_connect_object(frame_clock, "layout", G_CALLBACK(on_layout),
+                            window, 0);
+}
+
+// Counts the layout phases of the window, which every resize goes through
+void layout_stats_watch_window(GtkWidget *window) {
+  if (!layout_stats_enabled())
+    return;
+  if (gtk_widget_get_mapped(window))
+    on_window_map(window, NULL);
+  else
+    g_signal_connect(window, "map", G_CALLBACK(on_window_map), NULL);
+}
@@ -0,0 +1,16 @@
+#ifndef LAYOUT_STATS_H
+#define LAYOUT_STATS_H
+
+#include <gtk/gtk.h>
+
+typedef enum {
+  LAYOUT_STATS_MEASURE,
+  LAYOUT_STATS_ALLOCATE,
+  LAYOUT_STATS_N_PASSES,
+} LayoutStatsPass;
+
+gboolean layout_stats_enabled(void);
+void layout_stats_count(GtkWidget *widget, LayoutStatsPass pass);
+void layout_stats_watch_window(GtkWidget *window);
+
+#endif // !LAYOUT_STATS_H
@@ -0,0 +1,155 @@
+#include "stable_label.h"
+#include "layout_stats.h"
+#include <glib-object.h>
+#include <glib.h>
+#include <gtk/gtk.h>
+
+/*
+ * A single line of text with a width that does not follow the text.
+ *
+ * A GtkLabel resizes on every new text, and the resize goes up through the
+ * bar and every sibling. This one reserves the width of the widest text it
+ * will show, with tabular digits so "11:11" is as wide as "00:00", and only
+ * redraws when the text changes. Only a text wider than the reserved one
+ * grows it.
+ *
+ * Styled like a label, with the "label" css name.
+ */
+struct _StableLabel {
+  GtkWidget parent_instance;
+  PangoLayout *layout;
+  // Measures the reserved width
+  PangoLayout *widest;
+  // To tell font changes from other style changes
+  PangoFontDescription *font;
+};
+
+G_DEFINE_TYPE(StableLabel, stable_label, GTK_TYPE_WIDGET)
+
+static PangoLayout *create_layout(StableLabel *self, const gchar *text) {
+  PangoLayout *layout = gtk_widget_create_pango_layout(GTK_WIDGET(self), text);
+  PangoAttrList *attrs = pango_attr_list_new();
+  pango_attr_list_insert(attrs, pango_attr_font_features_new("tnum"));
+  pango_layout_set_attributes(layout, attrs);
+  pango_attr_list_unref(attrs);
+  return layout;
+}
+
+static void stable_label_measure(GtkWidget *widget,
+                                 GtkOrientation orientation, int for_size,
+                                 int *minimum, int *natural,
+                                 int *minimum_baseline, int *natural_baseline) {
+  StableLabel *self = STABLE_LABEL(widget);
+  int widest_width, widest_height, width, height;
+  layout_stats_count(widget, LAYOUT_STATS_MEASURE);
+
+  pango_layout_get_pixel_size(self->widest, &widest_width, &widest_height);
+  pango_layout_get_pixel_size(self->layout, &width, &height);
+
+  if (orientation == GTK_ORIENTATION_HORIZONTAL) {
+    *minimum = *natural = MAX(widest_width, width);
+  } else {
+    *minimum = *natural = MAX(widest_height, height);
+  }
+}
+
+static void stable_label_size_allocate(GtkWidget *widget, int width,
+                                       int height, int baseline) {
+  layout_stats_count(widget, LAYOUT_STATS_ALLOCATE);
+}
+
+static void stable_label_snapshot(GtkWidget *widget, GtkSnapshot *snapshot) {
+  StableLabel *self = STABLE_LABEL(widget);
+  int width, height;
+  GdkRGBA color;
+
+  pango_layout_get_pixel_size(self->layout, &width, &height);
+  gtk_widget_get_color(widget, &color);
+
+  // Centered in the reserved width
+  gtk_snapshot_save(snapshot);
+  gtk_snapshot_translate(
+      snapshot,
+      &GRAPHENE_POINT_INIT((gtk_widget_get_width(widget) - width) / 2.0f,
+                           (gtk_widget_get_height(widget) - height) / 2.0f));
+  gtk_snapshot_append_layout(snapshot, self->layout, &color);
+  gtk_snapshot_restore(snapshot);
+}
+
+static void stable_label_css_changed(GtkWidget *widget,
+                                     GtkCssStyleChange *change) {
+  StableLabel *self = STABLE_LABEL(widget);
+  GTK_WIDGET_CLASS(stable_label_parent_class)->css_changed(widget, change);
+
+  // Hover and the like only change the color
+  const PangoFontDescription *font =
+      pango_context_get_font_description(gtk_widget_get_pango_context(widget));
+  if (self->font && pango_font_description_equal(self->font, font))
+    return;
+
+  g_clear_pointer(&self->font, pango_font_description_free);
+  self->font = pango_font_description_copy(font);
+  pango_layout_context_changed(self->layout);
+  pango_layout_context_changed(self->widest);
+  gtk_widget_queue_resize(widget);
+}
+
+static void stable_label_dispose(GObject *object) {
+  StableLabel *self = STABLE_LABEL(object);
+
+  g_clear_object(&self->layout);
+  g_clear_object(&self->widest);
+  g_clear_pointer(&self->font, pango_font_description_free);
+
+  G_OBJECT_CLASS(stable_label_parent_class)->dispose(object);
+}
+
+static void stable_label_class_init(StableLabelClass *klass) {
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+  object_class->dispose = stable_label_dispose;
+  widget_class->measure = stable_label_measure;
+  widget_class->size_allocate = stable_label_size_allocate;
+  widget_class->snapshot = stable_label_snapshot;
+  widget_class->css_changed = stable_label_css_changed;
+
+  gtk_widget_class_set_css_name(widget_class, "label");
+  gtk_widget_class_set_accessible_role(widget_class,
+                                       GTK_ACCESSIBLE_ROLE_LABEL);
+}
+
+static void stable_label_init(StableLabel *self) {
+  self->layout = create_layout(self, NULL);
+  self->widest = create_layout(self, NULL);
+}
+
+// widest is the widest text it is going to show, e.g. "100%"
+GtkWidget *stable_label_new(const gchar *widest) {
+  StableLabel *self = g_object_new(STABLE_LABEL_TYPE, NULL);
+  stable_label_set_widest(self, widest);
+  return GTK_WIDGET(self);
+}
+
+void stable_label_set_text(StableLabel *self, const gchar *text) {
+  if (g_strcmp0(pango_layout_get_text(self->layout), text) == 0)
+    return;
+
+  int old_width, width;
+  pango_layout_get_pixel_size(self->layout, &old_width, NULL);
+  pango_layout_set_text(self->layout, text ? text : "", -1);
+  pango_layout_get_pixel_size(self->layout, &width, NULL);
+
+  // Within the reserved width nothing else has to move
+  int reserved;
+  pango_layout_get_pixel_size(self->widest, &reserved, NULL);
+  if (MAX(width, old_width) > reserved)
+    gtk_widget_queue_resize(GTK_WIDGET(self));
+  else
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+void stable_label_set_widest(StableLabel *self, const gchar *widest) {
+  pango_layout_set_text(self->widest, widest ? widest : "", -1);
+  gtk_widget_queue_resize(GTK_WIDGET(self));
+}
@@ -0,0 +1,19 @@
+#ifndef STABLE_LABEL_H
+#define STABLE_LABEL_H
+
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define STABLE_LABEL_TYPE stable_label_get_type()
+G_DECLARE_FINAL_TYPE(StableLabel, stable_label, STABLE /*Module*/,
+                     LABEL /*Object name*/, GtkWidget)
+
+GtkWidget *stable_label_new(const gchar *widest);
+void stable_label_set_text(StableLabel *self, const gchar *text);
+void stable_label_set_widest(StableLabel *self, const gchar *widest);
+
+G_END_DECLS
+
+#endif // !STABLE_LABEL_H
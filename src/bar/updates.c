@@ -0,0 +1,352 @@
+#include "updates.h"
+#include "glib.h"
+#include "gtk/gtk.h"
+#include "hyprland.h"
+#include "metrics.h"
+#include "state.h"
+#include "trace.h"
+
+/*
+ * Schedules widget updates of a window on its frame clock.
+ *
+ * Backends keep their latest state themselves and post a function applying
+ * it. However often a function is posted, it runs once on the next frame
+ * with whatever state is latest by then, so a burst of dbus or pipewire
+ * signals costs one relayout instead of one per signal. Functions posted
+ * with an interval run at most once per interval.
+ *
+ * Bars additionally hold everything back while a fullscreen window covers
+ * their monitor, and apply it in one frame once it goes away. Timers of
+ * their widgets stop meanwhile, see bar_updates_when_resumed.
+ *
+ * With tracing, a post starts a flow that goes through the update applying
+ * it to the paint of the frame and its presentation, see trace.h.
+ */
+typedef struct {
+  BarUpdateFunc update;
+  gpointer data;
+  gint64 interval; // us
+  gint64 last_applied;
+  gboolean pending;
+#ifdef CWIDGETS_TRACE
+  guint64 flow; // Of the pending post
+#endif
+} ScheduledUpdate;
+
+typedef struct {
+  BarUpdateFunc func;
+  gpointer data;
+  // Invalidated when the widget that asked is disposed
+  GClosure *owner;
+} ResumeCallback;
+
+typedef struct {
+  GtkWidget *window;
+  // One per update and data ever posted, there are only a few
+  GArray *updates; // ScheduledUpdate
+  guint n_pending;
+  guint tick_id;
+  // Waits for rate limited updates that are not due yet
+  guint timeout_id;
+  gint64 timeout_due;
+
+  // Only set for bars, see bar_updates_attach
+  Hyprland *hyprland;
+  HyprlandState *state;
+  // Connector name, which hyprland uses as monitor name
+  gchar *monitor;
+  gboolean suspended;
+  // Called once on the next resume
+  GArray *on_resume; // ResumeCallback
+#ifdef CWIDGETS_TRACE
+  // Flows of the updates applied since the last paint
+  GArray *flows; // guint64
+  gint64 paint_start;
+#endif
+} BarUpdates;
+
+static void bar_updates_schedule(BarUpdates *bu);
+
+static gboolean on_tick(GtkWidget *widget, GdkFrameClock *frame_clock,
+                        gpointer user_data) {
+  BarUpdates *bu = user_data;
+  gint64 now = g_get_monotonic_time();
+  bu->tick_id = 0;
+
+  if (bu->suspended)
+    return G_SOURCE_REMOVE;
+
+  // Updates may post others, which appends and moves the array
+  for (guint i = 0; i < bu->updates->len; i++) {
+    ScheduledUpdate *u = &g_array_index(bu->updates, ScheduledUpdate, i);
+    if (!u->pending || now - u->last_applied < u->interval)
+      continue;
+
+    u->pending = FALSE;
+    u->last_applied = now;
+    bu->n_pending--;
+    metrics_inc(METRICS_BAR_UPDATES_APPLIED);
+#ifdef CWIDGETS_TRACE
+    TRACE_SPAN("apply update");
+    TRACE_FLOW_STEP(u->flow);
+    g_array_append_val(bu->flows, u->flow);
+#endif
+    u->update(u->data);
+  }
+
+  bar_updates_schedule(bu);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean on_timeout(gpointer user_data) {
+  BarUpdates *bu = user_data;
+  bu->timeout_id = 0;
+  bar_updates_schedule(bu);
+  return G_SOURCE_REMOVE;
+}
+
+// Asks for a frame if a pending update is due, or waits until one is
+static void bar_updates_schedule(BarUpdates *bu) {
+  if (bu->suspended || bu->n_pending == 0 || bu->tick_id)
+    return;
+
+  gint64 now = g_get_monotonic_time();
+  gint64 due = G_MAXINT64;
+  for (guint i = 0; i < bu->updates->len; i++) {
+    ScheduledUpdate *u = &g_array_index(bu->updates, ScheduledUpdate, i);
+    if (u->pending)
+      due = MIN(due, u->last_applied + u->interval);
+  }
+
+  // Already waiting long enough, a newly posted update may be due earlier
+  if (due > now && bu->timeout_id && bu->timeout_due <= due)
+    return;
+  if (bu->timeout_id) {
+    g_source_remove(bu->timeout_id);
+    bu->timeout_id = 0;
+  }
+
+  if (due <= now)
+    bu->tick_id = gtk_widget_add_tick_callback(bu->window, on_tick, bu, NULL);
+  else {
+    bu->timeout_id = g_timeout_add((due - now + 999) / 1000, on_timeout, bu);
+    g_source_set_name_by_id(bu->timeout_id, "bar-updates");
+    bu->timeout_due = due;
+  }
+}
+
+static void resume_callbacks_free(GArray *callbacks) {
+  for (guint i = 0; i < callbacks->len; i++)
+    g_closure_unref(g_array_index(callbacks, ResumeCallback, i).owner);
+  g_array_unref(callbacks);
+}
+
+static void bar_updates_resumed(BarUpdates *bu) {
+  // Callbacks may ask to be called on the next resume again
+  GArray *callbacks = bu->on_resume;
+  bu->on_resume = g_array_new(FALSE, FALSE, sizeof(ResumeCallback));
+
+  for (guint i = 0; i < callbacks->len; i++) {
+    ResumeCallback *c = &g_array_index(callbacks, ResumeCallback, i);
+    if (!c->owner->is_invalid)
+      c->func(c->data);
+  }
+  resume_callbacks_free(callbacks);
+}
+
+static void on_hyprland_changed(Hyprland *hyprland, guint changes,
+                                gpointer user_data) {
+  BarUpdates *bu = user_data;
+
+  if (!(changes & (HYPRLAND_CHANGED_FULLSCREEN | HYPRLAND_CHANGED_ACTIVE |
+                   HYPRLAND_CHANGED_WORKSPACES)))
+    return;
+
+  gboolean suspended =
+      hyprland_state_monitor_is_fullscreen(bu->state, bu->monitor);
+  if (suspended == bu->suspended)
+    return;
+
+  bu->suspended = suspended;
+  g_debug("Bar on %s %s", bu->monitor, suspended ? "suspended" : "resumed");
+  if (!suspended)
+    bar_updates_resumed(bu);
+  bar_updates_schedule(bu);
+}
+
+#ifdef CWIDGETS_TRACE
+typedef struct {
+  GdkFrameClock *frame_clock;
+  gint64 frame_counter;
+  gint64 paint_end;
+} TracedFrame;
+
+// Wayland reports the presentation a bit after the paint
+static gboolean on_presentation_timeout(gpointer data) {
+  TracedFrame *frame = data;
+  GdkFrameTimings *timings =
+      gdk_frame_clock_get_timings(frame->frame_clock, frame->frame_counter);
+  if (timings && gdk_frame_timings_get_complete(timings) &&
+      gdk_frame_timings_get_presentation_time(timings))
+    TRACE_COMPLETE("presentation", frame->paint_end,
+                   gdk_frame_timings_get_presentation_time(timings));
+
+  g_object_unref(frame->frame_clock);
+  g_free(frame);
+  return G_SOURCE_REMOVE;
+}
+
+static void on_trace_paint(GdkFrameClock *frame_clock, gpointer user_data) {
+  BarUpdates *bu = g_object_get_data(G_OBJECT(user_data), "bar-updates");
+  bu->paint_start = g_get_monotonic_time();
+}
+
+static void on_trace_after_paint(GdkFrameClock *frame_clock,
+                                 gpointer user_data) {
+  BarUpdates *bu = g_object_get_data(G_OBJECT(user_data), "bar-updates");
+  if (bu->flows->len == 0)
+    return;
+
+  // Ends the flows in a span of the paint
+  for (guint i = 0; i < bu->flows->len; i++)
+    TRACE_FLOW_END(g_array_index(bu->flows, guint64, i));
+  g_array_set_size(bu->flows, 0);
+
+  TracedFrame *frame = g_new0(TracedFrame, 1);
+  frame->frame_clock = g_object_ref(frame_clock);
+  frame->frame_counter = gdk_frame_clock_get_frame_counter(frame_clock);
+  frame->paint_end = g_get_monotonic_time();
+  TRACE_COMPLETE("paint", bu->paint_start, frame->paint_end);
+  g_timeout_add(100, on_presentation_timeout, frame);
+}
+
+static void on_trace_map(GtkWidget *window, gpointer user_data) {
+  g_signal_handlers_disconnect_by_func(window, on_trace_map, user_data);
+  GdkFrameClock *frame_clock = gtk_widget_get_frame_clock(window);
+  g_signal_connect_object(frame_clock, "paint", G_CALLBACK(on_trace_paint),
+                          window, 0);
+  g_signal_connect_object(frame_clock, "after-paint",
+                          G_CALLBACK(on_trace_after_paint), window, 0);
+}
+#endif
+
+static void bar_updates_free(gpointer data) {
+  BarUpdates *bu = data;
+  // The tick callback goes away with the window
+  if (bu->timeout_id)
+    g_source_remove(bu->timeout_id);
+  if (bu->hyprland) {
+    g_signal_handlers_disconnect_by_data(bu->hyprland, bu);
+    g_object_unref(bu->hyprland);
+  }
+  g_array_unref(bu->updates);
+  resume_callbacks_free(bu->on_resume);
+#ifdef CWIDGETS_TRACE
+  g_array_unref(bu->flows);
+#endif
+  g_free(bu->monitor);
+  g_free(bu);
+}
+
+// Owned by the window
+static BarUpdates *bar_updates_get(GtkWidget *window) {
+  BarUpdates *bu = g_object_get_data(G_OBJECT(window), "bar-updates");
+  if (bu)
+    return bu;
+
+  bu = g_new0(BarUpdates, 1);
+  bu->window = window;
+  bu->updates = g_array_new(FALSE, FALSE, sizeof(ScheduledUpdate));
+  bu->on_resume = g_array_new(FALSE, FALSE, sizeof(ResumeCallback));
+  g_object_set_data_full(G_OBJECT(window), "bar-updates", bu,
+                         bar_updates_free);
+#ifdef CWIDGETS_TRACE
+  bu->flows = g_array_new(FALSE, FALSE, sizeof(guint64));
+  g_signal_connect(window, "map", G_CALLBACK(on_trace_map), NULL);
+#endif
+  return bu;
+}
+
+/*
+ * Suspends updates of the widgets in window while the monitor shows a
+ * fullscreen window, maximized ones leave it visible. The window itself
+ * stays mapped.
+ */
+void bar_updates_attach(GtkWidget *window, GdkMonitor *monitor) {
+  BarUpdates *bu = bar_updates_get(window);
+  bu->hyprland = hyprland_get_default();
+  bu->state = hyprland_get_state(bu->hyprland);
+  bu->monitor = g_strdup(gdk_monitor_get_connector(monitor));
+  bu->suspended = hyprland_state_monitor_is_fullscreen(bu->state, bu->monitor);
+
+  g_signal_connect(bu->hyprland, "changed", G_CALLBACK(on_hyprland_changed),
+                   bu);
+}
+
+/*
+ * Calls update(data) on the next frame of the window of widget, at most
+ * once every interval_ms. Posting it again before then does nothing, so
+ * update has to read the latest state when it runs.
+ *
+ * Widgets not in a window yet are updated right away.
+ */
+void bar_post_update_limited(GtkWidget *widget, BarUpdateFunc update,
+                             gpointer data, guint interval_ms) {
+  GtkRoot *root = gtk_widget_get_root(widget);
+  if (!root) {
+    update(data);
+    return;
+  }
+
+  BarUpdates *bu = bar_updates_get(GTK_WIDGET(root));
+  ScheduledUpdate *u = NULL;
+  for (guint i = 0; i < bu->updates->len && !u; i++) {
+    ScheduledUpdate *candidate =
+        &g_array_index(bu->updates, ScheduledUpdate, i);
+    if (candidate->update == update && candidate->data == data)
+      u = candidate;
+  }
+
+  if (!u) {
+    ScheduledUpdate new_update = {.update = update, .data = data};
+    g_array_append_val(bu->updates, new_update);
+    u = &g_array_index(bu->updates, ScheduledUpdate, bu->updates->len - 1);
+  }
+
+  u->interval = (gint64)interval_ms * 1000;
+  if (!u->pending) {
+    u->pending = TRUE;
+    bu->n_pending++;
+    TRACE_FLOW_NEW(u->flow);
+  } else {
+    // Coalesced into the pending post
+    TRACE_FLOW_STEP(u->flow);
+  }
+  bar_updates_schedule(bu);
+}
+
+// Calls update(data) on the next frame, see bar_post_update_limited
+void bar_post_update(GtkWidget *widget, BarUpdateFunc update, gpointer data) {
+  bar_post_update_limited(widget, update, data, 0);
+}
+
+/*
+ * For timers that should not wake up a suspended bar: if the bar of widget
+ * is suspended, calls func(data) once it resumes, unless widget is disposed
+ * by then, and returns TRUE. Returns FALSE and does nothing otherwise.
+ */
+gboolean bar_updates_when_resumed(GtkWidget *widget, BarUpdateFunc func,
+                                  gpointer data) {
+  GtkRoot *root = gtk_widget_get_root(widget);
+  BarUpdates *bu =
+      root ? g_object_get_data(G_OBJECT(root), "bar-updates") : NULL;
+  if (!bu || !bu->suspended)
+    return FALSE;
+
+  ResumeCallback c = {.func = func, .data = data};
+  c.owner = g_closure_ref(g_closure_new_simple(sizeof(GClosure), NULL));
+  g_closure_sink(c.owner);
+  g_object_watch_closure(G_OBJECT(widget), c.owner);
+  g_array_append_val(bu->on_resume, c);
+  return TRUE;
+}
@@ -0,0 +1,16 @@
+#ifndef BAR_UPDATES_H
+#define BAR_UPDATES_H
+
+#include <gtk/gtk.h>
+
+// Applies the latest state of a widget to its gtk widgets
+typedef void (*BarUpdateFunc)(gpointer data);
+
+void bar_updates_attach(GtkWidget *window, GdkMonitor *monitor);
+void bar_post_update(GtkWidget *widget, BarUpdateFunc update, gpointer data);
+void bar_post_update_limited(GtkWidget *widget, BarUpdateFunc update,
+                             gpointer data, guint interval_ms);
+gboolean bar_updates_when_resumed(GtkWidget *widget, BarUpdateFunc func,
+                                  gpointer data);
+
+#endif // !BAR_UPDATES_H
@@ -1,16 +1,16 @@
 #include "wifi_icon.h"
 #include "glib-object.h"
+#include "metrics.h"
 #include "networking.h"
+#include "snapshot.h"
+#include "status_icons.h"
+#include "trace.h"
+#include "updates.h"
+#include "util.h"
 #include <NetworkManager.h>
 #include <glib.h>
 #include <gtk/gtk.h>
 
-static const char ICON_EXCELLENT[] =
-    "network-wireless-signal-excellent-symbolic";
-static const char ICON_OK[] = "network-wireless-signal-ok-symbolic";
-static const char ICON_GOOD[] = "network-wireless-signal-good-symbolic";
-static const char ICON_WEAK[] = "network-wireless-signal-weak-symbolic";
-static const char ICON_NONE[] = "network-wireless-signal-none-symbolic";
 static const char ICON_ACQUIRING[] = "network-wireless-acquiring-symbolic";
 static const char ICON_CONNECTED[] = "network-wireless-connected-symbolic";
 static const char ICON_DISABLED[] = "network-wireless-disabled-symbolic";
@@ -18,93 +18,188 @@ static const char ICON_OFFLINE[] = "network-wireless-offline-symbolic";
 static const char ICON_NO_ROUTE[] = "network-wireless-no-route-symbolic";
 static const char ICON_HOTSPOT[] = "network-wireless-hotspot-symbolic";
 
+// Strength jitters all the time, no need to follow every change
+#define STRENGTH_INTERVAL_MS 2000
+
 void active_ap_state_free(ActiveApState *s) {
   if (!s)
     return;
   if (s->strength_handler_id && s->previous_ap)
     g_signal_handler_disconnect(s->previous_ap, s->strength_handler_id);
   g_clear_object(&s->previous_ap);
+  g_free(s->tooltip);
   g_free(s);
 }
 
-void add_wifi_widget(GtkWidget *box) {
+static void apply_wifi_icon(gpointer data) {
+  ActiveApState *s = data;
+  if (s->strip) {
+    indicator_strip_set_tooltip(s->strip, INDICATOR_WIFI, s->tooltip);
+    indicator_strip_set_status_icon(s->strip, INDICATOR_WIFI,
+                                    STATUS_ICONS_WIFI, s->icon);
+    return;
+  }
+  gtk_widget_set_tooltip_text(s->image, s->tooltip);
+  status_icons_set(s->image, STATUS_ICONS_WIFI, s->icon);
+}
+
+// The last known connection, NULL if there is none
+GtkWidget *wifi_snapshot_new(void) {
+  const Snapshot *snapshot = snapshot_get();
+  if (!(snapshot->known & SNAPSHOT_WIFI))
+    return NULL;
+
+  gboolean connected = snapshot->wifi_ssid[0] != '\0';
+  GtkWidget *image = gtk_image_new();
+  status_icons_set(image, STATUS_ICONS_WIFI,
+                   status_icons_wifi_index(connected, snapshot->wifi_strength));
+  gtk_widget_set_tooltip_text(image, connected ? snapshot->wifi_ssid
+                                               : "disconnected");
+  return image;
+}
+
+static void on_snapshot_changed(guint32 fields, gpointer user_data) {
+  ActiveApState *s = user_data;
+  const Snapshot *snapshot = snapshot_get();
+  if (!(fields & SNAPSHOT_WIFI))
+    return;
+
+  gboolean connected = snapshot->wifi_ssid[0] != '\0';
+  g_free(s->tooltip);
+  s->tooltip = g_strdup(connected ? snapshot->wifi_ssid : "disconnected");
+  s->icon = status_icons_wifi_index(connected, snapshot->wifi_strength);
+  bar_post_update(s->image, apply_wifi_icon, s);
+}
+
+/*
+ * Follows the active access point of the wifi device, owner holds s. In split
+ * mode it follows the snapshot instead, as written by backend_client.c.
+ */
+static void wifi_connect(ActiveApState *s, NMDeviceWifi *wifi_device,
+                         gboolean follow_snapshot, GtkWidget *owner) {
+  g_object_set_data_full(G_OBJECT(owner), "wifi-state", s,
+                         (GDestroyNotify)active_ap_state_free);
+
+  if (follow_snapshot) {
+    snapshot_connect_owned(on_snapshot_changed, s, owner);
+    on_snapshot_changed(snapshot_get()->known, s);
+    return;
+  }
+
+  // Nothing updates the snapshot then, so it is not shown either
+  if (NULL == wifi_device) {
+    s->tooltip = g_strdup("No wifi device");
+    s->icon = status_icons_wifi_index(FALSE, 0);
+    bar_post_update(s->image, apply_wifi_icon, s);
+    return;
+  }
+
+  // The device outlives the bar
+  signal_connect_owned(wifi_device, "notify::active-access-point",
+                       G_CALLBACK(on_active_ap_changed), s, owner);
+
+  on_active_ap_changed(wifi_device, NULL, s);
+}
+
+// wifi_device may be NULL, see wifi_connect
+void add_wifi_widget(GtkWidget *box, NMDeviceWifi *wifi_device,
+                     gboolean follow_snapshot) {
   if (!GTK_IS_BOX(box)) {
     g_warning("Tried to add wifi widget to widget that is not a box");
     return;
   }
 
   ActiveApState *activeApState = calloc(1, sizeof(ActiveApState));
-  g_object_set_data_full(G_OBJECT(box), "wifi-state", activeApState,
-                         (GDestroyNotify)active_ap_state_free);
 
-  GtkWidget *image = gtk_image_new_from_icon_name(ICON_OFFLINE);
+  GtkWidget *image = wifi_snapshot_new();
+  if (!image)
+    image = gtk_image_new_from_icon_name(ICON_OFFLINE);
   gtk_box_append(GTK_BOX(box), image);
   activeApState->image = image;
 
-  NMDeviceWifi *wifi_device = net_get_wifi_device();
-  if (NULL == wifi_device)
-    return;
+  wifi_connect(activeApState, wifi_device, follow_snapshot, box);
+}
 
-  g_signal_connect(wifi_device, "notify::active-access-point",
-                   G_CALLBACK(on_active_ap_changed), activeApState);
+// Shows the last known connection, or a placeholder until add_wifi_indicator
+void wifi_indicator_init(IndicatorStrip *strip) {
+  const Snapshot *snapshot = snapshot_get();
+  gboolean known = snapshot->known & SNAPSHOT_WIFI;
+  gboolean connected = known && snapshot->wifi_ssid[0] != '\0';
+
+  indicator_strip_set_visible(strip, INDICATOR_WIFI, TRUE);
+  indicator_strip_set_status_icon(
+      strip, INDICATOR_WIFI, STATUS_ICONS_WIFI,
+      status_icons_wifi_index(connected, snapshot->wifi_strength));
+  if (known)
+    indicator_strip_set_tooltip(strip, INDICATOR_WIFI,
+                                connected ? snapshot->wifi_ssid
+                                          : "disconnected");
+  else
+    indicator_strip_set_placeholder(strip, INDICATOR_WIFI, TRUE);
+}
 
-  on_active_ap_changed(wifi_device, NULL, activeApState);
+void add_wifi_indicator(IndicatorStrip *strip, NMDeviceWifi *wifi_device,
+                        gboolean follow_snapshot) {
+  ActiveApState *activeApState = calloc(1, sizeof(ActiveApState));
+  activeApState->strip = strip;
+  // Where the updates are posted to
+  activeApState->image = GTK_WIDGET(strip);
 
-  g_object_unref(wifi_device);
+  indicator_strip_set_placeholder(strip, INDICATOR_WIFI, FALSE);
+  wifi_connect(activeApState, wifi_device, follow_snapshot,
+               GTK_WIDGET(strip));
 }
 
 void on_active_ap_changed(NMDeviceWifi *device, GParamSpec *pspec,
                           gpointer user_data) {
+  TRACE_SPAN("network: access point changed");
+  metrics_inc(METRICS_NETWORK_SIGNALS);
   ActiveApState *s = user_data;
-  GtkWidget *image = s->image;
 
   if (s->strength_handler_id && s->previous_ap) {
     g_message("Prev ap(%p) handler(%lu)", (void *)s->previous_ap,
               s->strength_handler_id);
     g_signal_handler_disconnect(s->previous_ap, s->strength_handler_id);
-    g_clear_object(&s->previous_ap);
     s->strength_handler_id = 0;
   }
+  g_clear_object(&s->previous_ap);
 
   NMAccessPoint *_ap = nm_device_wifi_get_active_access_point(device);
   if (_ap) {
+    // Kept to disconnect from it later
     NMAccessPoint *ap = g_object_ref(_ap);
-    if (s->previous_ap)
-      s->previous_ap = g_object_ref(ap);
+    s->previous_ap = ap;
 
     g_autofree char *ssid_str = ap_get_ssid(ap);
     if (!ssid_str)
       return;
 
-    gtk_widget_set_tooltip_text(image, ssid_str);
+    g_free(s->tooltip);
+    s->tooltip = g_steal_pointer(&ssid_str);
 
     s->strength_handler_id = g_signal_connect(
         ap, "notify::strength", G_CALLBACK(on_strength_changed), s);
 
     on_strength_changed(ap, NULL, s);
   } else {
-    gtk_widget_set_tooltip_text(image, "disconnected");
-    gtk_image_set_from_icon_name(GTK_IMAGE(image), ICON_OFFLINE);
+    g_free(s->tooltip);
+    s->tooltip = g_strdup("disconnected");
+    s->icon = status_icons_wifi_index(FALSE, 0);
+    snapshot_set_wifi(NULL, 0);
   }
+
+  // Without the strength limit, a new access point is shown right away
+  bar_post_update(s->image, apply_wifi_icon, s);
 }
 
 void on_strength_changed(NMAccessPoint *ap, GParamSpec *pspec,
                          gpointer user_data) {
+  TRACE_SPAN("network: strength changed");
+  metrics_inc(METRICS_NETWORK_SIGNALS);
   ActiveApState *s = user_data;
-  GtkWidget *image = s->image;
   guint8 strength = nm_access_point_get_strength(ap); // 0–100%
 
-  const char *icon;
-  if (strength >= 80)
-    icon = ICON_EXCELLENT;
-  else if (strength >= 60)
-    icon = ICON_GOOD;
-  else if (strength >= 40)
-    icon = ICON_OK;
-  else if (strength >= 20)
-    icon = ICON_WEAK;
-  else
-    icon = ICON_NONE;
-
-  gtk_image_set_from_icon_name(GTK_IMAGE(image), icon);
+  s->icon = status_icons_wifi_index(TRUE, strength);
+  snapshot_set_wifi(s->tooltip, strength);
+  bar_post_update_limited(s->image, apply_wifi_icon, s, STRENGTH_INTERVAL_MS);
 }
@@ -3,15 +3,26 @@
 
 #include "NetworkManager.h"
 #include "glib-object.h"
+#include "indicator_strip.h"
 #include <gtk/gtk.h>
 
 typedef struct {
   GtkWidget *image;
+  // Instead of image with CWIDGETS_INDICATOR_STRIP=1
+  IndicatorStrip *strip;
   gulong strength_handler_id;
   NMAccessPoint *previous_ap;
+  // Latest values, shown by apply_wifi_icon
+  gchar *tooltip;
+  guint icon; // In STATUS_ICONS_WIFI
 } ActiveApState;
 
-void add_wifi_widget(GtkWidget *box);
+void add_wifi_widget(GtkWidget *box, NMDeviceWifi *wifi_device,
+                     gboolean follow_snapshot);
+GtkWidget *wifi_snapshot_new(void);
+void wifi_indicator_init(IndicatorStrip *strip);
+void add_wifi_indicator(IndicatorStrip *strip, NMDeviceWifi *wifi_device,
+                        gboolean follow_snapshot);
 
 void on_strength_changed(NMAccessPoint *ap, GParamSpec *pspec,
                          gpointer user_data);
@@ -0,0 +1,66 @@
+#include "window_title.h"
+#include "glib.h"
+#include "gtk/gtk.h"
+#include "hyprland.h"
+#include "state.h"
+#include "updates.h"
+
+#define MAX_WIDTH_CHARS 60
+
+/*
+ * Shows the title of the focused window.
+ *
+ * Titles can change many times per second, the bar applies only the latest
+ * one once per frame.
+ */
+typedef struct {
+  GtkWidget *label;
+  Hyprland *hyprland;
+  HyprlandState *state;
+} WindowTitleWidget;
+
+static void update_title(gpointer data) {
+  WindowTitleWidget *wtw = data;
+  HyprlandWindow *window = hyprland_state_get_active_window(wtw->state);
+  const gchar *title = window ? window->title->str : "";
+
+  if (g_strcmp0(gtk_label_get_text(GTK_LABEL(wtw->label)), title) != 0)
+    gtk_label_set_text(GTK_LABEL(wtw->label), title);
+  gtk_widget_set_visible(wtw->label, *title != '\0');
+}
+
+static void on_hyprland_changed(Hyprland *hyprland, guint changes,
+                                gpointer user_data) {
+  WindowTitleWidget *wtw = user_data;
+
+  if (changes & HYPRLAND_CHANGED_ACTIVE_WINDOW)
+    bar_post_update(wtw->label, update_title, wtw);
+}
+
+static void window_title_widget_free(gpointer data) {
+  WindowTitleWidget *wtw = data;
+  g_signal_handlers_disconnect_by_data(wtw->hyprland, wtw);
+  g_object_unref(wtw->hyprland);
+  g_free(wtw);
+}
+
+void start_window_title_widget(GtkWidget *box) {
+  WindowTitleWidget *wtw = g_new0(WindowTitleWidget, 1);
+  wtw->hyprland = hyprland_get_default();
+  wtw->state = hyprland_get_state(wtw->hyprland);
+  wtw->label = gtk_label_new(NULL);
+  gtk_widget_add_css_class(wtw->label, "window-title");
+
+  // The label ellipsizes long titles itself, no copies needed
+  gtk_label_set_single_line_mode(GTK_LABEL(wtw->label), TRUE);
+  gtk_label_set_ellipsize(GTK_LABEL(wtw->label), PANGO_ELLIPSIZE_END);
+  gtk_label_set_max_width_chars(GTK_LABEL(wtw->label), MAX_WIDTH_CHARS);
+
+  g_object_set_data_full(G_OBJECT(wtw->label), "window-title-widget", wtw,
+                         window_title_widget_free);
+  g_signal_connect(wtw->hyprland, "changed", G_CALLBACK(on_hyprland_changed),
+                   wtw);
+
+  gtk_box_append(GTK_BOX(box), wtw->label);
+  update_title(wtw);
+}
@@ -0,0 +1,8 @@
+#ifndef WINDOW_TITLE_H
+#define WINDOW_TITLE_H
+
+#include <gtk/gtk.h>
+
+void start_window_title_widget(GtkWidget *box);
+
+#endif // !WINDOW_TITLE_H
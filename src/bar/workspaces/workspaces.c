@@ -1,299 +1,297 @@
 #include "workspaces.h"
-#include "cJSON.h"
+#include "app_icons.h"
 #include "glib-object.h"
 #include "glib.h"
 #include "glibconfig.h"
 #include "gtk/gtk.h"
 #include "gtk/gtkshortcut.h"
+#include "hyprland.h"
+#include "ipc.h"
+#include "metrics.h"
+#include "state.h"
+#include "updates.h"
 #include "util.h"
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <unistd.h>
+
+// Most icons shown on one workspace button
+#define MAX_ICONS 4
 
 typedef struct {
-  gint id;
-  char *name;
-  char *active_window;
-} Workspace;
-
-void workspace_free(gpointer data) {
-  Workspace *w = data;
-  g_free(w->name);
-  g_free(w->active_window);
-  g_free(w);
-}
+  GtkWidget *button;
+  GtkWidget *label;
+  // One image per window on the workspace
+  GtkWidget *icons;
+  // HyprlandWorkspace.windows_version the icons were set for
+  guint64 windows_version;
+} WorkspaceButton;
 
 typedef struct {
   GtkWidget *box;
-  gint active_workspace_id;
+  Hyprland *hyprland;
+  AppIcons *app_icons;
+  HyprlandState *state;
+  // Hyprland name of the monitor the bar is on, NULL shows every workspace
+  gchar *monitor;
+  // Workspace id -> WorkspaceButton, the widgets are owned by the box
+  GHashTable *buttons;
+  GtkWidget *active_button;
+  // Reused by every update so they do not allocate
   GPtrArray *workspaces;
-  guint index;
-} HyprlandState;
-
-static void hyprland_state_free(HyprlandState *hs) {
-  if (!hs)
-    return;
-  g_clear_object(&hs->workspaces); // unrefs and sets to NULL
-  g_free(hs);                      // free the struct itself
-}
-
-G_DEFINE_AUTOPTR_CLEANUP_FUNC(HyprlandState, hyprland_state_free)
-
-static gint workspace_compare(gconstpointer a_p, gconstpointer b_p) {
-  const Workspace *a = a_p;
-  const Workspace *b = b_p;
-  if (a->id < b->id)
-    return -1;
-  else if (a->id > b->id)
-    return 1;
-  else
-    return 0;
-}
-
-// Caller must close the socket
-static int hyprland_sock(void) {
-  const char *xdg_runtime_dir = getenv("XDG_RUNTIME_DIR");
-  const char *hyprland_instance = getenv("HYPRLAND_INSTANCE_SIGNATURE");
-
-  if (!xdg_runtime_dir || !hyprland_instance) {
-    g_printerr("Hyprland environment variables not set.\n");
-    return -1;
-  }
-
-  char socket_path[256];
-  snprintf(socket_path, sizeof(socket_path), "%s/hypr/%s/.socket2.sock",
-           xdg_runtime_dir, hyprland_instance);
+  GPtrArray *windows;
+  // HyprlandChange flags not applied yet, the bar may be suspended
+  guint pending_changes;
+  // The app icons were resolved again, every icon has to be set
+  gboolean app_icons_changed;
+} WorkspacesWidget;
 
-  int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
-  if (sockfd < 0) {
-    g_printerr("Could not create hyprland socket\n");
-    return -1;
-  }
+static void on_button_click(GtkButton *self, gpointer data) {
+  WorkspacesWidget *ww = data;
 
-  struct sockaddr_un sockaddr;
-  sockaddr.sun_family = AF_UNIX;
-  strncpy(sockaddr.sun_path, socket_path, sizeof(sockaddr.sun_path) - 1);
+  gint workspace_id =
+      GPOINTER_TO_INT(g_object_get_data(G_OBJECT(self), "workspace-id"));
 
-  if (connect(sockfd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) < 0) {
-    g_printerr("Could not connect to hyprland socket: %s\n", g_strerror(errno));
-    close(sockfd);
-    return -1;
-  }
+  if (ww->state->active_workspace_id == workspace_id)
+    return;
 
-  return sockfd;
+  char buf[32] = {0};
+  snprintf(buf, sizeof(buf), "dispatch workspace %d", workspace_id);
+  // Hyprland answers with "ok", the workspacev2 event updates the ui
+  hyprland_ipc_request(buf, NULL, NULL, NULL);
 }
 
-int hyprland_ipc1(const char *msg, char *output, gint output_len) {
-  const char *xdg_runtime_dir = getenv("XDG_RUNTIME_DIR");
-  const char *hyprland_instance = getenv("HYPRLAND_INSTANCE_SIGNATURE");
-
-  if (!xdg_runtime_dir || !hyprland_instance) {
-    g_printerr("Hyprland environment variables not set.\n");
-    return -1;
-  }
-
-  char socket_path[256];
-  snprintf(socket_path, sizeof(socket_path), "%s/hypr/%s/.socket.sock",
-           xdg_runtime_dir, hyprland_instance);
-
-  int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
-  if (sockfd < 0) {
-    g_printerr("Could not create hyprland socket\n");
-    return -1;
-  }
-
-  struct sockaddr_un sockaddr;
-  sockaddr.sun_family = AF_UNIX;
-  strncpy(sockaddr.sun_path, socket_path, sizeof(sockaddr.sun_path) - 1);
+// The workspace shown on this bar's monitor
+static gint get_active_workspace_id(WorkspacesWidget *ww) {
+  HyprlandMonitor *monitor = hyprland_state_get_monitor(ww->state, ww->monitor);
+  if (monitor)
+    return monitor->active_workspace_id;
+  return ww->state->active_workspace_id;
+}
 
-  if (connect(sockfd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) < 0) {
-    g_printerr("Could not connect to hyprland socket: %s\n", g_strerror(errno));
-    close(sockfd);
-    return -1;
-  }
+static void set_active_workspace(WorkspacesWidget *ww) {
+  WorkspaceButton *wb = g_hash_table_lookup(
+      ww->buttons, GINT_TO_POINTER(get_active_workspace_id(ww)));
+  GtkWidget *button = wb ? wb->button : NULL;
+  if (button == ww->active_button)
+    return;
 
-  if (write(sockfd, msg, strlen(msg)) < 0) {
-    g_printerr("Could not write %s to the hyprland socket\n", msg);
-    close(sockfd);
-    return -1;
-  }
+  if (ww->active_button)
+    gtk_widget_remove_css_class(ww->active_button, "active");
+  if (button)
+    gtk_widget_add_css_class(button, "active");
+  ww->active_button = button;
+}
 
-  size_t len = read(sockfd, output, output_len - 1);
-  close(sockfd);
+static void set_tooltip(GtkWidget *button, const gchar *tooltip) {
+  if (g_strcmp0(gtk_widget_get_tooltip_text(button), tooltip) != 0)
+    gtk_widget_set_tooltip_text(button, tooltip);
+}
 
-  if (len <= 0) {
-    g_printerr("Could not read from hyprland socket\n");
-    return -1;
+static void set_tooltips(WorkspacesWidget *ww) {
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init(&iter, ww->buttons);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    HyprlandWorkspace *workspace =
+        hyprland_state_get_workspace(ww->state, GPOINTER_TO_INT(key));
+    if (workspace)
+      set_tooltip(((WorkspaceButton *)value)->button,
+                  workspace->last_window_title->str);
   }
-
-  output[len] = '\0';
-
-  return 0;
 }
 
-int get_hyprland_workspaces(GPtrArray *array) {
-  char buffer[8192] = {0};
-  int count = 0;
-
-  if (hyprland_ipc1("j/workspaces", buffer, sizeof(buffer)) != 0)
-    return -1;
-
-  cJSON *root = cJSON_Parse(buffer);
-  if (!root) {
-    g_message("Invalid json from hyprland ipc");
-    return -1;
+// Reuses the images that are there and only swaps icons that changed
+static void set_icons(WorkspacesWidget *ww, WorkspaceButton *wb,
+                      HyprlandWorkspace *workspace) {
+  wb->windows_version = workspace->windows_version;
+  hyprland_state_get_windows(ww->state, workspace->id, ww->windows);
+
+  GtkWidget *image = gtk_widget_get_first_child(wb->icons);
+  guint shown = 0;
+  for (; shown < ww->windows->len && shown < MAX_ICONS; shown++) {
+    HyprlandWindow *window = g_ptr_array_index(ww->windows, shown);
+    GdkPaintable *icon = app_icons_lookup(ww->app_icons, window->class->str);
+
+    if (!image) {
+      image = gtk_image_new();
+      gtk_box_append(GTK_BOX(wb->icons), image);
+    }
+    if (gtk_image_get_paintable(GTK_IMAGE(image)) != icon)
+      gtk_image_set_from_paintable(GTK_IMAGE(image), icon);
+    image = gtk_widget_get_next_sibling(image);
   }
 
-  count = cJSON_GetArraySize(root);
-
-  for (int i = 0; i < count; i++) {
-    cJSON *item = cJSON_GetArrayItem(root, i);
-    cJSON *id_item = cJSON_GetObjectItem(item, "id");
-    cJSON *name_item = cJSON_GetObjectItem(item, "name");
-    cJSON *title_item = cJSON_GetObjectItem(item, "lastwindowtitle");
-    int id = (int)cJSON_GetNumberValue(id_item);
-    char *name = cJSON_GetStringValue(name_item);
-    char *title = cJSON_GetStringValue(title_item);
-
-    Workspace *w = g_new0(Workspace, 1);
-    w->id = id;
-    w->name = g_strdup(name);
-    w->active_window = g_strdup(title);
-    g_ptr_array_add(array, w);
+  while (image) {
+    GtkWidget *next = gtk_widget_get_next_sibling(image);
+    gtk_box_remove(GTK_BOX(wb->icons), image);
+    image = next;
   }
-
-  cJSON_Delete(root);
-
-  return count;
+  gtk_widget_set_visible(wb->icons, shown > 0);
 }
 
-static void on_button_click(GtkButton *self, gpointer data) {
-  HyprlandState *hs = data;
-
-  gint workspace_id =
-      GPOINTER_TO_INT(g_object_get_data(G_OBJECT(self), "workspace-id"));
-
-  if (hs->active_workspace_id == workspace_id)
-    return;
-
-  char output_buf[8] = {0};
-  char buf[32] = {0};
-  snprintf(buf, sizeof(buf), "dispatch workspace %d", workspace_id);
-  if (hyprland_ipc1(buf, output_buf, sizeof(output_buf))) {
-    g_message("Could not move to workspace");
-    return;
+// Only sets the icons of workspaces whose windows changed, unless all is set
+static void set_changed_icons(WorkspacesWidget *ww, gboolean all) {
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init(&iter, ww->buttons);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    WorkspaceButton *wb = value;
+    HyprlandWorkspace *workspace =
+        hyprland_state_get_workspace(ww->state, GPOINTER_TO_INT(key));
+    if (workspace && (all || workspace->windows_version != wb->windows_version))
+      set_icons(ww, wb, workspace);
   }
 }
 
-static gboolean set_active_workspace(gpointer data) {
-  HyprlandState *hs = data;
-
-  GtkWidget *child = gtk_widget_get_first_child(hs->box);
-  while (child) {
-    gint id =
-        GPOINTER_TO_INT(g_object_get_data(G_OBJECT(child), "workspace-id"));
-    if (hs->active_workspace_id != id)
-      gtk_widget_remove_css_class(child, "active");
-    else
-      gtk_widget_add_css_class(child, "active");
-
-    child = gtk_widget_get_next_sibling(child);
-  }
-
-  return G_SOURCE_REMOVE;
+static WorkspaceButton *workspace_button(WorkspacesWidget *ww,
+                                         HyprlandWorkspace *workspace) {
+  metrics_inc(METRICS_WORKSPACES_BUTTONS_CREATED);
+  WorkspaceButton *wb = g_new0(WorkspaceButton, 1);
+  GtkWidget *button = gtk_button_new();
+  GtkWidget *content = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+  gtk_widget_add_css_class(content, "workspace-content");
+  wb->button = button;
+  wb->label = gtk_label_new(workspace->name->str);
+  wb->icons = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+  gtk_widget_add_css_class(wb->icons, "workspace-icons");
+  gtk_box_append(GTK_BOX(content), wb->label);
+  gtk_box_append(GTK_BOX(content), wb->icons);
+  gtk_button_set_child(GTK_BUTTON(button), content);
+
+  g_object_set_data(G_OBJECT(button), "workspace-id",
+                    GINT_TO_POINTER(workspace->id));
+
+  gtk_widget_set_tooltip_text(button, workspace->last_window_title->str);
+  gtk_widget_set_cursor(button, get_pointer_cursor());
+  gtk_widget_add_css_class(button, "workspace-button");
+
+  g_signal_connect(button, "clicked", G_CALLBACK(on_button_click), ww);
+
+  set_icons(ww, wb, workspace);
+  return wb;
 }
 
-static gboolean update_ui(gpointer data) {
-  HyprlandState *hs = data;
-  g_ptr_array_set_size(hs->workspaces, 0);
-
-  get_hyprland_workspaces(hs->workspaces);
-
-  g_ptr_array_sort_values(hs->workspaces, workspace_compare);
-
-  remove_children(hs->box);
-  guint list_size = hs->workspaces->len;
-
-  for (guint i = 0; i < list_size; i++) {
-    Workspace *workspace = g_ptr_array_index(hs->workspaces, i);
-
-    GtkWidget *button = gtk_button_new_with_label(workspace->name);
-
-    g_object_set_data(G_OBJECT(button), "workspace-id",
-                      GINT_TO_POINTER(workspace->id));
-
-    gtk_widget_set_tooltip_text(button, workspace->active_window);
-    gtk_widget_set_cursor(button, get_pointer_cursor());
-    gtk_widget_add_css_class(button, "workspace-button");
+/*
+ * Makes the buttons match the workspaces in the state.
+ * Only buttons for added, removed, renamed or moved workspaces are touched.
+ */
+static void update_ui(WorkspacesWidget *ww) {
+  metrics_inc(METRICS_WORKSPACES_REBUILDS);
+  GPtrArray *workspaces = ww->workspaces;
+  hyprland_state_get_workspaces(ww->state, ww->monitor, workspaces);
+
+  // Nothing in the box is a workspace button yet, remove the placeholder
+  if (g_hash_table_size(ww->buttons) == 0 && workspaces->len > 0)
+    remove_children(ww->box);
+
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, ww->buttons);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    HyprlandWorkspace *workspace =
+        hyprland_state_get_workspace(ww->state, GPOINTER_TO_INT(key));
+    if (workspace &&
+        (!ww->monitor || g_str_equal(workspace->monitor->str, ww->monitor)))
+      continue;
+    WorkspaceButton *wb = value;
+    if (wb->button == ww->active_button)
+      ww->active_button = NULL;
+    gtk_box_remove(GTK_BOX(ww->box), wb->button);
+    g_hash_table_iter_remove(&iter);
+  }
 
-    g_signal_connect(button, "clicked", G_CALLBACK(on_button_click), hs);
+  GtkWidget *previous = NULL;
+  for (guint i = 0; i < workspaces->len; i++) {
+    HyprlandWorkspace *workspace = g_ptr_array_index(workspaces, i);
+    WorkspaceButton *wb =
+        g_hash_table_lookup(ww->buttons, GINT_TO_POINTER(workspace->id));
+
+    if (!wb) {
+      wb = workspace_button(ww, workspace);
+      g_hash_table_insert(ww->buttons, GINT_TO_POINTER(workspace->id), wb);
+      gtk_box_insert_child_after(GTK_BOX(ww->box), wb->button, previous);
+    } else {
+      if (g_strcmp0(gtk_label_get_text(GTK_LABEL(wb->label)),
+                    workspace->name->str) != 0)
+        gtk_label_set_text(GTK_LABEL(wb->label), workspace->name->str);
+      set_tooltip(wb->button, workspace->last_window_title->str);
+      if (gtk_widget_get_prev_sibling(wb->button) != previous)
+        gtk_box_reorder_child_after(GTK_BOX(ww->box), wb->button, previous);
+    }
 
-    gtk_box_append(GTK_BOX(hs->box), button);
+    previous = wb->button;
   }
 
-  return set_active_workspace(hs);
+  set_active_workspace(ww);
 }
 
-void init_hyprland(HyprlandState *hs) {
-  hs->workspaces = g_ptr_array_new_with_free_func(workspace_free);
+static void apply_changes(gpointer data) {
+  WorkspacesWidget *ww = data;
+  guint changes = ww->pending_changes;
+  gboolean app_icons_changed = ww->app_icons_changed;
+  ww->pending_changes = HYPRLAND_CHANGED_NONE;
+  ww->app_icons_changed = FALSE;
 
-  char buffer[8192] = {0};
+  if (changes & HYPRLAND_CHANGED_WORKSPACES)
+    update_ui(ww);
+  else if (changes & HYPRLAND_CHANGED_TITLE)
+    set_tooltips(ww);
 
-  if (hyprland_ipc1("j/activeworkspace", buffer, sizeof(buffer)) != 0)
-    return;
+  if (changes & HYPRLAND_CHANGED_WINDOWS || app_icons_changed)
+    set_changed_icons(ww, app_icons_changed);
 
-  cJSON *root = cJSON_Parse(buffer);
-  if (!root) {
-    g_message("Invalid json from hyprland ipc");
-    return;
-  }
-
-  cJSON *id_item = cJSON_GetObjectItem(root, "id");
-  hs->active_workspace_id = (int)cJSON_GetNumberValue(id_item);
-  cJSON_Delete(root);
+  if (changes & HYPRLAND_CHANGED_ACTIVE)
+    set_active_workspace(ww);
+}
 
-  g_idle_add(update_ui, hs);
+static void on_hyprland_changed(Hyprland *hyprland, guint changes,
+                                gpointer user_data) {
+  WorkspacesWidget *ww = user_data;
+  ww->pending_changes |= changes;
+  bar_post_update(ww->box, apply_changes, ww);
 }
 
-gpointer listen_to_hyprland_socket(gpointer data) {
-  GtkWidget *box = data;
-  g_autoptr(HyprlandState) hs = g_new0(HyprlandState, 1);
-  hs->box = box;
-  init_hyprland(hs);
-  int sockfd = hyprland_sock();
-  if (sockfd < 0)
-    return NULL;
-
-  char buf[4096];
-  ssize_t len;
-
-  while ((len = recv(sockfd, buf, sizeof(buf) - 1, 0)) > 0) {
-    buf[len] = '\0';
-
-    char *line = strtok(buf, "\n");
-    while (line) {
-      // g_message("Line: %s", line);
-      if (strncmp(line, "createworkspacev2>>", 19) == 0) {
-        g_idle_add(update_ui, hs);
-      } else if (strncmp(line, "destroyworkspacev2>>", 20) == 0) {
-        g_idle_add(update_ui, hs);
-      } else if (strncmp(line, "workspacev2>>", 13) == 0) {
-        char *id_str = strtok(line + 13, ",");
-        int id = atoi(id_str);
-        hs->active_workspace_id = id;
-        g_idle_add(set_active_workspace, hs);
-      }
-
-      line = strtok(NULL, "\n");
-    }
-  }
+static void on_app_icons_ready(AppIcons *app_icons, gpointer user_data) {
+  WorkspacesWidget *ww = user_data;
+  ww->app_icons_changed = TRUE;
+  bar_post_update(ww->box, apply_changes, ww);
+}
 
-  if (len < 0) {
-    perror("recv");
-  }
+static void workspaces_widget_free(gpointer data) {
+  WorkspacesWidget *ww = data;
+  g_signal_handlers_disconnect_by_data(ww->hyprland, ww);
+  g_signal_handlers_disconnect_by_data(ww->app_icons, ww);
+  g_object_unref(ww->hyprland);
+  g_object_unref(ww->app_icons);
+  g_hash_table_unref(ww->buttons);
+  g_ptr_array_unref(ww->workspaces);
+  g_ptr_array_unref(ww->windows);
+  g_free(ww->monitor);
+  g_free(ww);
+}
 
-  return NULL;
+// monitor can be NULL to show the workspaces of every monitor
+void start_workspaces_widget(GtkWidget *box, GdkMonitor *monitor) {
+  WorkspacesWidget *ww = g_new0(WorkspacesWidget, 1);
+  ww->box = box;
+  ww->hyprland = hyprland_get_default();
+  ww->state = hyprland_get_state(ww->hyprland);
+  ww->app_icons = app_icons_get_default();
+  ww->monitor = monitor ? g_strdup(gdk_monitor_get_connector(monitor)) : NULL;
+  ww->buttons =
+      g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  ww->workspaces = g_ptr_array_new();
+  ww->windows = g_ptr_array_new();
+  g_object_set_data_full(G_OBJECT(box), "workspaces-widget", ww,
+                         workspaces_widget_free);
+
+  g_signal_connect(ww->hyprland, "changed", G_CALLBACK(on_hyprland_changed),
+                   ww);
+  g_signal_connect(ww->app_icons, "ready", G_CALLBACK(on_app_icons_ready), ww);
+
+  // The service may already be synced by the bar of another monitor
+  update_ui(ww);
 }
@@ -3,6 +3,6 @@
 
 #include <gtk/gtk.h>
 
-gpointer listen_to_hyprland_socket(gpointer data);
+void start_workspaces_widget(GtkWidget *box, GdkMonitor *monitor);
 
 #endif // !WORKSPACES_H
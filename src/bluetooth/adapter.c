@@ -1,5 +1,6 @@
 #include "adapter.h"
 #include "bt.h"
+#include "metrics.h"
 #include <gio/gio.h>
 #include <glib-object.h>
 #include <glib.h>
@@ -69,6 +70,7 @@ static void on_adapter_properties_changed(Adapter *proxy,
                                           GVariant *changed_properties,
                                           GStrv invalidated_properties,
                                           gpointer user_data) {
+  metrics_inc(METRICS_BLUETOOTH_SIGNALS);
   GVariantIter iter;
   const gchar *key;
   GVariant *value;
@@ -150,6 +152,8 @@ static void on_set_called(GDBusProxy *proxy, GAsyncResult *res,
 }
 void adapter_set_powered(Adapter *self, gboolean powered) {
   GError *error = NULL;
+  // Creating the proxy and Set
+  metrics_add(METRICS_DBUS_CALLS, 2);
 
   // Get the object path of this adapter
   const gchar *object_path = g_dbus_proxy_get_object_path(G_DBUS_PROXY(self));
@@ -222,6 +226,7 @@ static void on_stop_discovery_called(GDBusProxy *proxy, GAsyncResult *res,
 }
 
 void adapter_set_discovering(Adapter *self, gboolean discovering) {
+  metrics_inc(METRICS_DBUS_CALLS);
   if (discovering)
     g_dbus_proxy_call(
         G_DBUS_PROXY(self), // the proxy
@@ -71,6 +71,43 @@ static GDBusObjectManager *bluetooth_get_dbus_om(void) {
 
 GDBusConnection *bluetooth_get_dbus_conn(void) { return dbus_conn; }
 
+typedef struct {
+  BluetoothReadyFunc ready;
+  gpointer user_data;
+} ConnectData;
+
+static void on_dbus_om_ready(GObject *source, GAsyncResult *res,
+                             gpointer user_data) {
+  ConnectData *data = user_data;
+  GError *error = NULL;
+
+  GDBusObjectManager *om =
+      g_dbus_object_manager_client_new_finish(res, &error);
+  if (om) {
+    g_clear_object(&dbus_om);
+    dbus_om = om;
+  }
+  data->ready(error, data->user_data);
+  g_clear_error(&error);
+  g_free(data);
+}
+
+/*
+ * Sets the connection and creates the bluez object manager without
+ * blocking, calls ready when done
+ */
+void bluetooth_connect(GDBusConnection *conn, BluetoothReadyFunc ready,
+                       gpointer user_data) {
+  ConnectData *data = g_new0(ConnectData, 1);
+  data->ready = ready;
+  data->user_data = user_data;
+
+  bluetooth_set_dbus_conn(conn);
+  g_dbus_object_manager_client_new(
+      conn, G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE, "org.bluez", "/",
+      dbus_om_get_type, NULL, NULL, NULL, on_dbus_om_ready, data);
+}
+
 static void bluetooth_dispose(GObject *object) {
   Bluetooth *self = BLUETOOTH_BT(object);
 
@@ -11,8 +11,13 @@
 G_DECLARE_FINAL_TYPE(Bluetooth, bluetooth, BLUETOOTH /*Module*/,
                      BT /*Object name*/, GObject)
 
+// error is NULL on success
+typedef void (*BluetoothReadyFunc)(const GError *error, gpointer user_data);
+
 Bluetooth *bluetooth_get_default(void);
 void bluetooth_set_dbus_conn(GDBusConnection *om);
+void bluetooth_connect(GDBusConnection *conn, BluetoothReadyFunc ready,
+                       gpointer user_data);
 void bluetooth_install_signals(Bluetooth *self);
 void bluetooth_call_signals(Bluetooth *self);
 Adapter *bluetooth_get_adapter(Bluetooth *self);
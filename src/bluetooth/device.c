@@ -1,5 +1,7 @@
 #include "device.h"
 #include "bt.h"
+#include "log.h"
+#include "metrics.h"
 #include <gio/gio.h>
 #include <glib-object.h>
 #include <glib.h>
@@ -80,13 +82,14 @@ static void on_device_properties_changed(Device *proxy,
                                          GVariant *changed_properties,
                                          GStrv invalidated_properties,
                                          gpointer user_data) {
+  metrics_inc(METRICS_BLUETOOTH_SIGNALS);
   GVariantIter iter;
   const gchar *key;
   GVariant *value;
 
   g_variant_iter_init(&iter, changed_properties);
   while (g_variant_iter_next(&iter, "{&sv}", &key, &value)) {
-    g_message("Changed: %s", key);
+    LOG_DEBUG("Bluetooth device changed: %s", key);
     if (g_str_equal(key, "Paired")) {
       gboolean paired = g_variant_get_boolean(value);
       g_signal_emit(BLUETOOTH_DEVICE(proxy), signals[SIGNAL_PAIRED], 0, paired);
@@ -0,0 +1,465 @@
+#include "control.h"
+#include "control_protocol.h"
+#include "hyprland.h"
+#include "quicksettings/quicksettings.h"
+#include "snapshot.h"
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#define READ_CHUNK 4096
+// Subscribers that fall this far behind are dropped
+#define CLIENT_BACKLOG_MAX (1024 * 1024)
+
+/*
+ * Serves cwidgetsctl and scripts on $XDG_RUNTIME_DIR/cwidgets/control.sock,
+ * see control_protocol.h for the frames.
+ *
+ * Everything is non-blocking and runs on the main loop: a request is handled
+ * as soon as its frame is read, so a keybind toggles the quick settings
+ * within the same iteration. State changes are coalesced into one idle
+ * callback that formats the state once and queues the same frame for every
+ * subscriber, which is only woken up again when its socket is writable.
+ */
+typedef struct {
+  GSocket *socket;
+  GSource *source;
+  // Only while out holds data the socket did not take yet
+  GSource *out_source;
+  GByteArray *in;
+  GByteArray *out;
+  gboolean subscribed;
+} ControlClient;
+
+typedef struct {
+  GSocket *listener;
+  GSource *source;
+  gchar *path;
+  GPtrArray *clients; // ControlClient
+  guint broadcast_id;
+} ControlServer;
+
+static ControlServer server = {0};
+
+static void append_json_string(GString *out, const gchar *s) {
+  if (!s) {
+    g_string_append(out, "null");
+    return;
+  }
+  g_string_append_c(out, '"');
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      g_string_append_c(out, '\\');
+    if ((guchar)*s < 0x20)
+      g_string_append_printf(out, "\\u%04x", *s);
+    else
+      g_string_append_c(out, *s);
+  }
+  g_string_append_c(out, '"');
+}
+
+static const gchar *json_bool(gboolean value) {
+  return value ? "true" : "false";
+}
+
+// Everything the bar shows, fields that are not known yet are null
+static gchar *state_json(void) {
+  const Snapshot *s = snapshot_get();
+  GString *out = g_string_new("{\"quick_settings\":{");
+
+  const gchar *page = NULL;
+  GdkMonitor *monitor = get_open_quick_settings(&page);
+  g_string_append_printf(out, "\"open\":%s,\"monitor\":",
+                         json_bool(monitor != NULL));
+  append_json_string(out, monitor ? gdk_monitor_get_connector(monitor) : NULL);
+  g_string_append(out, ",\"page\":");
+  append_json_string(out, page);
+  g_string_append(out, "},\"battery\":");
+
+  if (s->known & SNAPSHOT_BATTERY)
+    g_string_append_printf(out, "{\"percentage\":%d,\"charging\":%s}",
+                           s->battery_percentage,
+                           json_bool(s->battery_charging));
+  else
+    g_string_append(out, "null");
+
+  g_string_append(out, ",\"audio\":");
+  if (s->known & SNAPSHOT_AUDIO)
+    g_string_append_printf(out, "{\"level\":%d,\"muted\":%s}", s->audio_level,
+                           json_bool(s->audio_muted));
+  else
+    g_string_append(out, "null");
+
+  g_string_append(out, ",\"wifi\":");
+  if (s->known & SNAPSHOT_WIFI) {
+    g_string_append(out, "{\"ssid\":");
+    append_json_string(out, s->wifi_ssid[0] ? s->wifi_ssid : NULL);
+    g_string_append_printf(out, ",\"strength\":%u}", s->wifi_strength);
+  } else {
+    g_string_append(out, "null");
+  }
+
+  g_string_append(out, ",\"bluetooth\":");
+  if (s->known & SNAPSHOT_BLUETOOTH)
+    g_string_append_printf(out, "{\"connected\":%s}",
+                           json_bool(s->bluetooth_connected));
+  else
+    g_string_append(out, "null");
+
+  g_string_append(out, ",\"workspaces\":");
+  if (s->known & SNAPSHOT_WORKSPACES) {
+    g_string_append_printf(out, "{\"active\":%d,\"list\":[",
+                           s->active_workspace_id);
+    for (guint i = 0; i < s->n_workspaces; i++) {
+      const SnapshotWorkspace *w = &s->workspaces[i];
+      g_string_append_printf(out, "%s{\"id\":%d,\"name\":", i ? "," : "",
+                             w->id);
+      append_json_string(out, w->name);
+      g_string_append(out, ",\"monitor\":");
+      append_json_string(out, w->monitor);
+      g_string_append_printf(out, ",\"active\":%s}", json_bool(w->active));
+    }
+    g_string_append(out, "]}");
+  } else {
+    g_string_append(out, "null");
+  }
+
+  g_string_append_c(out, '}');
+  return g_string_free(out, FALSE);
+}
+
+/*
+ * The monitor with the given connector. Without one, the monitor hyprland
+ * has focused, or the first one.
+ */
+static GdkMonitor *find_monitor(const gchar *connector, GError **error) {
+  GListModel *monitors = gdk_display_get_monitors(gdk_display_get_default());
+  guint n_monitors = g_list_model_get_n_items(monitors);
+  gboolean explicit = connector && *connector;
+
+  if (!explicit) {
+    HyprlandState *hs = hyprland_get_state(hyprland_get_default());
+    connector = hs->focused_monitor && hs->focused_monitor->len
+                    ? hs->focused_monitor->str
+                    : NULL;
+  }
+
+  for (guint i = 0; i < n_monitors; i++) {
+    // Still held by the list model after the unref
+    g_autoptr(GdkMonitor) m = g_list_model_get_item(monitors, i);
+    if (!connector || g_strcmp0(gdk_monitor_get_connector(m), connector) == 0)
+      return m;
+  }
+
+  if (!explicit && n_monitors > 0) {
+    g_autoptr(GdkMonitor) m = g_list_model_get_item(monitors, 0);
+    return m;
+  }
+  g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No monitor %s",
+              connector ? connector : "connected");
+  return NULL;
+}
+
+static void client_free(gpointer data) {
+  ControlClient *client = data;
+  if (client->source) {
+    g_source_destroy(client->source);
+    g_source_unref(client->source);
+  }
+  if (client->out_source) {
+    g_source_destroy(client->out_source);
+    g_source_unref(client->out_source);
+  }
+  g_socket_close(client->socket, NULL);
+  g_object_unref(client->socket);
+  g_byte_array_unref(client->in);
+  g_byte_array_unref(client->out);
+  g_free(client);
+}
+
+static gboolean on_client_writable(GSocket *socket, GIOCondition condition,
+                                   gpointer user_data);
+
+// Returns FALSE if the client has to be dropped
+static gboolean client_flush(ControlClient *client) {
+  while (client->out->len > 0) {
+    GError *error = NULL;
+    gssize sent = g_socket_send(client->socket, (gchar *)client->out->data,
+                                client->out->len, NULL, &error);
+    if (sent > 0) {
+      g_byte_array_remove_range(client->out, 0, sent);
+      continue;
+    }
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      g_error_free(error);
+      break;
+    }
+    g_clear_error(&error);
+    return FALSE;
+  }
+
+  if (client->out->len > CLIENT_BACKLOG_MAX) {
+    g_message("Control: dropping a client that does not read");
+    return FALSE;
+  }
+
+  if (client->out->len > 0 && !client->out_source) {
+    client->out_source = g_socket_create_source(client->socket, G_IO_OUT, NULL);
+    g_source_set_name(client->out_source, "control-client-out");
+    g_source_set_callback(client->out_source,
+                          G_SOURCE_FUNC(on_client_writable), client, NULL);
+    g_source_attach(client->out_source, NULL);
+  } else if (client->out->len == 0 && client->out_source) {
+    g_source_destroy(client->out_source);
+    g_clear_pointer(&client->out_source, g_source_unref);
+  }
+  return TRUE;
+}
+
+static void client_drop(ControlClient *client) {
+  g_ptr_array_remove(server.clients, client);
+}
+
+static gboolean on_client_writable(GSocket *socket, GIOCondition condition,
+                                   gpointer user_data) {
+  ControlClient *client = user_data;
+  // Destroys this source once everything is sent
+  if (!client_flush(client))
+    client_drop(client);
+  return G_SOURCE_CONTINUE;
+}
+
+static void reply(ControlClient *client, guint8 type, const gchar *payload) {
+  control_frame_append(client->out, type,
+                       (const gchar *const[]){payload, NULL});
+}
+
+static void handle_request(ControlClient *client, guint8 type, GStrv args) {
+  GError *error = NULL;
+  guint n_args = g_strv_length(args);
+  GdkMonitor *monitor;
+
+  switch (type) {
+  case CONTROL_TOGGLE:
+    monitor = find_monitor(n_args > 0 ? args[0] : NULL, &error);
+    if (monitor)
+      toggle_quick_settings(monitor);
+    break;
+  case CONTROL_SHOW_PAGE:
+    if (n_args < 1) {
+      g_set_error_literal(&error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                          "No page given");
+      break;
+    }
+    monitor = find_monitor(n_args > 1 ? args[1] : NULL, &error);
+    if (monitor && !show_quick_settings_page(monitor, args[0]))
+      g_set_error(&error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                  "No page %s, or it is not loaded yet", args[0]);
+    break;
+  case CONTROL_HIDE:
+    hide_quick_settings();
+    break;
+  case CONTROL_SUBSCRIBE:
+    client->subscribed = TRUE;
+    // Fall through
+  case CONTROL_GET_STATE: {
+    g_autofree gchar *state = state_json();
+    reply(client, CONTROL_OK, state);
+    return;
+  }
+  default:
+    g_set_error(&error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                "Unknown request %u", type);
+    break;
+  }
+
+  if (error) {
+    reply(client, CONTROL_ERROR, error->message);
+    g_error_free(error);
+  } else {
+    reply(client, CONTROL_OK, NULL);
+  }
+}
+
+// Returns FALSE if the client sent garbage
+static gboolean client_process(ControlClient *client) {
+  gsize consumed = 0;
+  while (consumed < client->in->len) {
+    guint8 type;
+    g_auto(GStrv) args = NULL;
+    gssize n = control_frame_parse(client->in->data + consumed,
+                                   client->in->len - consumed, &type, &args);
+    if (n < 0)
+      return FALSE;
+    if (n == 0)
+      break;
+    consumed += n;
+    handle_request(client, type, args);
+  }
+  g_byte_array_remove_range(client->in, 0, consumed);
+  return TRUE;
+}
+
+static gboolean on_client_readable(GSocket *socket, GIOCondition condition,
+                                   gpointer user_data) {
+  ControlClient *client = user_data;
+  gboolean closed = FALSE;
+
+  while (TRUE) {
+    GError *error = NULL;
+    guint old_len = client->in->len;
+    g_byte_array_set_size(client->in, old_len + READ_CHUNK);
+    gssize len = g_socket_receive(socket, (gchar *)client->in->data + old_len,
+                                  READ_CHUNK, NULL, &error);
+    g_byte_array_set_size(client->in, old_len + MAX(len, 0));
+
+    if (len > 0)
+      continue;
+    if (len < 0 && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      g_error_free(error);
+      break;
+    }
+    g_clear_error(&error);
+    closed = TRUE;
+    break;
+  }
+
+  if (!client_process(client) || !client_flush(client) || closed) {
+    // Destroys this source too
+    client_drop(client);
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_listener_readable(GSocket *listener, GIOCondition condition,
+                                     gpointer user_data) {
+  while (TRUE) {
+    GError *error = NULL;
+    GSocket *socket = g_socket_accept(listener, NULL, &error);
+    if (!socket) {
+      if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+        g_warning("Control: could not accept: %s", error->message);
+      g_error_free(error);
+      return G_SOURCE_CONTINUE;
+    }
+
+    g_socket_set_blocking(socket, FALSE);
+    ControlClient *client = g_new0(ControlClient, 1);
+    client->socket = socket;
+    client->in = g_byte_array_new();
+    client->out = g_byte_array_new();
+    client->source =
+        g_socket_create_source(socket, G_IO_IN | G_IO_HUP | G_IO_ERR, NULL);
+    g_source_set_name(client->source, "control-client");
+    g_source_set_callback(client->source, G_SOURCE_FUNC(on_client_readable),
+                          client, NULL);
+    g_source_attach(client->source, NULL);
+    g_ptr_array_add(server.clients, client);
+  }
+}
+
+static gboolean on_broadcast(gpointer user_data) {
+  server.broadcast_id = 0;
+  g_autoptr(GByteArray) frame = NULL;
+
+  // Backwards, dropping a client removes it
+  for (guint i = server.clients->len; i-- > 0;) {
+    ControlClient *client = g_ptr_array_index(server.clients, i);
+    if (!client->subscribed)
+      continue;
+    if (!frame) {
+      g_autofree gchar *state = state_json();
+      frame = g_byte_array_new();
+      control_frame_append(frame, CONTROL_EVENT,
+                           (const gchar *const[]){state, NULL});
+    }
+    g_byte_array_append(client->out, frame->data, frame->len);
+    if (!client_flush(client))
+      client_drop(client);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static void queue_broadcast(void) {
+  if (server.broadcast_id || !server.listener)
+    return;
+  // Ahead of the redraw, subscribers hear of it with the frame
+  server.broadcast_id =
+      g_idle_add_full(G_PRIORITY_DEFAULT, on_broadcast, NULL, NULL);
+  g_source_set_name_by_id(server.broadcast_id, "control-broadcast");
+}
+
+static void on_snapshot_changed(guint32 fields, gpointer user_data) {
+  queue_broadcast();
+}
+
+static void on_quick_settings_changed(gpointer user_data) {
+  queue_broadcast();
+}
+
+// TRUE if another instance answers on path
+static gboolean socket_in_use(GSocketAddress *address) {
+  g_autoptr(GSocket) socket = g_socket_new(
+      G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT,
+      NULL);
+  return socket && g_socket_connect(socket, address, NULL, NULL);
+}
+
+// Starts listening, call it once the windows exist
+void control_init(void) {
+  GError *error = NULL;
+  server.path = control_socket_path();
+  g_autofree gchar *dir = g_path_get_dirname(server.path);
+  g_mkdir_with_parents(dir, 0700);
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new(server.path);
+
+  if (socket_in_use(address)) {
+    g_warning("Control: %s is served by another instance", server.path);
+    g_clear_pointer(&server.path, g_free);
+    return;
+  }
+  // Left over by a crash
+  g_unlink(server.path);
+
+  server.listener =
+      g_socket_new(G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM,
+                   G_SOCKET_PROTOCOL_DEFAULT, &error);
+  if (!server.listener || !g_socket_bind(server.listener, address, FALSE,
+                                         &error) ||
+      !g_socket_listen(server.listener, &error)) {
+    g_warning("Control: could not listen on %s: %s", server.path,
+              error->message);
+    g_error_free(error);
+    g_clear_object(&server.listener);
+    g_clear_pointer(&server.path, g_free);
+    return;
+  }
+  g_socket_set_blocking(server.listener, FALSE);
+
+  server.clients = g_ptr_array_new_with_free_func(client_free);
+  server.source = g_socket_create_source(server.listener, G_IO_IN, NULL);
+  g_source_set_name(server.source, "control-listener");
+  g_source_set_callback(server.source, G_SOURCE_FUNC(on_listener_readable),
+                        NULL, NULL);
+  g_source_attach(server.source, NULL);
+
+  snapshot_connect_changed(on_snapshot_changed, NULL);
+  connect_quick_settings_changed(on_quick_settings_changed, NULL);
+}
+
+// Closes every connection and removes the socket
+void control_stop(void) {
+  if (!server.listener)
+    return;
+  g_clear_handle_id(&server.broadcast_id, g_source_remove);
+  g_clear_pointer(&server.clients, g_ptr_array_unref);
+  g_source_destroy(server.source);
+  g_clear_pointer(&server.source, g_source_unref);
+  g_socket_close(server.listener, NULL);
+  g_clear_object(&server.listener);
+  g_unlink(server.path);
+  g_clear_pointer(&server.path, g_free);
+}
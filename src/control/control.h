@@ -0,0 +1,7 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+void control_init(void);
+void control_stop(void);
+
+#endif // !CONTROL_H
@@ -0,0 +1,66 @@
+#include "control_protocol.h"
+#include <glib.h>
+#include <string.h>
+
+#define HEADER_SIZE 4
+
+// Caller should free
+gchar *control_socket_path(void) {
+  return g_build_filename(g_get_user_runtime_dir(), "cwidgets", "control.sock",
+                          NULL);
+}
+
+// Served by cwidgets-backend, caller should free
+gchar *control_backend_socket_path(void) {
+  return g_build_filename(g_get_user_runtime_dir(), "cwidgets", "backend.sock",
+                          NULL);
+}
+
+// args may be NULL
+void control_frame_append(GByteArray *out, guint8 type,
+                          const gchar *const *args) {
+  guint start = out->len;
+  guint8 header[HEADER_SIZE] = {0};
+  g_byte_array_append(out, header, HEADER_SIZE);
+  g_byte_array_append(out, &type, 1);
+  for (guint i = 0; args && args[i]; i++)
+    g_byte_array_append(out, (const guint8 *)args[i], strlen(args[i]) + 1);
+
+  guint32 length = GUINT32_TO_LE(out->len - start - HEADER_SIZE);
+  memcpy(out->data + start, &length, HEADER_SIZE);
+}
+
+/*
+ * Parses the frame at the start of data.
+ *
+ * Returns the bytes it took up, 0 if it is not complete yet and -1 if it is
+ * not a frame. args is set to a new NULL terminated array.
+ */
+gssize control_frame_parse(const guint8 *data, gsize length, guint8 *type,
+                           GStrv *args) {
+  if (length < HEADER_SIZE)
+    return 0;
+
+  guint32 body_length;
+  memcpy(&body_length, data, HEADER_SIZE);
+  body_length = GUINT32_FROM_LE(body_length);
+  if (body_length == 0 || body_length > CONTROL_FRAME_MAX)
+    return -1;
+  if (length < HEADER_SIZE + body_length)
+    return 0;
+
+  const gchar *body = (const gchar *)data + HEADER_SIZE;
+  // The arguments have to end in a NUL, if there are any
+  if (body_length > 1 && body[body_length - 1] != '\0')
+    return -1;
+
+  GPtrArray *array = g_ptr_array_new();
+  for (const gchar *arg = body + 1; arg < body + body_length;
+       arg += strlen(arg) + 1)
+    g_ptr_array_add(array, g_strdup(arg));
+  g_ptr_array_add(array, NULL);
+
+  *type = body[0];
+  *args = (GStrv)g_ptr_array_free(array, FALSE);
+  return HEADER_SIZE + body_length;
+}
@@ -0,0 +1,40 @@
+#ifndef CONTROL_PROTOCOL_H
+#define CONTROL_PROTOCOL_H
+
+#include <glib.h>
+
+// Bigger frames are refused
+#define CONTROL_FRAME_MAX (64 * 1024)
+
+/*
+ * A frame is the length of its body as 32 bit little endian, then the body:
+ * the type as one byte followed by its arguments, each NUL terminated.
+ */
+typedef enum {
+  // Requests, answered with CONTROL_OK or CONTROL_ERROR
+  CONTROL_TOGGLE = 1,    // [monitor]
+  CONTROL_SHOW_PAGE = 2, // page, [monitor]
+  CONTROL_HIDE = 3,
+  CONTROL_GET_STATE = 4, // Answered with the state as JSON
+  // Answered with the state, then a CONTROL_EVENT on every change
+  CONTROL_SUBSCRIBE = 5,
+
+  CONTROL_OK = 0x80,    // [state]
+  CONTROL_ERROR = 0x81, // message
+  CONTROL_EVENT = 0x82, // state
+  /*
+   * Sent by cwidgets-backend on connecting and on every change, with the
+   * changed SnapshotField in decimal. The state itself is in shared memory,
+   * see state_export.h.
+   */
+  CONTROL_STATE_CHANGED = 0x83, // fields
+} ControlType;
+
+gchar *control_socket_path(void);
+gchar *control_backend_socket_path(void);
+void control_frame_append(GByteArray *out, guint8 type,
+                          const gchar *const *args);
+gssize control_frame_parse(const guint8 *data, gsize length, guint8 *type,
+                           GStrv *args);
+
+#endif // !CONTROL_PROTOCOL_H
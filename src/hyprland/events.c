@@ -0,0 +1,177 @@
+#include "events.h"
+#include "metrics.h"
+#include "socket.h"
+#include "trace.h"
+#include <gio/gio.h>
+#include <glib.h>
+#include <string.h>
+
+#define READ_CHUNK 4096
+#define RECONNECT_SECONDS 2
+
+struct _HyprlandEvents {
+  GSocket *socket;
+  GSource *source;
+  // Holds bytes that did not end with a newline yet
+  GByteArray *buffer;
+  guint reconnect_id;
+  HyprlandEventFunc on_event;
+  HyprlandNotifyFunc on_flush;
+  HyprlandNotifyFunc on_connect;
+  gpointer user_data;
+};
+
+static void hyprland_events_connect(HyprlandEvents *self);
+
+// Returns the number of lines handled
+static guint hyprland_events_process(HyprlandEvents *self) {
+  gchar *data = (gchar *)self->buffer->data;
+  gsize len = self->buffer->len;
+  gsize consumed = 0;
+  guint lines = 0;
+
+  while (consumed < len) {
+    gchar *line = data + consumed;
+    gchar *end = memchr(line, '\n', len - consumed);
+    if (!end)
+      break; // Rest of the line comes in a later read
+
+    *end = '\0';
+    consumed = end - data + 1;
+    if (line == end)
+      continue;
+
+    gchar *sep = strstr(line, ">>");
+    if (!sep)
+      continue;
+    *sep = '\0';
+
+    self->on_event(line, sep + 2, self->user_data);
+    lines++;
+  }
+
+  g_byte_array_remove_range(self->buffer, 0, consumed);
+  return lines;
+}
+
+static gboolean on_reconnect(gpointer data) {
+  HyprlandEvents *self = data;
+  self->reconnect_id = 0;
+  hyprland_events_connect(self);
+  return G_SOURCE_REMOVE;
+}
+
+static void hyprland_events_disconnect(HyprlandEvents *self) {
+  if (self->source) {
+    g_source_destroy(self->source);
+    g_clear_pointer(&self->source, g_source_unref);
+  }
+  if (self->socket) {
+    g_socket_close(self->socket, NULL);
+    g_clear_object(&self->socket);
+  }
+  g_byte_array_set_size(self->buffer, 0);
+}
+
+static gboolean on_socket_readable(GSocket *socket, GIOCondition condition,
+                                   gpointer user_data) {
+  TRACE_SPAN("hyprland: read events");
+  HyprlandEvents *self = user_data;
+  gboolean closed = FALSE;
+
+  // Read everything that is available, so a burst costs one wakeup
+  while (TRUE) {
+    GError *error = NULL;
+    guint old_len = self->buffer->len;
+    g_byte_array_set_size(self->buffer, old_len + READ_CHUNK);
+    gssize len = g_socket_receive(socket, (gchar *)self->buffer->data + old_len,
+                                  READ_CHUNK, NULL, &error);
+    g_byte_array_set_size(self->buffer, old_len + MAX(len, 0));
+
+    if (len > 0) {
+      metrics_add(METRICS_HYPRLAND_EVENT_BYTES, len);
+      continue;
+    }
+
+    if (len < 0 && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      g_error_free(error);
+      break;
+    }
+
+    if (error) {
+      g_warning("Could not read from hyprland event socket: %s",
+                error->message);
+      g_error_free(error);
+    }
+    closed = TRUE;
+    break;
+  }
+
+  if (hyprland_events_process(self) > 0 && self->on_flush)
+    self->on_flush(self->user_data);
+
+  if (closed) {
+    g_warning("Hyprland event socket closed, reconnecting");
+    // The source is removed by returning G_SOURCE_REMOVE
+    g_clear_pointer(&self->source, g_source_unref);
+    hyprland_events_disconnect(self);
+    self->reconnect_id =
+        g_timeout_add_seconds(RECONNECT_SECONDS, on_reconnect, self);
+    return G_SOURCE_REMOVE;
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void hyprland_events_connect(HyprlandEvents *self) {
+  GError *error = NULL;
+  self->socket = hyprland_socket_connect(HYPRLAND_EVENT_SOCKET, &error);
+  if (!self->socket) {
+    g_warning("%s", error->message);
+    g_error_free(error);
+    self->reconnect_id =
+        g_timeout_add_seconds(RECONNECT_SECONDS, on_reconnect, self);
+    return;
+  }
+
+  self->source = g_socket_create_source(self->socket,
+                                        G_IO_IN | G_IO_HUP | G_IO_ERR, NULL);
+  g_source_set_name(self->source, "hyprland-events");
+  g_source_set_callback(self->source, G_SOURCE_FUNC(on_socket_readable), self,
+                        NULL);
+  g_source_attach(self->source, NULL);
+
+  // Events may have been missed while disconnected
+  if (self->on_connect)
+    self->on_connect(self->user_data);
+}
+
+/*
+ * Listens to the hyprland event socket on the default main context
+ *
+ * on_event is called for each line, and on_flush after each batch of lines.
+ * on_connect is called once connected, also when reconnecting.
+ */
+HyprlandEvents *hyprland_events_new(HyprlandEventFunc on_event,
+                                    HyprlandNotifyFunc on_flush,
+                                    HyprlandNotifyFunc on_connect,
+                                    gpointer user_data) {
+  HyprlandEvents *self = g_new0(HyprlandEvents, 1);
+  self->buffer = g_byte_array_sized_new(READ_CHUNK);
+  self->on_event = on_event;
+  self->on_flush = on_flush;
+  self->on_connect = on_connect;
+  self->user_data = user_data;
+
+  hyprland_events_connect(self);
+  return self;
+}
+
+void hyprland_events_free(HyprlandEvents *self) {
+  if (!self)
+    return;
+  g_clear_handle_id(&self->reconnect_id, g_source_remove);
+  hyprland_events_disconnect(self);
+  g_byte_array_unref(self->buffer);
+  g_free(self);
+}
@@ -0,0 +1,22 @@
+#ifndef HYPRLAND_EVENTS_H
+#define HYPRLAND_EVENTS_H
+
+#include <glib.h>
+
+typedef struct _HyprlandEvents HyprlandEvents;
+
+// Called for every complete line, with the line split at ">>".
+// The strings are only valid during the call, but data may be modified.
+typedef void (*HyprlandEventFunc)(const gchar *event, gchar *data,
+                                  gpointer user_data);
+// Used for on_flush, called once after all lines from one read have been
+// handled, and on_connect, called every time the socket is (re)connected
+typedef void (*HyprlandNotifyFunc)(gpointer user_data);
+
+HyprlandEvents *hyprland_events_new(HyprlandEventFunc on_event,
+                                    HyprlandNotifyFunc on_flush,
+                                    HyprlandNotifyFunc on_connect,
+                                    gpointer user_data);
+void hyprland_events_free(HyprlandEvents *self);
+
+#endif // !HYPRLAND_EVENTS_H
@@ -0,0 +1,260 @@
+#include "hyprland.h"
+#include "events.h"
+#include "ipc.h"
+#include "metrics.h"
+#include "state.h"
+#include "trace.h"
+#include <gio/gio.h>
+#include <glib-object.h>
+#include <glib.h>
+#include <string.h>
+
+#define SYNC_RETRY_SECONDS 1
+#define SYNC_RETRY_MAX_SECONDS 32
+
+enum {
+  SIGNAL_CHANGED,
+  N_SIGNALS,
+};
+
+/*
+ * Owns the connection to hyprland and the model of its state.
+ * There is one for the whole process, every bar listens to "changed".
+ */
+struct _Hyprland {
+  GObject parent_instance;
+  HyprlandState *state;
+  HyprlandEvents *events;
+  GCancellable *sync_cancellable;
+  // Events read while a sync is in flight, as event>>data. The reply may be
+  // older than them, so they are applied again on top of it
+  GPtrArray *sync_events;
+  // Changes held back until the sync lands, the state already has them
+  HyprlandChange sync_changes;
+  guint sync_retry_id;
+  guint sync_retry_seconds;
+  // Of the j/activewindow request asking for a fullscreen mode
+  GCancellable *fullscreen_cancellable;
+  // Collected from events and emitted once per read from the event socket
+  HyprlandChange changes;
+};
+
+static guint signals[N_SIGNALS] = {0};
+
+G_DEFINE_TYPE(Hyprland, hyprland, G_TYPE_OBJECT)
+
+static void hyprland_dispose(GObject *object) {
+  Hyprland *self = HYPRLAND_SERVICE(object);
+
+  g_clear_pointer(&self->events, hyprland_events_free);
+  if (self->sync_cancellable) {
+    g_cancellable_cancel(self->sync_cancellable);
+    g_clear_object(&self->sync_cancellable);
+  }
+  g_clear_handle_id(&self->sync_retry_id, g_source_remove);
+  g_clear_pointer(&self->sync_events, g_ptr_array_unref);
+  if (self->fullscreen_cancellable) {
+    g_cancellable_cancel(self->fullscreen_cancellable);
+    g_clear_object(&self->fullscreen_cancellable);
+  }
+  g_clear_pointer(&self->state, hyprland_state_free);
+
+  G_OBJECT_CLASS(hyprland_parent_class)->dispose(object);
+}
+
+static void hyprland_class_init(HyprlandClass *klass) {
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  object_class->dispose = hyprland_dispose;
+
+  // Emitted with the HyprlandChange flags of what changed
+  signals[SIGNAL_CHANGED] =
+      g_signal_new("changed", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0,
+                   NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_UINT);
+}
+
+static void hyprland_query_fullscreen(Hyprland *self);
+static void hyprland_sync(gpointer user_data);
+
+static gboolean on_sync_retry(gpointer user_data) {
+  Hyprland *self = HYPRLAND_SERVICE(user_data);
+  self->sync_retry_id = 0;
+  hyprland_sync(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Emits what the events changed meanwhile and tries again later
+static void hyprland_sync_failed(Hyprland *self) {
+  HyprlandChange changes = self->sync_changes;
+  self->sync_changes = HYPRLAND_CHANGED_NONE;
+  g_ptr_array_set_size(self->sync_events, 0);
+
+  guint seconds = self->sync_retry_seconds;
+  self->sync_retry_seconds = MIN(seconds * 2, SYNC_RETRY_MAX_SECONDS);
+  g_message("Syncing hyprland again in %u s", seconds);
+  self->sync_retry_id = g_timeout_add_seconds(seconds, on_sync_retry, self);
+  g_source_set_name_by_id(self->sync_retry_id, "hyprland-sync-retry");
+
+  if (changes & HYPRLAND_CHANGED_FULLSCREEN_MODE) {
+    changes &= ~HYPRLAND_CHANGED_FULLSCREEN_MODE;
+    hyprland_query_fullscreen(self);
+  }
+  if (changes != HYPRLAND_CHANGED_NONE)
+    g_signal_emit(self, signals[SIGNAL_CHANGED], 0, changes);
+}
+
+/*
+ * Applies the events read since the batch was sent on top of the synced
+ * state. They set absolute values, so one the reply already has is applied
+ * again without harm, and a mismatch only means the reply already has it,
+ * which is why RESYNC is dropped here.
+ */
+static HyprlandChange hyprland_replay_sync_events(Hyprland *self) {
+  HyprlandChange changes = HYPRLAND_CHANGED_NONE;
+
+  for (guint i = 0; i < self->sync_events->len; i++) {
+    gchar *line = g_ptr_array_index(self->sync_events, i);
+    gchar *sep = strstr(line, ">>");
+    *sep = '\0';
+    changes |= hyprland_state_apply_event(self->state, line, sep + 2);
+  }
+  g_ptr_array_set_size(self->sync_events, 0);
+  return changes & ~HYPRLAND_CHANGED_RESYNC;
+}
+
+static void on_sync_reply(gchar **replies, guint n_replies, GError *error,
+                          gpointer user_data) {
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return; // A newer sync replaced this one, or the service is gone
+
+  Hyprland *self = HYPRLAND_SERVICE(user_data);
+  g_clear_object(&self->sync_cancellable);
+
+  if (error) {
+    g_warning("Could not get hyprland state: %s", error->message);
+    hyprland_sync_failed(self);
+    return;
+  }
+
+  if (!hyprland_state_sync(self->state, replies)) {
+    hyprland_sync_failed(self);
+    return;
+  }
+  self->sync_retry_seconds = SYNC_RETRY_SECONDS;
+
+  HyprlandChange changes = hyprland_replay_sync_events(self);
+  self->sync_changes = HYPRLAND_CHANGED_NONE;
+  if (changes & HYPRLAND_CHANGED_FULLSCREEN_MODE)
+    hyprland_query_fullscreen(self);
+
+  g_signal_emit(self, signals[SIGNAL_CHANGED], 0,
+                HYPRLAND_CHANGED_WORKSPACES | HYPRLAND_CHANGED_ACTIVE |
+                    HYPRLAND_CHANGED_TITLE | HYPRLAND_CHANGED_WINDOWS |
+                    HYPRLAND_CHANGED_ACTIVE_WINDOW |
+                    HYPRLAND_CHANGED_FULLSCREEN);
+}
+
+// Fetches the full state, only needed on connect or if the events and the
+// state do not match
+static void hyprland_sync(gpointer user_data) {
+  Hyprland *self = HYPRLAND_SERVICE(user_data);
+
+  g_clear_handle_id(&self->sync_retry_id, g_source_remove);
+  if (self->sync_cancellable) {
+    g_cancellable_cancel(self->sync_cancellable);
+    g_object_unref(self->sync_cancellable);
+  }
+  self->sync_cancellable = g_cancellable_new();
+  // The new batch is sent after them, its reply has them
+  g_ptr_array_set_size(self->sync_events, 0);
+
+  hyprland_ipc_batch(hyprland_state_sync_requests, self->sync_cancellable,
+                     on_sync_reply, self);
+}
+
+static void on_fullscreen_reply(gchar **replies, guint n_replies,
+                                GError *error, gpointer user_data) {
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  Hyprland *self = HYPRLAND_SERVICE(user_data);
+  g_clear_object(&self->fullscreen_cancellable);
+
+  if (error) {
+    g_warning("Could not get the hyprland active window: %s", error->message);
+    return;
+  }
+
+  HyprlandChange changes =
+      hyprland_state_update_active_window(self->state, replies[0]);
+  if (changes != HYPRLAND_CHANGED_NONE)
+    g_signal_emit(self, signals[SIGNAL_CHANGED], 0, changes);
+}
+
+// The fullscreen event does not tell maximized and fullscreen apart
+static void hyprland_query_fullscreen(Hyprland *self) {
+  if (self->fullscreen_cancellable) {
+    g_cancellable_cancel(self->fullscreen_cancellable);
+    g_object_unref(self->fullscreen_cancellable);
+  }
+  self->fullscreen_cancellable = g_cancellable_new();
+
+  hyprland_ipc_request("j/activewindow", self->fullscreen_cancellable,
+                       on_fullscreen_reply, self);
+}
+
+static void on_hyprland_event(const gchar *event, gchar *data,
+                              gpointer user_data) {
+  // By event name, e.g. workspacev2
+  TRACE_SPAN(g_intern_string(event));
+  Hyprland *self = HYPRLAND_SERVICE(user_data);
+  metrics_inc(METRICS_HYPRLAND_EVENTS);
+  // Applying the event parses data in place, so it is copied first
+  if (self->sync_cancellable)
+    g_ptr_array_add(self->sync_events, g_strconcat(event, ">>", data, NULL));
+  self->changes |= hyprland_state_apply_event(self->state, event, data);
+}
+
+static void on_hyprland_flush(gpointer user_data) {
+  TRACE_SPAN("hyprland: changed");
+  Hyprland *self = HYPRLAND_SERVICE(user_data);
+  HyprlandChange changes = self->changes;
+  self->changes = HYPRLAND_CHANGED_NONE;
+
+  if (changes & HYPRLAND_CHANGED_RESYNC) {
+    // Emitted along with everything else once the sync lands, or if it fails
+    self->sync_changes |= changes & ~HYPRLAND_CHANGED_RESYNC;
+    hyprland_sync(self);
+    return;
+  }
+  if (changes & HYPRLAND_CHANGED_FULLSCREEN_MODE) {
+    changes &= ~HYPRLAND_CHANGED_FULLSCREEN_MODE;
+    hyprland_query_fullscreen(self);
+  }
+
+  if (changes != HYPRLAND_CHANGED_NONE)
+    g_signal_emit(self, signals[SIGNAL_CHANGED], 0, changes);
+}
+
+static void hyprland_init(Hyprland *self) {
+  self->state = hyprland_state_new();
+  self->sync_events = g_ptr_array_new_with_free_func(g_free);
+  self->sync_retry_seconds = SYNC_RETRY_SECONDS;
+  self->events = hyprland_events_new(on_hyprland_event, on_hyprland_flush,
+                                     hyprland_sync, self);
+}
+
+static Hyprland *hyprland = NULL;
+
+// Client should unref
+Hyprland *hyprland_get_default(void) {
+  if (NULL != hyprland) {
+    return g_object_ref(hyprland);
+  }
+
+  hyprland = (Hyprland *)g_object_new(HYPRLAND_TYPE, NULL);
+
+  return g_object_ref(hyprland);
+}
+
+// Owned by the service
+HyprlandState *hyprland_get_state(Hyprland *self) { return self->state; }
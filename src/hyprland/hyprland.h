@@ -0,0 +1,19 @@
+#ifndef HYPRLAND_H
+#define HYPRLAND_H
+
+#include "state.h"
+#include <glib-object.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define HYPRLAND_TYPE hyprland_get_type()
+G_DECLARE_FINAL_TYPE(Hyprland, hyprland, HYPRLAND /*Module*/,
+                     SERVICE /*Object name*/, GObject)
+
+Hyprland *hyprland_get_default(void);
+HyprlandState *hyprland_get_state(Hyprland *self);
+
+G_END_DECLS
+
+#endif // !HYPRLAND_H
@@ -0,0 +1,249 @@
+#include "ipc.h"
+#include "metrics.h"
+#include "socket.h"
+#include <gio/gio.h>
+#include <glib.h>
+#include <string.h>
+
+#define READ_CHUNK 8192
+#define BATCH_PREFIX "[[BATCH]]"
+#define BATCH_DELIMITER "\n\n\n"
+// Response buffers kept around for the next requests
+#define MAX_POOLED_BUFFERS 4
+
+/*
+ * Hyprland answers one request per connection on .socket.sock and then closes
+ * it, so every request gets its own non-blocking socket.
+ * Several commands can share one connection with the [[BATCH]] syntax,
+ * where the replies are separated by BATCH_DELIMITER.
+ */
+typedef struct {
+  GSocket *socket;
+  GSource *source;
+  GCancellable *cancellable;
+  GString *message;
+  gsize written;
+  // Grows until hyprland closes the connection
+  GByteArray *response;
+  guint n_requests;
+  GError *error;
+  HyprlandIpcFunc callback;
+  gpointer user_data;
+} IpcRequest;
+
+static GPtrArray *buffer_pool = NULL;
+
+// Buffers keep their capacity, so steady state requests do not reallocate
+static GByteArray *buffer_take(void) {
+  if (buffer_pool && buffer_pool->len > 0)
+    return g_ptr_array_steal_index_fast(buffer_pool, buffer_pool->len - 1);
+  return g_byte_array_sized_new(READ_CHUNK);
+}
+
+static void buffer_release(GByteArray *buffer) {
+  if (!buffer_pool)
+    buffer_pool = g_ptr_array_new_full(
+        MAX_POOLED_BUFFERS, (GDestroyNotify)g_byte_array_unref);
+
+  if (buffer_pool->len >= MAX_POOLED_BUFFERS) {
+    g_byte_array_unref(buffer);
+    return;
+  }
+  g_byte_array_set_size(buffer, 0);
+  g_ptr_array_add(buffer_pool, buffer);
+}
+
+static void ipc_request_free(IpcRequest *req) {
+  if (req->source) {
+    g_source_destroy(req->source);
+    g_source_unref(req->source);
+  }
+  if (req->socket) {
+    g_socket_close(req->socket, NULL);
+    g_object_unref(req->socket);
+  }
+  g_clear_object(&req->cancellable);
+  g_clear_error(&req->error);
+  g_string_free(req->message, TRUE);
+  buffer_release(req->response);
+  g_free(req);
+}
+
+static void ipc_request_fail(IpcRequest *req, GError *error) {
+  if (req->callback)
+    req->callback(NULL, 0, error, req->user_data);
+  else if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    g_warning("Hyprland request '%s' failed: %s", req->message->str,
+              error->message);
+
+  g_error_free(error);
+  ipc_request_free(req);
+}
+
+// Splits the response in place and hands the replies to the callback
+static void ipc_request_complete(IpcRequest *req) {
+  metrics_add(METRICS_HYPRLAND_IPC_BYTES, req->response->len);
+  g_byte_array_append(req->response, (const guint8 *)"", 1);
+
+  gchar **replies = g_newa(gchar *, req->n_requests);
+  gchar *reply = (gchar *)req->response->data;
+  guint n_replies = 0;
+
+  while (n_replies < req->n_requests) {
+    replies[n_replies++] = reply;
+    if (n_replies == req->n_requests)
+      break;
+
+    gchar *end = strstr(reply, BATCH_DELIMITER);
+    if (!end)
+      break;
+    *end = '\0';
+    reply = end + strlen(BATCH_DELIMITER);
+  }
+
+  if (n_replies < req->n_requests) {
+    ipc_request_fail(req, g_error_new(G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                      "Expected %u replies from hyprland, "
+                                      "got %u",
+                                      req->n_requests, n_replies));
+    return;
+  }
+
+  if (req->callback)
+    req->callback(replies, n_replies, NULL, req->user_data);
+  ipc_request_free(req);
+}
+
+static void ipc_request_watch(IpcRequest *req, GIOCondition condition,
+                              GSocketSourceFunc func) {
+  if (req->source) {
+    g_source_destroy(req->source);
+    g_source_unref(req->source);
+  }
+  req->source =
+      g_socket_create_source(req->socket, condition, req->cancellable);
+  g_source_set_name(req->source, "hyprland-ipc");
+  g_source_set_callback(req->source, G_SOURCE_FUNC(func), req, NULL);
+  g_source_attach(req->source, NULL);
+}
+
+static gboolean on_readable(GSocket *socket, GIOCondition condition,
+                            gpointer user_data) {
+  IpcRequest *req = user_data;
+  GError *error = NULL;
+
+  if (g_cancellable_set_error_if_cancelled(req->cancellable, &error)) {
+    ipc_request_fail(req, error);
+    return G_SOURCE_REMOVE;
+  }
+
+  while (TRUE) {
+    guint old_len = req->response->len;
+    g_byte_array_set_size(req->response, old_len + READ_CHUNK);
+    gssize len = g_socket_receive(socket, (gchar *)req->response->data + old_len,
+                                  READ_CHUNK, NULL, &error);
+    g_byte_array_set_size(req->response, old_len + MAX(len, 0));
+
+    if (len > 0)
+      continue;
+
+    if (len == 0) { // Hyprland closes the connection after the reply
+      ipc_request_complete(req);
+      return G_SOURCE_REMOVE;
+    }
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      g_error_free(error);
+      return G_SOURCE_CONTINUE;
+    }
+
+    ipc_request_fail(req, error);
+    return G_SOURCE_REMOVE;
+  }
+}
+
+static gboolean on_writable(GSocket *socket, GIOCondition condition,
+                            gpointer user_data) {
+  IpcRequest *req = user_data;
+  GError *error = NULL;
+
+  if (g_cancellable_set_error_if_cancelled(req->cancellable, &error)) {
+    ipc_request_fail(req, error);
+    return G_SOURCE_REMOVE;
+  }
+
+  while (req->written < req->message->len) {
+    gssize len = g_socket_send(socket, req->message->str + req->written,
+                               req->message->len - req->written, NULL, &error);
+    if (len < 0) {
+      if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+        g_error_free(error);
+        return G_SOURCE_CONTINUE;
+      }
+      ipc_request_fail(req, error);
+      return G_SOURCE_REMOVE;
+    }
+    req->written += len;
+  }
+
+  ipc_request_watch(req, G_IO_IN | G_IO_HUP | G_IO_ERR, on_readable);
+  return G_SOURCE_REMOVE;
+}
+
+// Reports a failed connect from the main loop, so callbacks are never called
+// before the request function has returned
+static gboolean on_connect_failed(gpointer user_data) {
+  IpcRequest *req = user_data;
+  g_clear_pointer(&req->source, g_source_unref);
+  ipc_request_fail(req, g_steal_pointer(&req->error));
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Sends the requests to hyprland in one round trip without blocking.
+ * requests is NULL terminated, and a single request is sent without the
+ * batch prefix.
+ *
+ * callback can be NULL if the reply is not needed
+ */
+void hyprland_ipc_batch(const gchar *const *requests, GCancellable *cancellable,
+                        HyprlandIpcFunc callback, gpointer user_data) {
+  guint n_requests = g_strv_length((gchar **)requests);
+  g_return_if_fail(n_requests > 0);
+  metrics_add(METRICS_HYPRLAND_IPC_REQUESTS, n_requests);
+
+  IpcRequest *req = g_new0(IpcRequest, 1);
+  req->n_requests = n_requests;
+  req->callback = callback;
+  req->user_data = user_data;
+  req->response = buffer_take();
+  if (cancellable)
+    req->cancellable = g_object_ref(cancellable);
+
+  if (n_requests == 1) {
+    req->message = g_string_new(requests[0]);
+  } else {
+    req->message = g_string_new(BATCH_PREFIX);
+    for (guint i = 0; i < n_requests; i++) {
+      if (i > 0)
+        g_string_append_c(req->message, ';');
+      g_string_append(req->message, requests[i]);
+    }
+  }
+
+  req->socket = hyprland_socket_connect(HYPRLAND_REQUEST_SOCKET, &req->error);
+  if (!req->socket) {
+    req->source = g_idle_source_new();
+    g_source_set_callback(req->source, on_connect_failed, req, NULL);
+    g_source_attach(req->source, NULL);
+    return;
+  }
+
+  ipc_request_watch(req, G_IO_OUT | G_IO_HUP | G_IO_ERR, on_writable);
+}
+
+void hyprland_ipc_request(const gchar *request, GCancellable *cancellable,
+                          HyprlandIpcFunc callback, gpointer user_data) {
+  const gchar *requests[] = {request, NULL};
+  hyprland_ipc_batch(requests, cancellable, callback, user_data);
+}
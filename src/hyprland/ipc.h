@@ -0,0 +1,18 @@
+#ifndef HYPRLAND_IPC_H
+#define HYPRLAND_IPC_H
+
+#include <gio/gio.h>
+#include <glib.h>
+
+// On success replies has one entry per request, in the same order.
+// The replies are only valid during the call, but may be modified in place.
+// On failure replies is NULL and error is set.
+typedef void (*HyprlandIpcFunc)(gchar **replies, guint n_replies,
+                                GError *error, gpointer user_data);
+
+void hyprland_ipc_request(const gchar *request, GCancellable *cancellable,
+                          HyprlandIpcFunc callback, gpointer user_data);
+void hyprland_ipc_batch(const gchar *const *requests, GCancellable *cancellable,
+                        HyprlandIpcFunc callback, gpointer user_data);
+
+#endif // !HYPRLAND_IPC_H
@@ -0,0 +1,265 @@
+#include "json.h"
+#include <glib.h>
+#include <string.h>
+
+static void skip_whitespace(JsonCursor *c) {
+  while (*c->pos == ' ' || *c->pos == '\n' || *c->pos == '\r' ||
+         *c->pos == '\t')
+    c->pos++;
+}
+
+static gboolean expect(JsonCursor *c, gchar ch) {
+  if (c->failed)
+    return FALSE;
+  skip_whitespace(c);
+  if (*c->pos != ch) {
+    c->failed = TRUE;
+    return FALSE;
+  }
+  c->pos++;
+  return TRUE;
+}
+
+void json_cursor_init(JsonCursor *c, gchar *data) {
+  c->pos = data;
+  c->failed = data == NULL;
+}
+
+gboolean json_cursor_failed(JsonCursor *c) { return c->failed; }
+
+gboolean json_cursor_enter_array(JsonCursor *c) { return expect(c, '['); }
+
+gboolean json_cursor_enter_object(JsonCursor *c) { return expect(c, '{'); }
+
+/*
+ * Moves to the next element of the array that was entered.
+ * Returns FALSE and leaves the array when there are no more elements.
+ *
+ * The caller has to read or skip every element.
+ */
+gboolean json_cursor_next_element(JsonCursor *c) {
+  if (c->failed)
+    return FALSE;
+
+  skip_whitespace(c);
+  if (*c->pos == ']') {
+    c->pos++;
+    return FALSE;
+  }
+  if (*c->pos == ',') {
+    c->pos++;
+    skip_whitespace(c);
+  }
+  if (*c->pos == '\0') {
+    c->failed = TRUE;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/*
+ * Moves to the next member of the object that was entered and returns its
+ * key. Returns NULL and leaves the object when there are no more members.
+ *
+ * The caller has to read or skip every value.
+ */
+const gchar *json_cursor_next_key(JsonCursor *c) {
+  if (c->failed)
+    return NULL;
+
+  skip_whitespace(c);
+  if (*c->pos == '}') {
+    c->pos++;
+    return NULL;
+  }
+  if (*c->pos == ',')
+    c->pos++;
+
+  skip_whitespace(c);
+  if (*c->pos != '"') {
+    c->failed = TRUE;
+    return NULL;
+  }
+
+  const gchar *key = json_cursor_read_string(c);
+  if (!key || !expect(c, ':'))
+    return NULL;
+  return key;
+}
+
+static gint read_hex4(const gchar *s) {
+  gint value = 0;
+  for (int i = 0; i < 4; i++) {
+    gint digit = g_ascii_xdigit_value(s[i]);
+    if (digit < 0)
+      return -1;
+    value = value * 16 + digit;
+  }
+  return value;
+}
+
+/*
+ * Unescapes the string in place and returns a pointer into the parsed buffer.
+ * The decoded string is never longer than the escaped one, so it always fits.
+ *
+ * Returns NULL if the value is not a string
+ */
+const gchar *json_cursor_read_string(JsonCursor *c) {
+  if (c->failed)
+    return NULL;
+
+  skip_whitespace(c);
+  if (*c->pos != '"') {
+    json_cursor_skip_value(c);
+    return NULL;
+  }
+
+  gchar *start = c->pos + 1;
+  gchar *src = start;
+  gchar *dst = start;
+
+  while (*src != '"') {
+    if (*src == '\0') {
+      c->failed = TRUE;
+      return NULL;
+    }
+    if (*src != '\\') {
+      *dst++ = *src++;
+      continue;
+    }
+
+    src++;
+    switch (*src++) {
+    case '"':
+      *dst++ = '"';
+      break;
+    case '\\':
+      *dst++ = '\\';
+      break;
+    case '/':
+      *dst++ = '/';
+      break;
+    case 'b':
+      *dst++ = '\b';
+      break;
+    case 'f':
+      *dst++ = '\f';
+      break;
+    case 'n':
+      *dst++ = '\n';
+      break;
+    case 'r':
+      *dst++ = '\r';
+      break;
+    case 't':
+      *dst++ = '\t';
+      break;
+    case 'u': {
+      gint ch = read_hex4(src);
+      if (ch < 0) {
+        c->failed = TRUE;
+        return NULL;
+      }
+      src += 4;
+
+      if (ch >= 0xD800 && ch <= 0xDBFF && src[0] == '\\' && src[1] == 'u') {
+        gint low = read_hex4(src + 2);
+        if (low >= 0xDC00 && low <= 0xDFFF) {
+          ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+          src += 6;
+        }
+      }
+      if (ch >= 0xD800 && ch <= 0xDFFF)
+        ch = 0xFFFD; // Lone surrogate
+
+      dst += g_unichar_to_utf8(ch, dst);
+      break;
+    }
+    default:
+      c->failed = TRUE;
+      return NULL;
+    }
+  }
+
+  c->pos = src + 1;
+  *dst = '\0';
+  return start;
+}
+
+static void skip_string(JsonCursor *c) {
+  gchar *p = c->pos + 1;
+  while (*p != '"') {
+    if (*p == '\0') {
+      c->failed = TRUE;
+      return;
+    }
+    if (*p == '\\' && p[1] != '\0')
+      p++;
+    p++;
+  }
+  c->pos = p + 1;
+}
+
+// Skips numbers and the true, false and null literals
+static void skip_literal(JsonCursor *c) {
+  gchar *start = c->pos;
+  while (*c->pos != '\0' && !strchr(",]} \t\r\n", *c->pos))
+    c->pos++;
+  if (c->pos == start)
+    c->failed = TRUE;
+}
+
+void json_cursor_skip_value(JsonCursor *c) {
+  if (c->failed)
+    return;
+
+  skip_whitespace(c);
+  switch (*c->pos) {
+  case '"':
+    skip_string(c);
+    break;
+  case '{':
+    c->pos++;
+    while (json_cursor_next_key(c))
+      json_cursor_skip_value(c);
+    break;
+  case '[':
+    c->pos++;
+    while (json_cursor_next_element(c))
+      json_cursor_skip_value(c);
+    break;
+  default:
+    skip_literal(c);
+    break;
+  }
+}
+
+// Returns 0 if the value is not a number, fractions are cut off
+gint64 json_cursor_read_int(JsonCursor *c) {
+  if (c->failed)
+    return 0;
+
+  skip_whitespace(c);
+  gchar *end = NULL;
+  gint64 value = g_ascii_strtoll(c->pos, &end, 10);
+  if (end == c->pos) {
+    json_cursor_skip_value(c);
+    return 0;
+  }
+
+  c->pos = end;
+  if (*c->pos == '.' || *c->pos == 'e' || *c->pos == 'E')
+    skip_literal(c);
+  return value;
+}
+
+// Returns FALSE if the value is not a boolean
+gboolean json_cursor_read_bool(JsonCursor *c) {
+  if (c->failed)
+    return FALSE;
+
+  skip_whitespace(c);
+  gboolean value = strncmp(c->pos, "true", 4) == 0;
+  json_cursor_skip_value(c);
+  return value;
+}
@@ -0,0 +1,45 @@
+#ifndef HYPRLAND_JSON_H
+#define HYPRLAND_JSON_H
+
+#include <glib.h>
+
+/*
+ * Pull parser that reads json in place, without building a tree.
+ * Strings are unescaped inside the parsed buffer and returned as pointers
+ * into it, so reading a reply does not allocate.
+ *
+ * Usage for an array of objects:
+ *
+ *   json_cursor_enter_array(&c);
+ *   while (json_cursor_next_element(&c)) {
+ *     json_cursor_enter_object(&c);
+ *     const gchar *key;
+ *     while ((key = json_cursor_next_key(&c))) {
+ *       if (g_str_equal(key, "id"))
+ *         id = json_cursor_read_int(&c);
+ *       else
+ *         json_cursor_skip_value(&c);
+ *     }
+ *   }
+ *
+ * Errors are sticky, check json_cursor_failed once at the end.
+ */
+typedef struct {
+  gchar *pos;
+  gboolean failed;
+} JsonCursor;
+
+void json_cursor_init(JsonCursor *c, gchar *data);
+gboolean json_cursor_failed(JsonCursor *c);
+
+gboolean json_cursor_enter_array(JsonCursor *c);
+gboolean json_cursor_next_element(JsonCursor *c);
+gboolean json_cursor_enter_object(JsonCursor *c);
+const gchar *json_cursor_next_key(JsonCursor *c);
+
+const gchar *json_cursor_read_string(JsonCursor *c);
+gint64 json_cursor_read_int(JsonCursor *c);
+gboolean json_cursor_read_bool(JsonCursor *c);
+void json_cursor_skip_value(JsonCursor *c);
+
+#endif // !HYPRLAND_JSON_H
@@ -0,0 +1,65 @@
+#include "socket.h"
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Path to one of the sockets of the running hyprland instance
+ *
+ * Returns NULL if hyprland is not running, caller should free
+ */
+gchar *hyprland_socket_path(const gchar *name) {
+  const char *xdg_runtime_dir = g_getenv("XDG_RUNTIME_DIR");
+  const char *hyprland_instance = g_getenv("HYPRLAND_INSTANCE_SIGNATURE");
+
+  if (!xdg_runtime_dir || !hyprland_instance)
+    return NULL;
+
+  return g_strdup_printf("%s/hypr/%s/%s", xdg_runtime_dir, hyprland_instance,
+                         name);
+}
+
+/*
+ * Connects to one of the hyprland sockets and wraps it in a GSocket
+ *
+ * Ownership is given to caller
+ */
+GSocket *hyprland_socket_connect(const gchar *name, GError **error) {
+  g_autofree gchar *socket_path = hyprland_socket_path(name);
+  if (!socket_path) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                        "Hyprland environment variables not set");
+    return NULL;
+  }
+
+  int sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sockfd < 0) {
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                "Could not create hyprland socket: %s", g_strerror(errno));
+    return NULL;
+  }
+
+  struct sockaddr_un sockaddr = {0};
+  sockaddr.sun_family = AF_UNIX;
+  strncpy(sockaddr.sun_path, socket_path, sizeof(sockaddr.sun_path) - 1);
+
+  if (connect(sockfd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) < 0) {
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                "Could not connect to %s: %s", socket_path, g_strerror(errno));
+    close(sockfd);
+    return NULL;
+  }
+
+  GSocket *socket = g_socket_new_from_fd(sockfd, error);
+  if (!socket) {
+    close(sockfd);
+    return NULL;
+  }
+
+  g_socket_set_blocking(socket, FALSE);
+  return socket;
+}
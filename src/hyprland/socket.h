@@ -0,0 +1,13 @@
+#ifndef HYPRLAND_SOCKET_H
+#define HYPRLAND_SOCKET_H
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#define HYPRLAND_EVENT_SOCKET ".socket2.sock"
+#define HYPRLAND_REQUEST_SOCKET ".socket.sock"
+
+gchar *hyprland_socket_path(const gchar *name);
+GSocket *hyprland_socket_connect(const gchar *name, GError **error);
+
+#endif // !HYPRLAND_SOCKET_H
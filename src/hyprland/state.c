@@ -0,0 +1,753 @@
+#include "state.h"
+#include "json.h"
+#include <glib.h>
+#include <string.h>
+
+const gchar *const hyprland_state_sync_requests[] = {
+    "j/monitors", "j/workspaces", "j/activeworkspace",
+    "j/clients",  "j/activewindow", NULL};
+
+static HyprlandWorkspace *workspace_new(gint id) {
+  HyprlandWorkspace *w = g_new0(HyprlandWorkspace, 1);
+  w->id = id;
+  w->name = g_string_new(NULL);
+  w->monitor = g_string_new(NULL);
+  w->last_window_title = g_string_new(NULL);
+  return w;
+}
+
+static void workspace_free(gpointer data) {
+  HyprlandWorkspace *w = data;
+  g_string_free(w->name, TRUE);
+  g_string_free(w->monitor, TRUE);
+  g_string_free(w->last_window_title, TRUE);
+  g_free(w);
+}
+
+static void monitor_free(gpointer data) {
+  HyprlandMonitor *m = data;
+  g_string_free(m->name, TRUE);
+  g_free(m);
+}
+
+static HyprlandWindow *window_new(HyprlandState *hs, guint64 address) {
+  HyprlandWindow *w = g_new0(HyprlandWindow, 1);
+  w->address = address;
+  w->class = g_string_new(NULL);
+  w->title = g_string_new(NULL);
+  w->serial = hs->next_window_serial++;
+  g_hash_table_insert(hs->windows, &w->address, w);
+  return w;
+}
+
+static void window_free(gpointer data) {
+  HyprlandWindow *w = data;
+  g_string_free(w->class, TRUE);
+  g_string_free(w->title, TRUE);
+  g_free(w);
+}
+
+// Assigns only if different, returns TRUE if the string changed
+static gboolean string_update(GString *string, const gchar *value) {
+  if (g_str_equal(string->str, value))
+    return FALSE;
+  g_string_assign(string, value);
+  return TRUE;
+}
+
+static gint workspace_compare(gconstpointer a_p, gconstpointer b_p) {
+  const HyprlandWorkspace *a = a_p;
+  const HyprlandWorkspace *b = b_p;
+  if (a->id < b->id)
+    return -1;
+  else if (a->id > b->id)
+    return 1;
+  else
+    return 0;
+}
+
+HyprlandState *hyprland_state_new(void) {
+  HyprlandState *hs = g_new0(HyprlandState, 1);
+  hs->workspaces =
+      g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, workspace_free);
+  hs->monitors =
+      g_hash_table_new_full(g_str_hash, g_str_equal, NULL, monitor_free);
+  hs->windows =
+      g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, window_free);
+  hs->focused_monitor = g_string_new(NULL);
+  return hs;
+}
+
+void hyprland_state_free(HyprlandState *hs) {
+  if (!hs)
+    return;
+  g_hash_table_unref(hs->workspaces);
+  g_hash_table_unref(hs->monitors);
+  g_hash_table_unref(hs->windows);
+  g_string_free(hs->focused_monitor, TRUE);
+  g_free(hs);
+}
+
+HyprlandWorkspace *hyprland_state_get_workspace(HyprlandState *hs, gint id) {
+  return g_hash_table_lookup(hs->workspaces, GINT_TO_POINTER(id));
+}
+
+static HyprlandWorkspace *find_workspace_by_name(HyprlandState *hs,
+                                                 const gchar *name) {
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init(&iter, hs->workspaces);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    HyprlandWorkspace *w = value;
+    if (g_str_equal(w->name->str, name))
+      return w;
+  }
+  return NULL;
+}
+
+HyprlandMonitor *hyprland_state_get_monitor(HyprlandState *hs,
+                                            const gchar *name) {
+  if (!name)
+    return NULL;
+  return g_hash_table_lookup(hs->monitors, name);
+}
+
+/*
+ * Fills out with the workspaces on the monitor sorted by id, or all of them
+ * if monitor is NULL. out is cleared first so callers can keep reusing it.
+ *
+ * The workspaces are owned by the state
+ */
+void hyprland_state_get_workspaces(HyprlandState *hs, const gchar *monitor,
+                                   GPtrArray *out) {
+  GHashTableIter iter;
+  gpointer value;
+
+  g_ptr_array_set_size(out, 0);
+  g_hash_table_iter_init(&iter, hs->workspaces);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    HyprlandWorkspace *w = value;
+    if (!monitor || g_str_equal(w->monitor->str, monitor))
+      g_ptr_array_add(out, w);
+  }
+
+  g_ptr_array_sort_values(out, workspace_compare);
+}
+
+/*
+ * TRUE if a window on the workspace shown on the monitor covers it.
+ * Maximized windows leave the bars visible and do not count.
+ */
+gboolean hyprland_state_monitor_is_fullscreen(HyprlandState *hs,
+                                              const gchar *monitor) {
+  HyprlandMonitor *m = hyprland_state_get_monitor(hs, monitor);
+  if (!m)
+    return FALSE;
+
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, hs->windows);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    HyprlandWindow *w = value;
+    if (w->workspace_id == m->active_workspace_id &&
+        w->fullscreen & HYPRLAND_FULLSCREEN_FULL)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+// NULL if no window has focus
+HyprlandWindow *hyprland_state_get_active_window(HyprlandState *hs) {
+  return g_hash_table_lookup(hs->windows, &hs->active_window_address);
+}
+
+static gint window_compare(gconstpointer a_p, gconstpointer b_p) {
+  const HyprlandWindow *a = a_p;
+  const HyprlandWindow *b = b_p;
+  if (a->serial < b->serial)
+    return -1;
+  else if (a->serial > b->serial)
+    return 1;
+  else
+    return 0;
+}
+
+/*
+ * Fills out with the windows on the workspace in the order they were opened.
+ * out is cleared first so callers can keep reusing it.
+ *
+ * The windows are owned by the state
+ */
+void hyprland_state_get_windows(HyprlandState *hs, gint workspace_id,
+                                GPtrArray *out) {
+  GHashTableIter iter;
+  gpointer value;
+
+  g_ptr_array_set_size(out, 0);
+  g_hash_table_iter_init(&iter, hs->windows);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    HyprlandWindow *w = value;
+    if (w->workspace_id == workspace_id)
+      g_ptr_array_add(out, w);
+  }
+
+  g_ptr_array_sort_values(out, window_compare);
+}
+
+// Gives the workspace a new windows_version, if it is known
+static void windows_changed(HyprlandState *hs, gint workspace_id) {
+  HyprlandWorkspace *w = hyprland_state_get_workspace(hs, workspace_id);
+  if (w)
+    w->windows_version = ++hs->windows_version;
+}
+
+// Marks the workspaces it leaves and joins, or its own for a new class
+static void window_place(HyprlandState *hs, HyprlandWindow *w,
+                         gint workspace_id, const gchar *class) {
+  gboolean moved = w->workspace_id != workspace_id;
+  if (moved)
+    windows_changed(hs, w->workspace_id);
+  w->workspace_id = workspace_id;
+  if (string_update(w->class, class) || moved)
+    windows_changed(hs, workspace_id);
+}
+
+static HyprlandWindow *window_open(HyprlandState *hs, guint64 address,
+                                   gint workspace_id) {
+  HyprlandWindow *w = window_new(hs, address);
+  w->workspace_id = workspace_id;
+  windows_changed(hs, workspace_id);
+  return w;
+}
+
+static gboolean is_stale_window(gpointer key, gpointer value,
+                                gpointer user_data) {
+  HyprlandWindow *w = value;
+  HyprlandState *hs = user_data;
+  if (w->generation == hs->generation)
+    return FALSE;
+  windows_changed(hs, w->workspace_id);
+  return TRUE;
+}
+
+static gboolean is_stale_workspace(gpointer key, gpointer value,
+                                   gpointer user_data) {
+  HyprlandWorkspace *w = value;
+  HyprlandState *hs = user_data;
+  return w->generation != hs->generation;
+}
+
+static gboolean is_stale_monitor(gpointer key, gpointer value,
+                                 gpointer user_data) {
+  HyprlandMonitor *m = value;
+  HyprlandState *hs = user_data;
+  return m->generation != hs->generation;
+}
+
+// Reads the id of {"id": 1, "name": "1"}
+static gint read_workspace_ref(JsonCursor *c) {
+  gint id = 0;
+  const gchar *key;
+
+  json_cursor_enter_object(c);
+  while ((key = json_cursor_next_key(c))) {
+    if (g_str_equal(key, "id"))
+      id = (gint)json_cursor_read_int(c);
+    else
+      json_cursor_skip_value(c);
+  }
+  return id;
+}
+
+static const gchar *read_string_or(JsonCursor *c, const gchar *fallback) {
+  const gchar *value = json_cursor_read_string(c);
+  return value ? value : fallback;
+}
+
+static gboolean sync_monitors(HyprlandState *hs, gchar *json) {
+  JsonCursor c;
+  json_cursor_init(&c, json);
+  g_string_truncate(hs->focused_monitor, 0);
+
+  json_cursor_enter_array(&c);
+  while (json_cursor_next_element(&c)) {
+    const gchar *name = NULL;
+    gint active_id = 0;
+    gboolean focused = FALSE;
+    const gchar *key;
+
+    json_cursor_enter_object(&c);
+    while ((key = json_cursor_next_key(&c))) {
+      if (g_str_equal(key, "name"))
+        name = json_cursor_read_string(&c);
+      else if (g_str_equal(key, "activeWorkspace"))
+        active_id = read_workspace_ref(&c);
+      else if (g_str_equal(key, "focused"))
+        focused = json_cursor_read_bool(&c);
+      else
+        json_cursor_skip_value(&c);
+    }
+    if (!name)
+      continue;
+
+    HyprlandMonitor *m = g_hash_table_lookup(hs->monitors, name);
+    if (!m) {
+      m = g_new0(HyprlandMonitor, 1);
+      m->name = g_string_new(name);
+      g_hash_table_insert(hs->monitors, m->name->str, m);
+    }
+    m->active_workspace_id = active_id;
+    m->generation = hs->generation;
+
+    if (focused)
+      g_string_assign(hs->focused_monitor, name);
+  }
+
+  if (json_cursor_failed(&c))
+    return FALSE;
+  g_hash_table_foreach_remove(hs->monitors, is_stale_monitor, hs);
+  return TRUE;
+}
+
+static gboolean sync_workspaces(HyprlandState *hs, gchar *json) {
+  JsonCursor c;
+  json_cursor_init(&c, json);
+
+  json_cursor_enter_array(&c);
+  while (json_cursor_next_element(&c)) {
+    gint id = 0;
+    const gchar *name = "";
+    const gchar *monitor = "";
+    const gchar *title = "";
+    const gchar *key;
+
+    json_cursor_enter_object(&c);
+    while ((key = json_cursor_next_key(&c))) {
+      if (g_str_equal(key, "id"))
+        id = (gint)json_cursor_read_int(&c);
+      else if (g_str_equal(key, "name"))
+        name = read_string_or(&c, name);
+      else if (g_str_equal(key, "monitor"))
+        monitor = read_string_or(&c, monitor);
+      else if (g_str_equal(key, "lastwindowtitle"))
+        title = read_string_or(&c, title);
+      else
+        json_cursor_skip_value(&c);
+    }
+
+    HyprlandWorkspace *w = hyprland_state_get_workspace(hs, id);
+    if (!w) {
+      w = workspace_new(id);
+      g_hash_table_insert(hs->workspaces, GINT_TO_POINTER(id), w);
+    }
+    string_update(w->name, name);
+    string_update(w->monitor, monitor);
+    string_update(w->last_window_title, title);
+    w->generation = hs->generation;
+  }
+
+  if (json_cursor_failed(&c))
+    return FALSE;
+  g_hash_table_foreach_remove(hs->workspaces, is_stale_workspace, hs);
+  return TRUE;
+}
+
+static gboolean sync_active_workspace(HyprlandState *hs, gchar *json) {
+  JsonCursor c;
+  json_cursor_init(&c, json);
+
+  hs->active_workspace_id = read_workspace_ref(&c);
+  return !json_cursor_failed(&c);
+}
+
+// Addresses are hex, with 0x in j/clients and without it in events
+static guint64 parse_address(const gchar *address) {
+  return g_ascii_strtoull(address, NULL, 16);
+}
+
+static gboolean sync_clients(HyprlandState *hs, gchar *json) {
+  JsonCursor c;
+  json_cursor_init(&c, json);
+
+  json_cursor_enter_array(&c);
+  while (json_cursor_next_element(&c)) {
+    const gchar *address = NULL;
+    const gchar *class = "";
+    const gchar *title = "";
+    gint workspace_id = 0;
+    gint fullscreen = HYPRLAND_FULLSCREEN_NONE;
+    gboolean mapped = TRUE;
+    const gchar *key;
+
+    json_cursor_enter_object(&c);
+    while ((key = json_cursor_next_key(&c))) {
+      if (g_str_equal(key, "address"))
+        address = json_cursor_read_string(&c);
+      else if (g_str_equal(key, "class"))
+        class = read_string_or(&c, class);
+      else if (g_str_equal(key, "title"))
+        title = read_string_or(&c, title);
+      else if (g_str_equal(key, "workspace"))
+        workspace_id = read_workspace_ref(&c);
+      else if (g_str_equal(key, "mapped"))
+        mapped = json_cursor_read_bool(&c);
+      else if (g_str_equal(key, "fullscreen"))
+        fullscreen = (gint)json_cursor_read_int(&c);
+      else
+        json_cursor_skip_value(&c);
+    }
+    if (!address || !mapped)
+      continue;
+
+    guint64 key_address = parse_address(address);
+    HyprlandWindow *w = g_hash_table_lookup(hs->windows, &key_address);
+    if (!w)
+      w = window_open(hs, key_address, workspace_id);
+    window_place(hs, w, workspace_id, class);
+    string_update(w->title, title);
+    w->fullscreen = fullscreen;
+    w->generation = hs->generation;
+  }
+
+  if (json_cursor_failed(&c))
+    return FALSE;
+  g_hash_table_foreach_remove(hs->windows, is_stale_window, hs);
+  return TRUE;
+}
+
+/*
+ * Reads the address and fullscreen mode of the focused window, and updates
+ * the mode of its record if there is one.
+ * Hyprland answers {} if no window has focus, which leaves address at 0.
+ * Returns FALSE if the reply could not be parsed
+ */
+static gboolean read_active_window(HyprlandState *hs, gchar *json,
+                                   guint64 *address, gboolean *changed) {
+  JsonCursor c;
+  const gchar *key;
+  gint fullscreen = HYPRLAND_FULLSCREEN_NONE;
+  json_cursor_init(&c, json);
+
+  *address = 0;
+  *changed = FALSE;
+  json_cursor_enter_object(&c);
+  while ((key = json_cursor_next_key(&c))) {
+    if (g_str_equal(key, "address"))
+      *address = parse_address(read_string_or(&c, ""));
+    else if (g_str_equal(key, "fullscreen"))
+      fullscreen = (gint)json_cursor_read_int(&c);
+    else
+      json_cursor_skip_value(&c);
+  }
+  if (json_cursor_failed(&c))
+    return FALSE;
+
+  HyprlandWindow *w = g_hash_table_lookup(hs->windows, address);
+  if (w && w->fullscreen != (HyprlandFullscreen)fullscreen) {
+    *changed = TRUE;
+    w->fullscreen = fullscreen;
+  }
+  return TRUE;
+}
+
+static gboolean sync_active_window(HyprlandState *hs, gchar *json) {
+  gboolean changed;
+  return read_active_window(hs, json, &hs->active_window_address, &changed);
+}
+
+/*
+ * Updates the fullscreen mode of the focused window from the reply to
+ * j/activewindow, asked for on HYPRLAND_CHANGED_FULLSCREEN_MODE.
+ * The reply is parsed in place and modified.
+ */
+HyprlandChange hyprland_state_update_active_window(HyprlandState *hs,
+                                                   gchar *reply) {
+  guint64 address;
+  gboolean changed;
+  if (!read_active_window(hs, reply, &address, &changed)) {
+    g_message("Invalid json from hyprland ipc");
+    return HYPRLAND_CHANGED_NONE;
+  }
+  return changed ? HYPRLAND_CHANGED_FULLSCREEN : HYPRLAND_CHANGED_NONE;
+}
+
+/*
+ * Replaces the state with the replies to hyprland_state_sync_requests.
+ * Records that are still there are updated in place, the rest are removed.
+ *
+ * The replies are parsed in place and modified.
+ * Returns FALSE if any of the replies could not be parsed
+ */
+gboolean hyprland_state_sync(HyprlandState *hs, gchar **replies) {
+  hs->generation++;
+  if (!sync_monitors(hs, replies[0]) || !sync_workspaces(hs, replies[1]) ||
+      !sync_active_workspace(hs, replies[2]) ||
+      !sync_clients(hs, replies[3]) ||
+      !sync_active_window(hs, replies[4])) {
+    g_message("Invalid json from hyprland ipc");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/*
+ * Adds a workspace remembered from an earlier run, so there is something to
+ * show before the first sync. It is kept at the current generation, which the
+ * first sync moves past, so it is updated or removed like any other record.
+ *
+ * active is whether it is shown on its monitor, focused whether that monitor
+ * has focus
+ */
+void hyprland_state_restore_workspace(HyprlandState *hs, gint id,
+                                      const gchar *name, const gchar *monitor,
+                                      gboolean active, gboolean focused) {
+  HyprlandWorkspace *w = hyprland_state_get_workspace(hs, id);
+  if (!w) {
+    w = workspace_new(id);
+    g_hash_table_insert(hs->workspaces, GINT_TO_POINTER(id), w);
+  }
+  string_update(w->name, name);
+  string_update(w->monitor, monitor);
+  w->generation = hs->generation;
+
+  HyprlandMonitor *m = hyprland_state_get_monitor(hs, monitor);
+  if (!m && monitor[0] != '\0') {
+    m = g_new0(HyprlandMonitor, 1);
+    m->name = g_string_new(monitor);
+    m->generation = hs->generation;
+    g_hash_table_insert(hs->monitors, m->name->str, m);
+  }
+
+  if (active && m)
+    m->active_workspace_id = id;
+  if (focused) {
+    string_update(hs->focused_monitor, monitor);
+    hs->active_workspace_id = id;
+  }
+}
+
+// Parses the leading id of "ID,REST" and points rest past the comma
+static gint parse_id(gchar *data, gchar **rest) {
+  gchar *end = NULL;
+  gint id = (gint)g_ascii_strtoll(data, &end, 10);
+  if (rest)
+    *rest = *end == ',' ? end + 1 : end;
+  return id;
+}
+
+// Splits "A,B,C" in place into n fields, the last one keeps any commas.
+// Returns FALSE if there are fewer fields
+static gboolean split_fields(gchar *data, gchar **fields, guint n) {
+  for (guint i = 0; i + 1 < n; i++) {
+    fields[i] = data;
+    gchar *comma = strchr(data, ',');
+    if (!comma)
+      return FALSE;
+    *comma = '\0';
+    data = comma + 1;
+  }
+  fields[n - 1] = data;
+  return TRUE;
+}
+
+static HyprlandChange set_active(HyprlandState *hs, HyprlandWorkspace *w) {
+  if (w->monitor->len > 0) {
+    HyprlandMonitor *m = g_hash_table_lookup(hs->monitors, w->monitor->str);
+    if (m)
+      m->active_workspace_id = w->id;
+  }
+
+  if (hs->active_workspace_id == w->id)
+    return HYPRLAND_CHANGED_NONE;
+  hs->active_workspace_id = w->id;
+  return HYPRLAND_CHANGED_ACTIVE;
+}
+
+static HyprlandChange set_focused_monitor(HyprlandState *hs,
+                                          const gchar *monitor,
+                                          HyprlandWorkspace *w) {
+  string_update(hs->focused_monitor, monitor);
+  if (!w)
+    return HYPRLAND_CHANGED_RESYNC;
+  return set_active(hs, w);
+}
+
+/*
+ * Applies one line from the event socket to the state
+ *
+ * data is the part after ">>" and is modified while parsing
+ */
+HyprlandChange hyprland_state_apply_event(HyprlandState *hs,
+                                          const gchar *event, gchar *data) {
+  gchar *rest = NULL;
+
+  if (g_str_equal(event, "workspacev2")) { // ID,NAME
+    HyprlandWorkspace *w = hyprland_state_get_workspace(hs, parse_id(data, NULL));
+    if (!w)
+      return HYPRLAND_CHANGED_RESYNC;
+    return set_active(hs, w);
+  }
+
+  if (g_str_equal(event, "focusedmonv2")) { // MONNAME,ID
+    gchar *comma = strchr(data, ',');
+    if (!comma)
+      return HYPRLAND_CHANGED_NONE;
+    *comma = '\0';
+    HyprlandWorkspace *w =
+        hyprland_state_get_workspace(hs, parse_id(comma + 1, NULL));
+    return set_focused_monitor(hs, data, w);
+  }
+
+  if (g_str_equal(event, "focusedmon")) { // MONNAME,NAME
+    gchar *comma = strchr(data, ',');
+    if (!comma)
+      return HYPRLAND_CHANGED_NONE;
+    *comma = '\0';
+    HyprlandWorkspace *w = find_workspace_by_name(hs, comma + 1);
+    return set_focused_monitor(hs, data, w);
+  }
+
+  if (g_str_equal(event, "createworkspacev2")) { // ID,NAME
+    gint id = parse_id(data, &rest);
+    HyprlandWorkspace *w = hyprland_state_get_workspace(hs, id);
+    if (!w) {
+      w = workspace_new(id);
+      g_hash_table_insert(hs->workspaces, GINT_TO_POINTER(id), w);
+    }
+    string_update(w->name, rest);
+    // The event has no monitor, new workspaces open on the focused one
+    string_update(w->monitor, hs->focused_monitor->str);
+    g_string_truncate(w->last_window_title, 0);
+    w->generation = hs->generation;
+    return HYPRLAND_CHANGED_WORKSPACES;
+  }
+
+  if (g_str_equal(event, "destroyworkspacev2")) { // ID,NAME
+    gint id = parse_id(data, NULL);
+    if (!g_hash_table_remove(hs->workspaces, GINT_TO_POINTER(id)))
+      return HYPRLAND_CHANGED_RESYNC;
+    return HYPRLAND_CHANGED_WORKSPACES;
+  }
+
+  if (g_str_equal(event, "renameworkspace")) { // ID,NEWNAME
+    HyprlandWorkspace *w = hyprland_state_get_workspace(hs, parse_id(data, &rest));
+    if (!w)
+      return HYPRLAND_CHANGED_RESYNC;
+    if (!string_update(w->name, rest))
+      return HYPRLAND_CHANGED_NONE;
+    return HYPRLAND_CHANGED_WORKSPACES;
+  }
+
+  if (g_str_equal(event, "moveworkspacev2")) { // ID,NAME,MONNAME
+    HyprlandWorkspace *w = hyprland_state_get_workspace(hs, parse_id(data, &rest));
+    // The name can contain commas, but the monitor name can not
+    gchar *monitor = strrchr(rest, ',');
+    if (!w || !monitor)
+      return HYPRLAND_CHANGED_RESYNC;
+    if (!string_update(w->monitor, monitor + 1))
+      return HYPRLAND_CHANGED_NONE;
+    return HYPRLAND_CHANGED_WORKSPACES;
+  }
+
+  if (g_str_equal(event, "activewindow")) { // CLASS,TITLE
+    HyprlandWorkspace *w =
+        hyprland_state_get_workspace(hs, hs->active_workspace_id);
+    gchar *comma = strchr(data, ',');
+    if (!w || !comma || !string_update(w->last_window_title, comma + 1))
+      return HYPRLAND_CHANGED_NONE;
+    return HYPRLAND_CHANGED_TITLE;
+  }
+
+  if (g_str_equal(event, "openwindow")) { // ADDRESS,WORKSPACENAME,CLASS,TITLE
+    gchar *fields[4];
+    if (!split_fields(data, fields, G_N_ELEMENTS(fields)))
+      return HYPRLAND_CHANGED_NONE;
+    HyprlandWorkspace *ws = find_workspace_by_name(hs, fields[1]);
+    if (!ws)
+      return HYPRLAND_CHANGED_RESYNC;
+
+    guint64 address = parse_address(fields[0]);
+    HyprlandWindow *w = g_hash_table_lookup(hs->windows, &address);
+    if (!w)
+      w = window_open(hs, address, ws->id);
+    window_place(hs, w, ws->id, fields[2]);
+    string_update(w->title, fields[3]);
+    w->generation = hs->generation;
+    return HYPRLAND_CHANGED_WINDOWS;
+  }
+
+  if (g_str_equal(event, "closewindow")) { // ADDRESS
+    guint64 address = parse_address(data);
+    HyprlandWindow *w = g_hash_table_lookup(hs->windows, &address);
+    if (!w)
+      return HYPRLAND_CHANGED_NONE;
+    HyprlandChange changes = HYPRLAND_CHANGED_WINDOWS;
+    if (w->fullscreen & HYPRLAND_FULLSCREEN_FULL)
+      changes |= HYPRLAND_CHANGED_FULLSCREEN;
+    if (address == hs->active_window_address)
+      changes |= HYPRLAND_CHANGED_ACTIVE_WINDOW;
+    windows_changed(hs, w->workspace_id);
+    g_hash_table_remove(hs->windows, &address);
+    return changes;
+  }
+
+  if (g_str_equal(event, "activewindowv2")) { // ADDRESS, or "," for none
+    guint64 address = parse_address(data);
+    if (address == hs->active_window_address)
+      return HYPRLAND_CHANGED_NONE;
+    hs->active_window_address = address;
+    return HYPRLAND_CHANGED_ACTIVE_WINDOW;
+  }
+
+  if (g_str_equal(event, "windowtitlev2")) { // ADDRESS,TITLE
+    gchar *comma = strchr(data, ',');
+    if (!comma)
+      return HYPRLAND_CHANGED_NONE;
+    guint64 address = parse_address(data);
+    HyprlandWindow *w = g_hash_table_lookup(hs->windows, &address);
+    if (!w || !string_update(w->title, comma + 1) ||
+        address != hs->active_window_address)
+      return HYPRLAND_CHANGED_NONE;
+    return HYPRLAND_CHANGED_ACTIVE_WINDOW;
+  }
+
+  if (g_str_equal(event, "movewindowv2")) { // ADDRESS,WORKSPACEID,NAME
+    gchar *comma = strchr(data, ',');
+    if (!comma)
+      return HYPRLAND_CHANGED_NONE;
+    guint64 address = parse_address(data);
+    HyprlandWindow *w = g_hash_table_lookup(hs->windows, &address);
+    if (!w)
+      return HYPRLAND_CHANGED_RESYNC;
+    gint id = parse_id(comma + 1, NULL);
+    if (w->workspace_id == id)
+      return HYPRLAND_CHANGED_NONE;
+    window_place(hs, w, id, w->class->str);
+    return HYPRLAND_CHANGED_WINDOWS;
+  }
+
+  if (g_str_equal(event, "fullscreen")) { // 1 or 0
+    /*
+     * Only the focused window can change fullscreen. 1 is sent for maximized
+     * windows too, and again when one goes from maximized to fullscreen, so
+     * only 0 tells the mode.
+     */
+    HyprlandWindow *w = hyprland_state_get_active_window(hs);
+    if (!g_str_equal(data, "0"))
+      return HYPRLAND_CHANGED_FULLSCREEN_MODE;
+    if (!w || w->fullscreen == HYPRLAND_FULLSCREEN_NONE)
+      return HYPRLAND_CHANGED_NONE;
+    gboolean covered = w->fullscreen & HYPRLAND_FULLSCREEN_FULL;
+    w->fullscreen = HYPRLAND_FULLSCREEN_NONE;
+    return covered ? HYPRLAND_CHANGED_FULLSCREEN : HYPRLAND_CHANGED_NONE;
+  }
+
+  if (g_str_equal(event, "monitoraddedv2") ||
+      g_str_equal(event, "monitorremoved")) {
+    // Workspaces move between monitors without events of their own
+    return HYPRLAND_CHANGED_RESYNC;
+  }
+
+  return HYPRLAND_CHANGED_NONE;
+}
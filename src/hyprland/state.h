@@ -0,0 +1,120 @@
+#ifndef HYPRLAND_STATE_H
+#define HYPRLAND_STATE_H
+
+#include <glib.h>
+
+/*
+ * The records are reused across syncs and their strings are updated in place,
+ * an unchanged state is read without allocating.
+ */
+typedef struct {
+  gint id;
+  GString *name;
+  // Empty if not known yet
+  GString *monitor;
+  GString *last_window_title;
+  /*
+   * Changes whenever a window opens, closes, moves in or out, or gets another
+   * class. Unique across workspaces, to compare with the one icons were last
+   * set for.
+   */
+  guint64 windows_version;
+  // Sync the workspace was last seen in
+  guint generation;
+} HyprlandWorkspace;
+
+typedef struct {
+  GString *name;
+  gint active_workspace_id;
+  guint generation;
+} HyprlandMonitor;
+
+// The fullscreen field of j/clients, 3 is both
+typedef enum {
+  HYPRLAND_FULLSCREEN_NONE = 0,
+  // Fills the work area, the bars stay visible
+  HYPRLAND_FULLSCREEN_MAXIMIZED = 1 << 0,
+  // Covers the whole monitor, bars included
+  HYPRLAND_FULLSCREEN_FULL = 1 << 1,
+} HyprlandFullscreen;
+
+typedef struct {
+  guint64 address;
+  gint workspace_id;
+  GString *class;
+  GString *title;
+  HyprlandFullscreen fullscreen;
+  // Windows are listed in the order hyprland reported them
+  guint64 serial;
+  guint generation;
+} HyprlandWindow;
+
+typedef enum {
+  HYPRLAND_CHANGED_NONE = 0,
+  // Workspaces were added, removed, renamed or moved
+  HYPRLAND_CHANGED_WORKSPACES = 1 << 0,
+  HYPRLAND_CHANGED_ACTIVE = 1 << 1,
+  HYPRLAND_CHANGED_TITLE = 1 << 2,
+  // An event did not match the model, it has to be synced again
+  HYPRLAND_CHANGED_RESYNC = 1 << 3,
+  // Windows were opened, closed or moved to another workspace, the
+  // windows_version of their workspaces tells which
+  HYPRLAND_CHANGED_WINDOWS = 1 << 4,
+  // Another window got focus, or the focused one changed its title
+  HYPRLAND_CHANGED_ACTIVE_WINDOW = 1 << 5,
+  // A window covered its monitor or stopped covering it
+  HYPRLAND_CHANGED_FULLSCREEN = 1 << 6,
+  /*
+   * The focused window changed its fullscreen mode, which the event does not
+   * tell. Handled by the service with hyprland_state_update_active_window,
+   * never emitted.
+   */
+  HYPRLAND_CHANGED_FULLSCREEN_MODE = 1 << 7,
+} HyprlandChange;
+
+/*
+ * In memory copy of the hyprland workspaces.
+ * Filled by hyprland_state_sync and kept up to date with the events from the
+ * event socket.
+ */
+typedef struct {
+  GHashTable *workspaces; // id -> HyprlandWorkspace
+  GHashTable *monitors;   // name -> HyprlandMonitor
+  GHashTable *windows;    // address -> HyprlandWindow
+  guint64 next_window_serial;
+  // Last HyprlandWorkspace.windows_version handed out
+  guint64 windows_version;
+  // 0 if no window has focus
+  guint64 active_window_address;
+  GString *focused_monitor;
+  gint active_workspace_id;
+  guint generation;
+} HyprlandState;
+
+// Requests whose replies hyprland_state_sync expects, NULL terminated
+extern const gchar *const hyprland_state_sync_requests[];
+
+HyprlandState *hyprland_state_new(void);
+void hyprland_state_free(HyprlandState *hs);
+
+gboolean hyprland_state_sync(HyprlandState *hs, gchar **replies);
+HyprlandChange hyprland_state_apply_event(HyprlandState *hs,
+                                          const gchar *event, gchar *data);
+HyprlandChange hyprland_state_update_active_window(HyprlandState *hs,
+                                                   gchar *reply);
+void hyprland_state_restore_workspace(HyprlandState *hs, gint id,
+                                      const gchar *name, const gchar *monitor,
+                                      gboolean active, gboolean focused);
+
+HyprlandWorkspace *hyprland_state_get_workspace(HyprlandState *hs, gint id);
+void hyprland_state_get_workspaces(HyprlandState *hs, const gchar *monitor,
+                                   GPtrArray *out);
+HyprlandMonitor *hyprland_state_get_monitor(HyprlandState *hs,
+                                            const gchar *name);
+HyprlandWindow *hyprland_state_get_active_window(HyprlandState *hs);
+gboolean hyprland_state_monitor_is_fullscreen(HyprlandState *hs,
+                                              const gchar *monitor);
+void hyprland_state_get_windows(HyprlandState *hs, gint workspace_id,
+                                GPtrArray *out);
+
+#endif // !HYPRLAND_STATE_H
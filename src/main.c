@@ -1,13 +1,24 @@
 #include "main.h"
+#include "backend_client.h"
 #include "bar/bar.h"
 #include "bluetooth/bt.h"
+#include "control.h"
 #include "log.h"
+#include "metrics.h"
 #include "networking.h"
 #include "quicksettings/quicksettings.h"
+#include "snapshot.h"
+#include "spawn_broker.h"
+#include "startup.h"
+#include "state_export.h"
+#include "trace.h"
+#include "watchdog.h"
 #include <gio/gio.h>
 #include <glib-object.h>
+#include <glib-unix.h>
 #include <glib.h>
 #include <gtk/gtk.h>
+#include <signal.h>
 #include <unistd.h>
 #include <wp/core.h>
 #include <wp/wp.h>
@@ -28,14 +39,13 @@ static void on_plugin_loaded(WpCore *core, GAsyncResult *res,
   GError *error = NULL;
 
   if (!wp_core_load_component_finish(core, res, &error)) {
-    fprintf(stderr, "%s\n", error->message);
-    ctx->exit_code = 1;
-    g_main_loop_quit(ctx->loop);
+    startup_backend_failed(STARTUP_BACKEND_PIPEWIRE, error->message);
+    g_error_free(error);
     return;
   }
 
   // If there are no more plugins to load
-  // install object manager to trigger run function
+  // install object manager, pipewire is ready once it is installed
   if (--ctx->pending_plugins == 0) {
     g_autoptr(WpPlugin) mixer_api = wp_plugin_find(core, "mixer-api");
     g_object_set(mixer_api, "scale", 1 /* cubic */, NULL);
@@ -45,93 +55,252 @@ static void on_plugin_loaded(WpCore *core, GAsyncResult *res,
   }
 }
 
-static void run(MainContext *ctx) {
-  gtk_init();
-  load_css();
+static void on_om_installed(MainContext *ctx) {
+  startup_backend_ready(STARTUP_BACKEND_PIPEWIRE);
+}
 
-  init_logger("cWidgets.log");
-  if (log_file) {
-    dup2(fileno(log_file), STDERR_FILENO);
+static void start_pipewire(MainContext *ctx) {
+  wp_init(WP_INIT_PIPEWIRE | WP_INIT_SPA_TYPES | WP_INIT_SET_PW_LOG);
+  WpCore *core = wp_core_new(g_main_context_default(), NULL, NULL);
+  WpObjectManager *om = wp_object_manager_new();
+  wp_object_manager_add_interest(om, WP_TYPE_NODE,
+                                 WP_CONSTRAINT_TYPE_PW_PROPERTY, "media.class",
+                                 "=s", "Audio/Sink", NULL);
+
+  ctx->core = core;
+  ctx->om = om;
+  g_signal_connect_swapped(om, "installed", G_CALLBACK(on_om_installed), ctx);
+
+  ctx->pending_plugins++;
+  wp_core_load_component(ctx->core, "libwireplumber-module-default-nodes-api",
+                         "module", NULL, NULL, NULL,
+                         (GAsyncReadyCallback)on_plugin_loaded, ctx);
+
+  ctx->pending_plugins++;
+  wp_core_load_component(core, "libwireplumber-module-mixer-api", "module",
+                         NULL, NULL, NULL,
+                         (GAsyncReadyCallback)on_plugin_loaded, ctx);
+
+  /* connect */
+  if (!wp_core_connect(core)) {
+    startup_backend_failed(STARTUP_BACKEND_PIPEWIRE,
+                           "Could not connect to PipeWire");
+    return;
   }
-  redirect_glib_logs();
 
-  LOG("Application started");
+  g_signal_connect_swapped(ctx->core, "disconnected",
+                           (GCallback)g_main_loop_quit, ctx->loop);
+}
 
-  bluetooth_install_signals(bluetooth_get_default());
+static void on_bluetooth_ready(const GError *error, gpointer user_data) {
+  if (error) {
+    startup_backend_failed(STARTUP_BACKEND_BLUEZ, error->message);
+    return;
+  }
 
-  GdkDisplay *display = gdk_display_get_default();
-  GListModel *monitors = gdk_display_get_monitors(display);
+  g_autoptr(Bluetooth) bt = bluetooth_get_default();
+  bluetooth_install_signals(bt);
+  startup_backend_ready(STARTUP_BACKEND_BLUEZ);
+}
+
+static void on_bus_ready(GObject *source, GAsyncResult *res,
+                         gpointer user_data) {
+  MainContext *ctx = user_data;
+  GError *error = NULL;
+
+  ctx->dbus_connection = g_bus_get_finish(res, &error);
+  if (!ctx->dbus_connection) {
+    startup_backend_failed(STARTUP_BACKEND_DBUS, error->message);
+    startup_backend_failed(STARTUP_BACKEND_BLUEZ, error->message);
+    g_error_free(error);
+    return;
+  }
+
+  startup_backend_ready(STARTUP_BACKEND_DBUS);
+  bluetooth_connect(ctx->dbus_connection, on_bluetooth_ready, ctx);
+}
+
+static void on_network_ready(const GError *error, gpointer user_data) {
+  if (error)
+    startup_backend_failed(STARTUP_BACKEND_NETWORK, error->message);
+  else
+    startup_backend_ready(STARTUP_BACKEND_NETWORK);
+}
+
+static void start_backends(MainContext *ctx) {
+  if (ctx->backends_started)
+    return;
+  ctx->backends_started = TRUE;
+
+  // Backends connect concurrently, none of them holds up the bars
+  g_bus_get(G_BUS_TYPE_SYSTEM, NULL, on_bus_ready, ctx);
+  start_pipewire(ctx);
+  net_init(on_network_ready, ctx);
+}
+
+static void on_backend_ready(gpointer user_data) {
+  startup_backend_ready(STARTUP_BACKEND_STATE);
+}
+
+// In split mode, the pages list and control what the state does not hold
+static void on_quick_settings_changed(gpointer user_data) {
+  const gchar *page;
+  if (get_open_quick_settings(&page))
+    start_backends(user_data);
+}
+
+static guint64 count_widgets(GtkWidget *widget) {
+  guint64 n = 1;
+  for (GtkWidget *child = gtk_widget_get_first_child(widget); child;
+       child = gtk_widget_get_next_sibling(child))
+    n += count_widgets(child);
+  return n;
+}
+
+// Widgets in all windows, popovers are windows of their own
+static guint64 live_widgets(void) {
+  GListModel *toplevels = gtk_window_get_toplevels();
+  guint64 n = 0;
+  for (guint i = 0; i < g_list_model_get_n_items(toplevels); i++) {
+    g_autoptr(GtkWidget) window = g_list_model_get_item(toplevels, i);
+    n += count_widgets(window);
+  }
+  return n;
+}
+
+static gboolean on_terminate(gpointer user_data) {
+  g_main_loop_quit(user_data);
+  return G_SOURCE_REMOVE;
+}
+
+// GdkMonitor -> bar window, holding a ref on the monitor
+static GHashTable *bars = NULL;
+
+static void add_monitor(MainContext *ctx, GdkMonitor *monitor) {
+  GdkDisplay *display = gdk_monitor_get_display(monitor);
+  const char *name = gdk_monitor_get_model(monitor);
+  g_message("Assigning windows to monitor: %s", name);
+
+  GtkWidget *window = bar(display, monitor, ctx);
+  start_quick_settings(display, monitor);
+  g_hash_table_insert(bars, g_object_ref(monitor), window);
+}
+
+static void remove_monitor(GdkMonitor *monitor, GtkWidget *window) {
+  g_message("Removing windows of monitor: %s",
+            gdk_monitor_get_connector(monitor));
+  stop_quick_settings(monitor);
+  gtk_window_destroy(GTK_WINDOW(window));
+}
+
+/*
+ * Only creates and destroys the windows of plugged and unplugged monitors,
+ * the backends keep running
+ */
+static void on_monitors_changed(GListModel *monitors, guint position,
+                                guint removed, guint added,
+                                gpointer user_data) {
+  MainContext *ctx = user_data;
+  gint64 start = g_get_monotonic_time();
+  g_autoptr(GHashTable) present = g_hash_table_new(NULL, NULL);
   guint n_monitors = g_list_model_get_n_items(monitors);
 
-  for (guint i = 0; i < n_monitors; i++) {
+  GHashTableIter iter;
+  gpointer monitor, window;
 
-    GdkMonitor *monitor = GDK_MONITOR(g_list_model_get_item(monitors, i));
-    const char *name = gdk_monitor_get_model(monitor);
-    g_message("Assigning windows to monitor: %s", name);
+  for (guint i = 0; i < n_monitors; i++) {
+    g_autoptr(GdkMonitor) m = g_list_model_get_item(monitors, i);
+    g_hash_table_add(present, m);
+  }
 
-    bar(display, monitor, ctx->dbus_connection, ctx->core);
+  g_hash_table_iter_init(&iter, bars);
+  while (g_hash_table_iter_next(&iter, &monitor, &window)) {
+    if (!g_hash_table_contains(present, monitor)) {
+      remove_monitor(monitor, window);
+      g_hash_table_iter_remove(&iter);
+    }
+  }
 
-    start_quick_settings(display, monitor, ctx->om, ctx->core);
+  for (guint i = 0; i < n_monitors; i++) {
+    g_autoptr(GdkMonitor) m = g_list_model_get_item(monitors, i);
+    if (!g_hash_table_contains(bars, m))
+      add_monitor(ctx, m);
   }
+
+  g_message("Monitors changed, %u removed and %u added in %.1f ms", removed,
+            added, (g_get_monotonic_time() - start) / 1000.0);
+}
+
+// Widgets of backends that are not ready yet fill in later
+static void run(MainContext *ctx) {
+  GdkDisplay *display = gdk_display_get_default();
+  GListModel *monitors = gdk_display_get_monitors(display);
+
+  bars = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref,
+                               NULL);
+  g_signal_connect(monitors, "items-changed", G_CALLBACK(on_monitors_changed),
+                   ctx);
+  on_monitors_changed(monitors, 0, 0, g_list_model_get_n_items(monitors), ctx);
 }
 
 int main(int argc, char *argv[]) {
+  // Forked while the process is small and has no threads yet
+  spawn_init();
+
+  MainContext ctx = {0};
+  startup_init(&ctx);
   g_message("Starting cWidget\n");
 
   GMainLoop *loop = g_main_loop_new(NULL, FALSE);
-  MainContext ctx = {0};
   ctx.loop = loop;
 
-  // DBUS
-  GError *error = NULL;
-  ctx.dbus_connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
-  if (!ctx.dbus_connection) {
-    g_printerr("Failed to connect to system bus: %s\n", error->message);
-    g_error_free(error);
-    return 1;
-  }
-  bluetooth_set_dbus_conn(ctx.dbus_connection);
-
-  // WIREPLUMBER
-  wp_init(WP_INIT_PIPEWIRE | WP_INIT_SPA_TYPES | WP_INIT_SET_PW_LOG);
-  WpCore *core = wp_core_new(g_main_context_default(), NULL, NULL);
-  WpObjectManager *om = wp_object_manager_new();
-  wp_object_manager_add_interest(om, WP_TYPE_NODE,
-                                 WP_CONSTRAINT_TYPE_PW_PROPERTY, "media.class",
-                                 "=s", "Audio/Sink", NULL);
+  gtk_init();
+  load_css();
 
-  ctx.core = core;
-  ctx.om = om;
+  // Also takes over stderr
+  init_logger("cWidgets.log");
+  redirect_glib_logs();
+  watchdog_start();
+  metrics_init();
+  metrics_add_gauge("live_widgets", live_widgets);
+  TRACE_INIT();
 
-  ctx.pending_plugins++;
-  wp_core_load_component(ctx.core, "libwireplumber-module-default-nodes-api",
-                         "module", NULL, NULL, NULL,
-                         (GAsyncReadyCallback)on_plugin_loaded, &ctx);
+  LOG("Application started");
 
-  ctx.pending_plugins++;
-  wp_core_load_component(core, "libwireplumber-module-mixer-api", "module",
-                         NULL, NULL, NULL,
-                         (GAsyncReadyCallback)on_plugin_loaded, &ctx);
+  // Before the widgets, they start out with the last known state
+  snapshot_init();
 
-  /* connect */
-  if (!wp_core_connect(core)) {
-    g_printerr("Could not connect to PipeWire\n");
-    return 1;
+  /*
+   * In split mode the bar follows cwidgets-backend, which exports the state,
+   * and the quick settings connect their own backends when first opened
+   */
+  ctx.split = backend_client_enabled();
+  if (ctx.split) {
+    backend_client_start(on_backend_ready, &ctx);
+    connect_quick_settings_changed(on_quick_settings_changed, &ctx);
+  } else {
+    startup_backend_skip(STARTUP_BACKEND_STATE);
+    state_export_init();
+    start_backends(&ctx);
   }
 
-  g_signal_connect_swapped(ctx.core, "disconnected",
-                           (GCallback)g_main_loop_quit, ctx.loop);
-  // Run after object manager is installed
-  NetInitData *data = g_new0(NetInitData, 1);
-  data->run = run;
-  data->ctx = &ctx;
-  g_signal_connect_swapped(om, "installed", (GCallback)net_init, data);
+  run(&ctx);
+  startup_mark("windows created");
+  control_init();
+
+  // Lets the snapshot be written on the way out
+  g_unix_signal_add(SIGTERM, on_terminate, loop);
+  g_unix_signal_add(SIGINT, on_terminate, loop);
 
   g_main_loop_run(loop);
 
   LOG("Application exiting");
+  control_stop();
+  backend_client_stop();
+  state_export_stop();
+  snapshot_flush();
+  TRACE_WRITE();
   close_logger();
-  g_free(data);
 
   return ctx.exit_code;
 }
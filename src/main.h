@@ -12,6 +12,10 @@ typedef struct {
   WpObjectManager *om;
   guint pending_plugins;
   gint exit_code;
+  // The bar renders what cwidgets-backend publishes, see backend_client.c
+  gboolean split;
+  // The backends of this process are connecting or connected
+  gboolean backends_started;
 } MainContext;
 
 #endif // !MAIN_H
@@ -8,25 +8,29 @@
 static NMClient *global_client = NULL;
 static NMDeviceWifi *cached_wifi = NULL;
 
+typedef struct {
+  NetReadyFunc ready;
+  gpointer user_data;
+} NetInitData;
+
 static void on_client_ready(GObject *source, GAsyncResult *res,
                             gpointer user_data) {
+  NetInitData *data = user_data;
   GError *error = NULL;
   NMClient *client;
 
   client = nm_client_new_finish(res, &error);
   if (!client) {
     g_printerr("Failed to create NMClient: %s\n", error->message);
+    data->ready(error, data->user_data);
     g_error_free(error);
+    g_free(data);
     return;
   }
   global_client = g_object_ref(client);
   const GPtrArray *devices = nm_client_get_devices(global_client);
-  if (!devices) {
-    g_printerr("Failed to get devices from client\n");
-    return;
-  }
 
-  for (guint i = 0; i < devices->len; i++) {
+  for (guint i = 0; devices && i < devices->len; i++) {
     NMDevice *device = g_ptr_array_index(devices, i);
     if (NM_IS_DEVICE_WIFI(device)) {
       NMDeviceWifi *wifi = NM_DEVICE_WIFI(device);
@@ -37,21 +41,29 @@ static void on_client_ready(GObject *source, GAsyncResult *res,
       break;
     }
   }
-  if (cached_wifi == NULL) {
+  // The widgets cope without one
+  if (cached_wifi == NULL)
     g_printerr("Could not get a wifi device\n");
-    return;
-  }
 
-  NetInitData *data = user_data;
-  data->run(data->ctx);
+  data->ready(NULL, data->user_data);
+  g_free(data);
 }
 
-void net_init(NetInitData *data) {
+// Connects to NetworkManager and calls ready when done
+void net_init(NetReadyFunc ready, gpointer user_data) {
+  NetInitData *data = g_new0(NetInitData, 1);
+  data->ready = ready;
+  data->user_data = user_data;
   nm_client_new_async(NULL, on_client_ready, data);
 }
 
-NMClient *net_get_client(void) { return g_object_ref(global_client); }
-NMDeviceWifi *net_get_wifi_device(void) { return g_object_ref(cached_wifi); }
+// NULL until net_init is done
+NMClient *net_get_client(void) {
+  return global_client ? g_object_ref(global_client) : NULL;
+}
+NMDeviceWifi *net_get_wifi_device(void) {
+  return cached_wifi ? g_object_ref(cached_wifi) : NULL;
+}
 
 gchar *ap_get_ssid(NMAccessPoint *ap) {
   if (!ap) {
@@ -2,17 +2,14 @@
 #define NETOWRKING_H
 
 #include "NetworkManager.h"
-#include "main.h"
-#include <gtk/gtk.h>
+#include <glib.h>
 
 G_BEGIN_DECLS
 
-typedef struct {
-  void (*run)(MainContext *);
-  MainContext *ctx;
-} NetInitData;
+// error is NULL on success
+typedef void (*NetReadyFunc)(const GError *error, gpointer user_data);
 
-void net_init(NetInitData *data);
+void net_init(NetReadyFunc ready, gpointer user_data);
 NMClient *net_get_client(void);
 NMDeviceWifi *net_get_wifi_device(void);
 
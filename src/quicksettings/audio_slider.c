@@ -1,6 +1,10 @@
 #include "audio_slider.h"
 #include "glibconfig.h"
 #include "gtk/gtkrevealer.h"
+#include "log.h"
+#include "page.h"
+#include "spawn_broker.h"
+#include "status_icons.h"
 #include "util.h"
 #include "wp/core.h"
 #include "wp/node.h"
@@ -17,10 +21,6 @@
 #define ID "id"
 
 static const char ICON_MUTED[] = "audio-volume-muted-symbolic";
-static const char ICON_LOW[] = "audio-volume-low-symbolic";
-static const char ICON_MEDIUM[] = "audio-volume-medium-symbolic";
-static const char ICON_HIGH[] = "audio-volume-high-symbolic";
-static const char ICON_OVERAMPLIFIED[] = "audio-volume-overamplified-symbolic";
 
 static const gchar *sink_media_class = "Audio/Sink";
 
@@ -38,10 +38,8 @@ typedef struct {
 } AudioSlider;
 
 static void set_current_sink(GtkButton *btn, gpointer user_data) {
-  guint32 id = GPOINTER_TO_UINT(user_data);
-  char cmd[256];
-  snprintf(cmd, sizeof(cmd), "wpctl set-default %u", id);
-  sh(cmd);
+  g_autofree gchar *id = g_strdup_printf("%u", GPOINTER_TO_UINT(user_data));
+  SPAWN("wpctl", "set-default", id);
 }
 
 static GtkWidget *create_sink_entry(WpNode *node, gboolean active) {
@@ -145,21 +143,8 @@ static void on_object_changed(WpObjectManager *om, gpointer user_data) {
 
 static void update_volume_image(AudioSlider *as, gdouble volume,
                                 gboolean mute) {
-  const char *icon_name;
-  if (mute) {
-    icon_name = ICON_MUTED;
-  } else if (volume == 0) {
-    icon_name = ICON_MUTED;
-  } else if (volume < 33) {
-    icon_name = ICON_LOW;
-  } else if (volume < 66) {
-    icon_name = ICON_MEDIUM;
-  } else if (volume <= 100) {
-    icon_name = ICON_HIGH;
-  } else {
-    icon_name = ICON_OVERAMPLIFIED;
-  }
-  gtk_image_set_from_icon_name(GTK_IMAGE(as->image), icon_name);
+  status_icons_set(as->image, STATUS_ICONS_AUDIO,
+                   status_icons_audio_index(mute, volume));
 }
 
 static void value_changed(GtkRange *self, gpointer user_data) {
@@ -169,14 +154,9 @@ static void value_changed(GtkRange *self, gpointer user_data) {
   gboolean mute = volume == 0;
   update_volume_image(as, volume, mute);
 
-  char volume_cmd[256] = {0};
-  snprintf(volume_cmd, sizeof(volume_cmd),
-           "wpctl set-volume @DEFAULT_AUDIO_SINK@ %f%%", volume);
-  sh(volume_cmd);
-  char mute_cmd[256] = {0};
-  snprintf(mute_cmd, sizeof(mute_cmd), "wpctl set-mute @DEFAULT_AUDIO_SINK@ %d",
-           mute);
-  sh(mute_cmd);
+  g_autofree gchar *volume_arg = g_strdup_printf("%f%%", volume);
+  SPAWN("wpctl", "set-volume", "@DEFAULT_AUDIO_SINK@", volume_arg);
+  SPAWN("wpctl", "set-mute", "@DEFAULT_AUDIO_SINK@", mute ? "1" : "0");
 }
 
 static void on_mixer_changed(WpPlugin *mixer_api, guint32 node_id,
@@ -190,7 +170,7 @@ static void on_mixer_changed(WpPlugin *mixer_api, guint32 node_id,
 
     g_signal_emit_by_name(as->mixer_api, "get-volume", node_id, &variant);
     if (!variant) {
-      fprintf(stderr, "Node %d does not support volume\n", node_id);
+      LOG_WARNING("Node %u does not support volume", node_id);
       return;
     }
     g_variant_lookup(variant, "volume", "d", &volume);
@@ -237,6 +217,13 @@ static void toggle_revealer(GtkButton *btn, gpointer user_data) {
                                      : "go-down-symbolic");
 }
 
+static void audio_slider_free(gpointer data) {
+  AudioSlider *as = data;
+  g_clear_object(&as->mixer_api);
+  g_clear_object(&as->def_nodes_api);
+  g_free(as);
+}
+
 GtkWidget *create_audio_slider(WpObjectManager *om, WpCore *core) {
   AudioSlider *as = g_new0(AudioSlider, 1);
   GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
@@ -278,15 +265,20 @@ GtkWidget *create_audio_slider(WpObjectManager *om, WpCore *core) {
 
   g_signal_connect(toggle_revealer_btn, "clicked", G_CALLBACK(toggle_revealer),
                    as);
+  page_register_revealer(box, revealer, toggle_revealer_btn);
 
   as->value_changed_id =
       g_signal_connect(scale, "value-changed", G_CALLBACK(value_changed), as);
   g_signal_connect(scale, "change-value", G_CALLBACK(on_change_value), NULL);
 
+  g_object_set_data_full(G_OBJECT(box), "audio-slider", as,
+                         audio_slider_free);
+
+  // The plugins and object manager outlive the window
   as->def_nodes_api = wp_plugin_find(core, "default-nodes-api");
   if (as->def_nodes_api) {
-    g_signal_connect(as->def_nodes_api, "changed",
-                     G_CALLBACK(on_def_nodes_changed), as);
+    signal_connect_owned(as->def_nodes_api, "changed",
+                         G_CALLBACK(on_def_nodes_changed), as, box);
 
     on_def_nodes_changed(as->def_nodes_api, as);
   } else {
@@ -294,16 +286,19 @@ GtkWidget *create_audio_slider(WpObjectManager *om, WpCore *core) {
   }
   as->mixer_api = wp_plugin_find(core, "mixer-api");
   if (as->mixer_api) {
-    g_signal_connect(as->mixer_api, "changed", G_CALLBACK(on_mixer_changed),
-                     as);
+    signal_connect_owned(as->mixer_api, "changed",
+                         G_CALLBACK(on_mixer_changed), as, box);
     on_mixer_changed(as->mixer_api, as->default_sink_id, as);
   } else {
     g_warning("Could not find mixer-api plugin");
   }
 
-  g_signal_connect(om, "object-added", G_CALLBACK(on_object_added), as);
-  g_signal_connect(om, "object-removed", G_CALLBACK(on_object_removed), as);
-  g_signal_connect(om, "objects-changed", G_CALLBACK(on_object_changed), as);
+  signal_connect_owned(om, "object-added", G_CALLBACK(on_object_added), as,
+                       box);
+  signal_connect_owned(om, "object-removed", G_CALLBACK(on_object_removed), as,
+                       box);
+  signal_connect_owned(om, "objects-changed", G_CALLBACK(on_object_changed),
+                       as, box);
   current_objects(om, as);
 
   return box;
@@ -3,6 +3,7 @@
 #include "bt.h"
 #include "device.h"
 #include "page.h"
+#include "updates.h"
 #include "util.h"
 #include <glib-object.h>
 #include <glib.h>
@@ -12,10 +13,14 @@
 
 #define MAX_NAME_LEN 20
 #define ENTRY_HEIGHT 30
+// Devices come and go in bursts while discovering
+#define DEVICES_INTERVAL_MS 250
 
 typedef struct {
   Device *current_device;
   Bluetooth *bt;
+  // Latest device list, owned by bt
+  GHashTable *devices;
 } BluetoothData;
 
 static void launch_bt_settings(void) { sh("blueberry"); }
@@ -89,15 +94,15 @@ static gboolean for_each_device(gpointer key, gpointer value,
   return FALSE;
 }
 
-static void on_devices_change(Bluetooth *bt, GHashTable *devices,
-                              gpointer user_data) {
+static void apply_devices(gpointer user_data) {
   PageButton *pb = user_data;
-  GHashTable *copy = g_hash_table_new_similar(devices);
+  BluetoothData *bd = (BluetoothData *)pb->page_data;
+  GHashTable *copy = g_hash_table_new_similar(bd->devices);
 
   // Copy table so that it can be pruned
   GHashTableIter iter;
   gpointer key, value;
-  g_hash_table_iter_init(&iter, devices);
+  g_hash_table_iter_init(&iter, bd->devices);
   while (g_hash_table_iter_next(&iter, &key, &value)) {
     g_hash_table_insert(copy, g_strdup(key), g_object_ref(value));
   }
@@ -114,6 +119,15 @@ static void on_devices_change(Bluetooth *bt, GHashTable *devices,
   g_hash_table_unref(copy);
 }
 
+static void on_devices_change(Bluetooth *bt, GHashTable *devices,
+                              gpointer user_data) {
+  PageButton *pb = user_data;
+  BluetoothData *bd = (BluetoothData *)pb->page_data;
+  bd->devices = devices;
+  bar_post_update_limited(pb->revealer_box, apply_devices, pb,
+                          DEVICES_INTERVAL_MS);
+}
+
 GtkWidget *bluetooth_page(void) {
   PageButton *pb = create_page_button("Bluetooth", "bluetooth-symbolic");
   BluetoothData *bd = g_new0(BluetoothData, 1);
@@ -148,10 +162,12 @@ GtkWidget *bluetooth_page(void) {
   g_signal_connect(pb->toggle_btn, "clicked", G_CALLBACK(toggle_bluetooth),
                    bd->bt);
 
-  g_signal_connect(bd->bt, "devices-changed", G_CALLBACK(on_devices_change),
-                   pb);
+  // Bluetooth outlives the window
+  signal_connect_owned(bd->bt, "devices-changed",
+                       G_CALLBACK(on_devices_change), pb, pb->box);
 
-  g_signal_connect(bd->bt, "powered", G_CALLBACK(on_powered_changed), pb);
+  signal_connect_owned(bd->bt, "powered", G_CALLBACK(on_powered_changed), pb,
+                       pb->box);
 
   bluetooth_install_signals(bd->bt);
   bluetooth_call_signals(bd->bt);
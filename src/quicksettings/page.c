@@ -1,6 +1,9 @@
 #include "page.h"
 #include "util.h"
 
+#define PAGE_REVEALER "page-revealer"
+#define PAGE_ARROW "page-arrow"
+
 static void on_toggle_revealer(GtkButton *self, gpointer data) {
   PageButton *pb = data;
   gboolean revealing =
@@ -80,6 +83,37 @@ PageButton *create_page_button(const gchar *title_str, const gchar *icon_name) {
 
   g_signal_connect(pb->arrow_btn, "clicked", G_CALLBACK(on_toggle_revealer),
                    pb);
+  page_register_revealer(box, revealer, arrow_btn);
 
   return pb;
 }
+
+/*
+ * Lets the page be opened from outside, like the control socket does.
+ * Clicking arrow_btn must toggle the revealer.
+ */
+void page_register_revealer(GtkWidget *page, GtkWidget *revealer,
+                            GtkWidget *arrow_btn) {
+  g_object_set_data(G_OBJECT(page), PAGE_REVEALER, revealer);
+  g_object_set_data(G_OBJECT(page), PAGE_ARROW, arrow_btn);
+}
+
+gboolean page_has_revealer(GtkWidget *page) {
+  return g_object_get_data(G_OBJECT(page), PAGE_REVEALER) != NULL;
+}
+
+gboolean page_is_revealed(GtkWidget *page) {
+  GtkWidget *revealer = g_object_get_data(G_OBJECT(page), PAGE_REVEALER);
+  return revealer && gtk_revealer_get_reveal_child(GTK_REVEALER(revealer));
+}
+
+// Returns FALSE if page has no revealer registered
+gboolean page_set_revealed(GtkWidget *page, gboolean revealed) {
+  GtkWidget *arrow_btn = g_object_get_data(G_OBJECT(page), PAGE_ARROW);
+  if (!arrow_btn)
+    return FALSE;
+  // Through the button, so its arrow follows
+  if (page_is_revealed(page) != revealed)
+    g_signal_emit_by_name(arrow_btn, "clicked");
+  return TRUE;
+}
@@ -17,4 +17,10 @@ typedef struct {
 
 PageButton *create_page_button(const gchar *title_str, const gchar *icon_name);
 
+void page_register_revealer(GtkWidget *page, GtkWidget *revealer,
+                            GtkWidget *arrow_btn);
+gboolean page_has_revealer(GtkWidget *page);
+gboolean page_is_revealed(GtkWidget *page);
+gboolean page_set_revealed(GtkWidget *page, gboolean revealed);
+
 #endif // !PAGE_H
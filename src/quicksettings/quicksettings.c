@@ -4,6 +4,8 @@
 #include "gdk/gdk.h"
 #include "gtk4-layer-shell.h"
 #include "header.h"
+#include "page.h"
+#include "startup.h"
 #include "togglebutton.h"
 #include "wifi_page.h"
 #include "wp/core.h"
@@ -15,8 +17,31 @@ typedef struct {
   GtkWidget *window;
 } MonitorWidget;
 
+#define PAGES "pages"
+
+// Names of the pages for show_quick_settings_page, in order
+static const gchar *page_names[] = {"audio", "wifi", "bluetooth"};
+
+typedef struct {
+  QuickSettingsChangedFunc func;
+  gpointer user_data;
+} ChangedListener;
+
 static GHashTable *windows = NULL;
 static GtkWidget *current_open_window = NULL;
+static GArray *listeners = NULL; // ChangedListener
+
+static void notify_changed(void) {
+  for (guint i = 0; listeners && i < listeners->len; i++) {
+    ChangedListener *l = &g_array_index(listeners, ChangedListener, i);
+    l->func(l->user_data);
+  }
+}
+
+static void on_window_visible(GObject *window, GParamSpec *pspec,
+                              gpointer user_data) {
+  notify_changed();
+}
 
 static void init_windows(void) {
   if (NULL != windows)
@@ -27,7 +52,6 @@ static void init_windows(void) {
 static GtkWidget *qs_window(GdkDisplay *display, GdkMonitor *monitor) {
   GdkRectangle geometry;
   gdk_monitor_get_geometry(monitor, &geometry);
-  g_object_unref(monitor);
   GtkWidget *window = gtk_window_new();
   char buffer[32];
   snprintf(buffer, sizeof(buffer), "quicksettings");
@@ -55,8 +79,28 @@ static GtkWidget *qs_window(GdkDisplay *display, GdkMonitor *monitor) {
   return window;
 }
 
-static void quicksettings(GtkWidget *window, WpObjectManager *om,
-                          WpCore *core) {
+static void fill_audio_slider(MainContext *ctx, GtkWidget *slot) {
+  gtk_box_append(GTK_BOX(slot), create_audio_slider(ctx->om, ctx->core));
+}
+
+static void fill_wifi_page(MainContext *ctx, GtkWidget *slot) {
+  gtk_box_append(GTK_BOX(slot), wifi_page());
+}
+
+static void fill_bluetooth_page(MainContext *ctx, GtkWidget *slot) {
+  gtk_box_append(GTK_BOX(slot), bluetooth_page());
+}
+
+// Pages wait for their backend, see startup.c
+static GtkWidget *page_slot(StartupBackend backend, StartupSlotFunc func,
+                            const gchar *placeholder_icon) {
+  GtkWidget *slot = startup_slot_new(backend, func, placeholder_icon);
+  gtk_orientable_set_orientation(GTK_ORIENTABLE(slot),
+                                 GTK_ORIENTATION_VERTICAL);
+  return slot;
+}
+
+static void quicksettings(GtkWidget *window) {
   GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
   gtk_widget_add_css_class(box, "quicksettings");
 
@@ -74,27 +118,51 @@ static void quicksettings(GtkWidget *window, WpObjectManager *om,
 
   gtk_box_append(GTK_BOX(box), buttons);
 
-  GtkWidget *audio_slider = create_audio_slider(om, core);
+  GtkWidget *audio_slider = page_slot(STARTUP_BACKEND_PIPEWIRE,
+                                      fill_audio_slider,
+                                      "audio-volume-muted-symbolic");
   gtk_box_append(GTK_BOX(box), audio_slider);
 
-  GtkWidget *wifi = wifi_page();
+  GtkWidget *wifi = page_slot(STARTUP_BACKEND_NETWORK, fill_wifi_page,
+                              "network-wireless-offline-symbolic");
   gtk_box_append(GTK_BOX(box), wifi);
 
-  GtkWidget *bluetooth = bluetooth_page();
+  GtkWidget *bluetooth = page_slot(STARTUP_BACKEND_BLUEZ, fill_bluetooth_page,
+                                   "bluetooth-disabled-symbolic");
   gtk_box_append(GTK_BOX(box), bluetooth);
 
+  // In the order of page_names
+  GtkWidget **pages = g_new(GtkWidget *, G_N_ELEMENTS(page_names));
+  pages[0] = audio_slider;
+  pages[1] = wifi;
+  pages[2] = bluetooth;
+  g_object_set_data_full(G_OBJECT(window), PAGES, pages, g_free);
+
   gtk_window_set_child(GTK_WINDOW(window), box);
 }
 
-void start_quick_settings(GdkDisplay *display, GdkMonitor *monitor,
-                          WpObjectManager *om, WpCore *core) {
+void start_quick_settings(GdkDisplay *display, GdkMonitor *monitor) {
   init_windows();
   GtkWidget *window = qs_window(display, monitor);
-  quicksettings(window, om, core);
+  quicksettings(window);
+  g_signal_connect(window, "notify::visible", G_CALLBACK(on_window_visible),
+                   NULL);
 
   g_hash_table_insert(windows, monitor, window);
 }
 
+// Destroys the window of an unplugged monitor
+void stop_quick_settings(GdkMonitor *monitor) {
+  GtkWidget *window = windows ? g_hash_table_lookup(windows, monitor) : NULL;
+  if (NULL == window)
+    return;
+
+  if (window == current_open_window)
+    current_open_window = NULL;
+  g_hash_table_remove(windows, monitor);
+  gtk_window_destroy(GTK_WINDOW(window));
+}
+
 void toggle_quick_settings(GdkMonitor *monitor) {
   GtkWidget *window = g_hash_table_lookup(windows, monitor);
   if (NULL == window) {
@@ -120,3 +188,82 @@ void toggle_quick_settings(GdkMonitor *monitor) {
   else
     current_open_window = NULL;
 }
+
+// The page itself, NULL while its slot still waits for the backend
+static GtkWidget *get_page(GtkWidget *window, guint index) {
+  GtkWidget **pages = g_object_get_data(G_OBJECT(window), PAGES);
+  GtkWidget *page = gtk_widget_get_first_child(pages[index]);
+  return page && page_has_revealer(page) ? page : NULL;
+}
+
+/*
+ * Opens the quick settings on monitor with only the named page revealed.
+ *
+ * Returns FALSE if there is no such page or it is not loaded yet
+ */
+gboolean show_quick_settings_page(GdkMonitor *monitor, const gchar *name) {
+  GtkWidget *window = windows ? g_hash_table_lookup(windows, monitor) : NULL;
+  if (NULL == window)
+    return FALSE;
+
+  guint index = 0;
+  while (index < G_N_ELEMENTS(page_names) &&
+         g_strcmp0(page_names[index], name) != 0)
+    index++;
+  if (index == G_N_ELEMENTS(page_names) || !get_page(window, index))
+    return FALSE;
+
+  for (guint i = 0; i < G_N_ELEMENTS(page_names); i++) {
+    GtkWidget *page = get_page(window, i);
+    if (page)
+      page_set_revealed(page, i == index);
+  }
+  if (window != current_open_window)
+    toggle_quick_settings(monitor);
+  else
+    notify_changed();
+  return TRUE;
+}
+
+void hide_quick_settings(void) {
+  if (NULL == current_open_window)
+    return;
+  GtkWidget *window = current_open_window;
+  current_open_window = NULL;
+  gtk_widget_set_visible(window, FALSE);
+}
+
+/*
+ * The monitor the quick settings are open on, or NULL. page is set to the
+ * first revealed page, or NULL.
+ */
+GdkMonitor *get_open_quick_settings(const gchar **page) {
+  GHashTableIter iter;
+  gpointer monitor, window;
+
+  *page = NULL;
+  if (NULL == current_open_window)
+    return NULL;
+
+  g_hash_table_iter_init(&iter, windows);
+  while (g_hash_table_iter_next(&iter, &monitor, &window)) {
+    if (window != current_open_window)
+      continue;
+    for (guint i = 0; i < G_N_ELEMENTS(page_names) && !*page; i++) {
+      GtkWidget *p = get_page(window, i);
+      if (p && page_is_revealed(p))
+        *page = page_names[i];
+    }
+    return monitor;
+  }
+  return NULL;
+}
+
+// func is called whenever the quick settings open, close or switch pages
+void connect_quick_settings_changed(QuickSettingsChangedFunc func,
+                                    gpointer user_data) {
+  if (!listeners)
+    listeners = g_array_new(FALSE, FALSE, sizeof(ChangedListener));
+  ChangedListener listener = {.func = func, .user_data = user_data};
+  g_array_append_val(listeners, listener);
+}
@@ -1,11 +1,17 @@
 #ifndef QUICKSETTING
 #define QUICKSETTING
 
-#include "wp/core.h"
 #include <gdk/gdk.h>
 
-void start_quick_settings(GdkDisplay *display, GdkMonitor *monitor,
-                          WpObjectManager *om, WpCore *core);
+void start_quick_settings(GdkDisplay *display, GdkMonitor *monitor);
+void stop_quick_settings(GdkMonitor *monitor);
 void toggle_quick_settings(GdkMonitor *monitor);
+gboolean show_quick_settings_page(GdkMonitor *monitor, const gchar *name);
+void hide_quick_settings(void);
+GdkMonitor *get_open_quick_settings(const gchar **page);
+
+typedef void (*QuickSettingsChangedFunc)(gpointer user_data);
+void connect_quick_settings_changed(QuickSettingsChangedFunc func,
+                                    gpointer user_data);
 
 #endif // !QUICKSETTING
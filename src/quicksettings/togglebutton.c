@@ -3,32 +3,26 @@
 #include "glib.h"
 #include "gtk/gtk.h"
 #include "gtk/gtkshortcut.h"
+#include "spawn_broker.h"
 #include "util.h"
+#include <sys/wait.h>
 
 static ToggleButtonProps props = {.icon_on = "preferences-system-notifications",
                                   .icon_off = "notifications-disabled-symbolic",
                                   .cmd = "dunstctl set-paused toggle"};
 
 #define off "off"
+#define PROPS "props"
 
-static void on_toggle_click(GtkWidget *btn, gpointer data) {
-  ToggleButtonProps *tbp = data;
-  const gchar *cmd = tbp->cmd;
-  GError *error = NULL;
-  if (!g_spawn_command_line_async(cmd, &error)) {
-    g_printerr("Failed to call cmd on toggle click: %s\n", error->message);
-    g_error_free(error);
-    return;
-  }
-  gboolean is_off = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(btn), off));
-
+static void set_toggle_state(GtkWidget *btn, gboolean is_off) {
+  ToggleButtonProps *tbp = g_object_get_data(G_OBJECT(btn), PROPS);
   if (is_off) {
-    gtk_widget_remove_css_class(btn, off);
-  } else {
     gtk_widget_add_css_class(btn, off);
+  } else {
+    gtk_widget_remove_css_class(btn, off);
   }
 
-  g_object_set_data(G_OBJECT(btn), off, GINT_TO_POINTER(!is_off));
+  g_object_set_data(G_OBJECT(btn), off, GINT_TO_POINTER(is_off));
 
   GtkWidget *child = gtk_button_get_child(GTK_BUTTON(btn));
   if (child == NULL) {
@@ -40,7 +34,29 @@ static void on_toggle_click(GtkWidget *btn, gpointer data) {
     return;
   }
   gtk_image_set_from_icon_name(GTK_IMAGE(child),
-                               is_off ? tbp->icon_on : tbp->icon_off);
+                               is_off ? tbp->icon_off : tbp->icon_on);
+}
+
+// TRUE if the command ran and exited with 0
+static gboolean spawn_succeeded(GError *error, gint wait_status) {
+  return !error && WIFEXITED(wait_status) && WEXITSTATUS(wait_status) == 0;
+}
+
+// Only flips once the command succeeded, dunstctl fails without dunst
+static void on_toggle_spawned(GError *error, gint wait_status,
+                              const gchar *output, gpointer data) {
+  GtkWidget *btn = data;
+  if (spawn_succeeded(error, wait_status)) {
+    gboolean is_off = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(btn), off));
+    set_toggle_state(btn, !is_off);
+  }
+  g_object_unref(btn);
+}
+
+static void on_toggle_click(GtkWidget *btn, gpointer data) {
+  ToggleButtonProps *tbp = data;
+  spawn_command(tbp->cmd, SPAWN_DEFAULT, on_toggle_spawned,
+                g_object_ref(btn));
 }
 
 GtkWidget *togglebutton(ToggleButtonProps *props, gboolean is_off) {
@@ -50,6 +66,7 @@ GtkWidget *togglebutton(ToggleButtonProps *props, gboolean is_off) {
   if (is_off)
     gtk_widget_add_css_class(btn, off);
   g_object_set_data(G_OBJECT(btn), off, GINT_TO_POINTER(is_off));
+  g_object_set_data(G_OBJECT(btn), PROPS, props);
   gtk_widget_set_cursor(btn, get_pointer_cursor());
 
   g_signal_connect(btn, "clicked", G_CALLBACK(on_toggle_click), props);
@@ -57,43 +74,28 @@ GtkWidget *togglebutton(ToggleButtonProps *props, gboolean is_off) {
   return btn;
 }
 
-gboolean get_notification_state(void) {
-  gchar *stdout_buf = NULL;
-  GError *error = NULL;
-  gboolean paused = FALSE;
-  if (!g_spawn_command_line_sync("dunstctl is-paused", &stdout_buf, NULL, NULL,
-                                 &error)) {
-    g_printerr("Failed to call cmd on toggle click: %s\n", error->message);
-    g_error_free(error);
-  } else {
-    if (stdout_buf) {
-      g_strstrip(stdout_buf);
-      g_message("Notifications: %s", stdout_buf);
-
-      if (g_strcmp0(stdout_buf, "true") == 0)
-        paused = TRUE;
-    }
+static void on_notification_state(GError *error, gint wait_status,
+                                  const gchar *output, gpointer data) {
+  GtkWidget *btn = data;
+  // Keeps the state it starts out with
+  if (spawn_succeeded(error, wait_status)) {
+    g_autofree gchar *state = g_strstrip(g_strdup(output));
+    g_message("Notifications: %s", state);
+    set_toggle_state(btn, g_str_equal(state, "true"));
   }
-  return paused;
+  g_object_unref(btn);
 }
 
+// Starts out on, dunstctl is asked in the background
 GtkWidget *notification_button(void) {
-
-  gboolean is_off = get_notification_state();
-
-  GtkWidget *btn = togglebutton(&props, is_off);
+  GtkWidget *btn = togglebutton(&props, FALSE);
+  spawn_argv((const gchar *const[]){"dunstctl", "is-paused", NULL},
+             SPAWN_CAPTURE_STDOUT, on_notification_state, g_object_ref(btn));
 
   return btn;
 }
 
-static void call_colorpicker(void) {
-  GError *error = NULL;
-  if (!g_spawn_command_line_async("hyprpicker -a", &error)) {
-    g_printerr("Failed to call hyprpicker: %s\n", error->message);
-    g_error_free(error);
-    return;
-  }
-}
+static void call_colorpicker(void) { SPAWN("hyprpicker", "-a"); }
 
 GtkWidget *colorpicker_button(void) {
   GtkWidget *colorpicker =
@@ -4,6 +4,7 @@
 #include "nm-core-types.h"
 #include "nm-dbus-interface.h"
 #include "page.h"
+#include "spawn_broker.h"
 #include "util.h"
 #include <NetworkManager.h>
 #include <glib-object.h>
@@ -89,15 +90,16 @@ static gboolean is_ap_secured(NMAccessPoint *ap) {
   return wpa != 0 || rsn != 0 || (flags & 0x1) == 1;
 }
 
+// Reruns on_aps_changed to update the known aps, once nmcli is done
+static void rescan_after(GError *error, gint wait_status, const gchar *output,
+                         gpointer user_data) {
+  sh("nmcli dev wifi rescan");
+}
+
 static void forget_ap(gchar *ssid) {
-  char cmd[512] = {0};
   g_message("Forgetting: %s", ssid);
-  snprintf(cmd, sizeof(cmd), "nmcli con del id %s", ssid);
-  sh(cmd);
-  // This is to rerun the on_aps_changed to update the known aps.
-  // It might not work, this is weird, might run before the previous cmd is
-  // finished.
-  sh("nmcli dev wifi rescan");
+  spawn_argv((const gchar *const[]){"nmcli", "con", "del", "id", ssid, NULL},
+             SPAWN_DEFAULT, rescan_after, NULL);
 }
 
 static void open_revealer_on_button_click(GtkButton *btn, gpointer user_data) {
@@ -112,12 +114,10 @@ static void password_entered(GtkPasswordEntry *entry, gpointer user_data) {
   g_print("Password entered: %s\n", password);
   g_autofree gchar *ssid = ap_get_ssid(ap);
 
-  char cmd[512] = {0};
-  snprintf(cmd, sizeof(cmd), "nmcli dev wifi connect '%s' password '%s'", ssid,
-           password);
-  sh(cmd);
-  // Same here as in forget ap
-  sh("nmcli dev wifi rescan");
+  // As arguments, quotes in the ssid or password are no problem
+  spawn_argv((const gchar *const[]){"nmcli", "dev", "wifi", "connect", ssid,
+                                    "password", password, NULL},
+             SPAWN_DEFAULT, rescan_after, NULL);
 }
 
 // TODO: Do something about signals for the ap
@@ -321,8 +321,6 @@ GtkWidget *wifi_page(void) {
     return gtk_box_new(GTK_ORIENTATION_VERTICAL,
                        0); // Returns empty box instead of NULL
 
-  cached_connections = g_ptr_array_new_with_free_func(g_object_unref);
-
   PageButton *pb = create_page_button("Wifi", "network-wireless-symbolic");
   WifiData *wd = g_new0(WifiData, 1);
   wd->client = client;
@@ -356,25 +354,30 @@ GtkWidget *wifi_page(void) {
 
   // Connection signals
   // Should happen before all access points
-  g_signal_connect(client, "connection-added", G_CALLBACK(on_connection_added),
-                   NULL);
-  g_signal_connect(client, "connection-removed",
-                   G_CALLBACK(on_connection_removed), NULL);
-  get_all_connections(client);
+  // Shared by the pages of every monitor, so only kept in sync once
+  if (!cached_connections) {
+    cached_connections = g_ptr_array_new_with_free_func(g_object_unref);
+    g_signal_connect(client, "connection-added",
+                     G_CALLBACK(on_connection_added), NULL);
+    g_signal_connect(client, "connection-removed",
+                     G_CALLBACK(on_connection_removed), NULL);
+    get_all_connections(client);
+  }
 
+  // The client and device outlive the window
   // Enabled
-  g_signal_connect(client, "notify::wireless-enabled",
-                   G_CALLBACK(on_wireless_enabled_notify), pb);
+  signal_connect_owned(client, "notify::wireless-enabled",
+                       G_CALLBACK(on_wireless_enabled_notify), pb, pb->box);
   on_wireless_enabled_notify(client, NULL, pb);
 
   // Active access point
-  g_signal_connect(wifi_device, "notify::active-access-point",
-                   G_CALLBACK(on_active_ap_changed), pb);
+  signal_connect_owned(wifi_device, "notify::active-access-point",
+                       G_CALLBACK(on_active_ap_changed), pb, pb->box);
   on_active_ap_changed(wifi_device, NULL, pb);
 
   // All access points
-  g_signal_connect(wifi_device, "notify::access-points",
-                   G_CALLBACK(on_aps_changed), pb);
+  signal_connect_owned(wifi_device, "notify::access-points",
+                       G_CALLBACK(on_aps_changed), pb, pb->box);
   on_aps_changed(wifi_device, NULL, pb);
 
   return pb->box;
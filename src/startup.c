@@ -0,0 +1,322 @@
+#include "startup.h"
+#include "glib-object.h"
+#include "glib.h"
+#include "gtk/gtk.h"
+#include "hyprland.h"
+
+// The timeline is logged when every backend is done, or after this long
+#define TIMELINE_TIMEOUT_SECONDS 10
+
+/*
+ * Shows the bars before the backends are there.
+ *
+ * Every backend connects on its own, and widgets needing one are created in
+ * a slot showing a placeholder until it is ready. A backend that never
+ * answers only leaves its placeholders behind.
+ *
+ * The time from the start of the process to the first paint and to every
+ * backend being ready or failing is logged as the startup timeline.
+ */
+typedef enum {
+  BACKEND_PENDING,
+  BACKEND_READY,
+  BACKEND_FAILED,
+  // Not used in this mode, left out of the timeline
+  BACKEND_SKIPPED,
+} BackendStatus;
+
+typedef struct {
+  BackendStatus status;
+  // us after the start, when ready or failed
+  gint64 time;
+  gchar *reason; // Why it failed
+  // Slots waiting for the backend, each holding a ref
+  GPtrArray *slots;
+  // StartupWaiter, for widgets that are not a slot
+  GPtrArray *waiters;
+} Backend;
+
+typedef struct {
+  GtkWidget *widget; // Holds a ref
+  StartupSlotFunc func;
+} StartupWaiter;
+
+typedef struct {
+  MainContext *ctx;
+  gint64 start_time;
+  gint64 first_paint_time;
+  gboolean timeline_logged;
+  Backend backends[STARTUP_N_BACKENDS];
+  Hyprland *hyprland;
+} Startup;
+
+static Startup startup = {0};
+
+static const gchar *backend_names[STARTUP_N_BACKENDS] = {
+    [STARTUP_BACKEND_DBUS] = "dbus",
+    [STARTUP_BACKEND_BLUEZ] = "bluez",
+    [STARTUP_BACKEND_PIPEWIRE] = "pipewire",
+    [STARTUP_BACKEND_NETWORK] = "networkmanager",
+    [STARTUP_BACKEND_HYPRLAND] = "hyprland",
+    [STARTUP_BACKEND_STATE] = "cwidgets-backend",
+};
+
+static gint64 startup_elapsed(void) {
+  return g_get_monotonic_time() - startup.start_time;
+}
+
+void startup_mark(const gchar *event) {
+  g_message("Startup: %s after %.1f ms", event, startup_elapsed() / 1000.0);
+}
+
+static void startup_log_timeline(void) {
+  g_autoptr(GString) timeline = g_string_new("Startup timeline:");
+  startup.timeline_logged = TRUE;
+
+  if (startup.first_paint_time)
+    g_string_append_printf(timeline, " first paint %.1f ms",
+                           startup.first_paint_time / 1000.0);
+  else
+    g_string_append(timeline, " no paint");
+
+  for (guint i = 0; i < STARTUP_N_BACKENDS; i++) {
+    Backend *b = &startup.backends[i];
+    if (b->status == BACKEND_SKIPPED)
+      continue;
+    if (b->status == BACKEND_PENDING)
+      g_string_append_printf(timeline, ", %s pending", backend_names[i]);
+    else
+      g_string_append_printf(timeline, ", %s %s %.1f ms", backend_names[i],
+                             b->status == BACKEND_READY ? "ready" : "failed",
+                             b->time / 1000.0);
+  }
+  g_message("%s", timeline->str);
+}
+
+// Logs the timeline once nothing is pending anymore
+static void startup_check_done(void) {
+  if (startup.timeline_logged || !startup.first_paint_time)
+    return;
+  for (guint i = 0; i < STARTUP_N_BACKENDS; i++) {
+    if (startup.backends[i].status == BACKEND_PENDING)
+      return;
+  }
+  startup_log_timeline();
+}
+
+// Backends may still come up later, their slots are filled then
+static gboolean on_timeline_timeout(gpointer user_data) {
+  if (!startup.timeline_logged)
+    startup_log_timeline();
+  return G_SOURCE_REMOVE;
+}
+
+static void slot_fill(GtkWidget *slot) {
+  StartupSlotFunc func = g_object_get_data(G_OBJECT(slot), "startup-func");
+  GtkWidget *placeholder = g_object_get_data(G_OBJECT(slot), "placeholder");
+
+  if (placeholder) {
+    gtk_box_remove(GTK_BOX(slot), placeholder);
+    g_object_set_data(G_OBJECT(slot), "placeholder", NULL);
+  }
+  gtk_widget_set_visible(slot, TRUE);
+  func(startup.ctx, slot);
+}
+
+static void startup_waiter_free(gpointer data) {
+  StartupWaiter *waiter = data;
+  g_object_unref(waiter->widget);
+  g_free(waiter);
+}
+
+static void on_hyprland_changed(Hyprland *hyprland, guint changes,
+                                gpointer user_data) {
+  // The first change is the initial sync
+  g_signal_handlers_disconnect_by_func(hyprland, on_hyprland_changed, NULL);
+  g_clear_object(&startup.hyprland);
+  startup_backend_ready(STARTUP_BACKEND_HYPRLAND);
+}
+
+// Times are taken from here on, so call it first
+void startup_init(MainContext *ctx) {
+  startup.ctx = ctx;
+  startup.start_time = g_get_monotonic_time();
+  for (guint i = 0; i < STARTUP_N_BACKENDS; i++) {
+    startup.backends[i].slots = g_ptr_array_new_with_free_func(g_object_unref);
+    startup.backends[i].waiters =
+        g_ptr_array_new_with_free_func(startup_waiter_free);
+  }
+
+  g_timeout_add_seconds(TIMELINE_TIMEOUT_SECONDS, on_timeline_timeout, NULL);
+
+  // Hyprland connects itself, its widgets cope with an empty state
+  startup.hyprland = hyprland_get_default();
+  g_signal_connect(startup.hyprland, "changed",
+                   G_CALLBACK(on_hyprland_changed), NULL);
+}
+
+void startup_backend_ready(StartupBackend backend) {
+  Backend *b = &startup.backends[backend];
+  if (b->status != BACKEND_PENDING)
+    return;
+
+  b->status = BACKEND_READY;
+  b->time = startup_elapsed();
+  g_message("Startup: %s ready after %.1f ms", backend_names[backend],
+            b->time / 1000.0);
+
+  for (guint i = 0; i < b->slots->len; i++) {
+    GtkWidget *slot = g_ptr_array_index(b->slots, i);
+    // Its window is gone already
+    if (gtk_widget_get_root(slot))
+      slot_fill(slot);
+  }
+  g_ptr_array_set_size(b->slots, 0);
+
+  for (guint i = 0; i < b->waiters->len; i++) {
+    StartupWaiter *waiter = g_ptr_array_index(b->waiters, i);
+    if (gtk_widget_get_root(waiter->widget))
+      waiter->func(startup.ctx, waiter->widget);
+  }
+  g_ptr_array_set_size(b->waiters, 0);
+  startup_check_done();
+}
+
+// The placeholders stay, with the reason as tooltip
+void startup_backend_failed(StartupBackend backend, const gchar *reason) {
+  Backend *b = &startup.backends[backend];
+  if (b->status != BACKEND_PENDING)
+    return;
+
+  b->status = BACKEND_FAILED;
+  b->time = startup_elapsed();
+  b->reason = g_strdup(reason);
+  g_warning("Startup: %s failed after %.1f ms: %s", backend_names[backend],
+            b->time / 1000.0, reason);
+
+  for (guint i = 0; i < b->slots->len; i++)
+    gtk_widget_set_tooltip_text(g_ptr_array_index(b->slots, i), reason);
+  g_ptr_array_set_size(b->slots, 0);
+  g_ptr_array_set_size(b->waiters, 0);
+  startup_check_done();
+}
+
+// For a backend that is not connected at all, call it before any slot is
+void startup_backend_skip(StartupBackend backend) {
+  Backend *b = &startup.backends[backend];
+  if (b->status != BACKEND_PENDING)
+    return;
+
+  b->status = BACKEND_SKIPPED;
+  g_ptr_array_set_size(b->slots, 0);
+  g_ptr_array_set_size(b->waiters, 0);
+  startup_check_done();
+}
+
+gboolean startup_backend_is_ready(StartupBackend backend) {
+  return startup.backends[backend].status == BACKEND_READY;
+}
+
+/*
+ * Returns a box that func fills once backend is ready, right away if it
+ * already is. Until then it shows placeholder_icon, or nothing if NULL.
+ */
+GtkWidget *startup_slot_new(StartupBackend backend, StartupSlotFunc func,
+                            const gchar *placeholder_icon) {
+  Backend *b = &startup.backends[backend];
+  GtkWidget *slot = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+  gtk_widget_add_css_class(slot, "slot");
+  g_object_set_data(G_OBJECT(slot), "startup-func", func);
+
+  if (b->status == BACKEND_READY) {
+    func(startup.ctx, slot);
+    return slot;
+  }
+
+  if (placeholder_icon) {
+    GtkWidget *placeholder = gtk_image_new_from_icon_name(placeholder_icon);
+    gtk_widget_add_css_class(placeholder, "placeholder");
+    gtk_box_append(GTK_BOX(slot), placeholder);
+    g_object_set_data(G_OBJECT(slot), "placeholder", placeholder);
+  } else {
+    // Would still take up spacing in its box
+    gtk_widget_set_visible(slot, FALSE);
+  }
+
+  if (b->status == BACKEND_PENDING)
+    g_ptr_array_add(b->slots, g_object_ref(slot));
+  else
+    gtk_widget_set_tooltip_text(slot, b->reason);
+  return slot;
+}
+
+/*
+ * Calls func with widget once backend is ready, right away if it already is.
+ * For widgets that show their own placeholder, nothing happens if the
+ * backend fails.
+ */
+void startup_when_ready(StartupBackend backend, StartupSlotFunc func,
+                        GtkWidget *widget) {
+  Backend *b = &startup.backends[backend];
+
+  if (b->status == BACKEND_READY) {
+    func(startup.ctx, widget);
+  } else if (b->status == BACKEND_PENDING) {
+    StartupWaiter *waiter = g_new0(StartupWaiter, 1);
+    waiter->widget = g_object_ref(widget);
+    waiter->func = func;
+    g_ptr_array_add(b->waiters, waiter);
+  }
+}
+
+/*
+ * Replaces the placeholder of a slot still waiting for its backend, e.g. with
+ * the last known values. A slot that is filled or failed is left alone.
+ */
+void startup_slot_set_placeholder(GtkWidget *slot, GtkWidget *placeholder) {
+  GtkWidget *old = g_object_get_data(G_OBJECT(slot), "placeholder");
+  gboolean pending = FALSE;
+
+  for (guint i = 0; i < STARTUP_N_BACKENDS && !pending; i++)
+    pending = g_ptr_array_find(startup.backends[i].slots, slot, NULL);
+
+  if (!pending) {
+    g_object_ref_sink(placeholder);
+    g_object_unref(placeholder);
+    return;
+  }
+
+  if (old)
+    gtk_box_remove(GTK_BOX(slot), old);
+  gtk_box_append(GTK_BOX(slot), placeholder);
+  g_object_set_data(G_OBJECT(slot), "placeholder", placeholder);
+  gtk_widget_set_visible(slot, TRUE);
+}
+
+static void on_after_paint(GdkFrameClock *frame_clock, gpointer user_data) {
+  g_signal_handlers_disconnect_by_func(frame_clock, on_after_paint, user_data);
+  if (startup.first_paint_time)
+    return;
+
+  startup.first_paint_time = startup_elapsed();
+  startup_mark("first paint");
+  startup_check_done();
+}
+
+static void on_window_map(GtkWidget *window, gpointer user_data) {
+  g_signal_handlers_disconnect_by_func(window, on_window_map, user_data);
+  GdkFrameClock *frame_clock = gtk_widget_get_frame_clock(window);
+  if (frame_clock)
+    g_signal_connect(frame_clock, "after-paint", G_CALLBACK(on_after_paint),
+                     NULL);
+}
+
+// Marks the first paint of any watched window in the timeline
+void startup_watch_first_paint(GtkWidget *window) {
+  if (startup.first_paint_time)
+    return;
+  if (gtk_widget_get_mapped(window))
+    on_window_map(window, NULL);
+  else
+    g_signal_connect(window, "map", G_CALLBACK(on_window_map), NULL);
+}
@@ -0,0 +1,34 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include "main.h"
+#include <gtk/gtk.h>
+
+typedef enum {
+  STARTUP_BACKEND_DBUS,
+  STARTUP_BACKEND_BLUEZ,
+  STARTUP_BACKEND_PIPEWIRE,
+  STARTUP_BACKEND_NETWORK,
+  STARTUP_BACKEND_HYPRLAND,
+  // cwidgets-backend, only in split mode
+  STARTUP_BACKEND_STATE,
+  STARTUP_N_BACKENDS,
+} StartupBackend;
+
+// Fills slot with the widgets of a backend once it is ready
+typedef void (*StartupSlotFunc)(MainContext *ctx, GtkWidget *slot);
+
+void startup_init(MainContext *ctx);
+void startup_mark(const gchar *event);
+void startup_backend_ready(StartupBackend backend);
+void startup_backend_failed(StartupBackend backend, const gchar *reason);
+void startup_backend_skip(StartupBackend backend);
+gboolean startup_backend_is_ready(StartupBackend backend);
+GtkWidget *startup_slot_new(StartupBackend backend, StartupSlotFunc func,
+                            const gchar *placeholder_icon);
+void startup_slot_set_placeholder(GtkWidget *slot, GtkWidget *placeholder);
+void startup_when_ready(StartupBackend backend, StartupSlotFunc func,
+                        GtkWidget *widget);
+void startup_watch_first_paint(GtkWidget *window);
+
+#endif // !STARTUP_H
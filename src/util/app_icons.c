@@ -0,0 +1,253 @@
+#include "app_icons.h"
+#include <gio/gdesktopappinfo.h>
+#include <gio/gio.h>
+#include <glib-object.h>
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <string.h>
+
+#define FALLBACK_ICON "application-x-executable"
+// Size the icons are looked up at, GtkImage scales them to its icon size
+#define APP_ICON_SIZE 32
+
+enum {
+  SIGNAL_READY,
+  N_SIGNALS,
+};
+
+/*
+ * Resolves window classes to application icons.
+ *
+ * The installed .desktop files are read once on a worker thread into an
+ * index of lowercase names -> icon, and the icon theme resolves every icon
+ * there as well, so the images only get paintables. Every class is looked
+ * up once, later lookups are served from a per class cache, so a window
+ * opening never scans directories or the icon theme on the main thread.
+ * Classes without an application get the icon named after them if the theme
+ * has one, resolved once, and the generic icon otherwise.
+ *
+ * A new icon theme builds the index again.
+ */
+struct _AppIcons {
+  GObject parent_instance;
+  GtkIconTheme *theme;
+  // Of the build in progress, a new theme cancels it
+  GCancellable *cancellable;
+  // NULL until the worker is done
+  GHashTable *index; // lowercase name -> GdkPaintable
+  GHashTable *cache; // class -> GdkPaintable
+  GdkPaintable *fallback;
+};
+
+static guint signals[N_SIGNALS] = {0};
+
+G_DEFINE_TYPE(AppIcons, app_icons, G_TYPE_OBJECT)
+
+static void app_icons_dispose(GObject *object) {
+  AppIcons *self = APP_ICONS_ICONS(object);
+
+  g_clear_pointer(&self->index, g_hash_table_unref);
+  g_clear_pointer(&self->cache, g_hash_table_unref);
+  g_clear_object(&self->fallback);
+  if (self->cancellable) {
+    g_cancellable_cancel(self->cancellable);
+    g_clear_object(&self->cancellable);
+  }
+  if (self->theme) {
+    g_signal_handlers_disconnect_by_data(self->theme, self);
+    g_clear_object(&self->theme);
+  }
+
+  G_OBJECT_CLASS(app_icons_parent_class)->dispose(object);
+}
+
+static void app_icons_class_init(AppIconsClass *klass) {
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  object_class->dispose = app_icons_dispose;
+
+  // Emitted once the index is built, earlier lookups got the fallback icon
+  signals[SIGNAL_READY] =
+      g_signal_new("ready", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0,
+                   NULL, NULL, NULL, G_TYPE_NONE, 0);
+}
+
+static GdkPaintable *resolve(GtkIconTheme *theme, GIcon *icon) {
+  return GDK_PAINTABLE(gtk_icon_theme_lookup_by_gicon(
+      theme, icon, APP_ICON_SIZE, 1, GTK_TEXT_DIR_NONE, 0));
+}
+
+typedef struct {
+  GtkIconTheme *theme;
+  GHashTable *index;
+  // GIcon -> GdkPaintable, applications often share an icon
+  GHashTable *resolved;
+} IndexBuilder;
+
+static void index_add(IndexBuilder *builder, const gchar *name, GIcon *icon) {
+  if (!name || !*name)
+    return;
+
+  gchar *key = g_ascii_strdown(name, -1);
+  if (g_hash_table_contains(builder->index, key)) {
+    g_free(key);
+    return;
+  }
+
+  GdkPaintable *paintable = g_hash_table_lookup(builder->resolved, icon);
+  if (!paintable) {
+    paintable = resolve(builder->theme, icon);
+    g_hash_table_insert(builder->resolved, g_object_ref(icon), paintable);
+  }
+  g_hash_table_insert(builder->index, key, g_object_ref(paintable));
+}
+
+/*
+ * Indexes every application by StartupWMClass, desktop id and executable.
+ * Names from earlier passes win, a StartupWMClass is the most reliable match
+ * for a window class.
+ */
+static void build_index(GTask *task, gpointer source_object, gpointer task_data,
+                        GCancellable *cancellable) {
+  IndexBuilder builder = {
+      .theme = task_data,
+      .index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                     g_object_unref),
+      .resolved = g_hash_table_new_full(g_icon_hash, g_icon_equal,
+                                        g_object_unref, g_object_unref),
+  };
+  GList *apps = g_app_info_get_all();
+
+  for (GList *l = apps; l; l = l->next) {
+    GIcon *icon = g_app_info_get_icon(l->data);
+    if (icon)
+      index_add(&builder, g_desktop_app_info_get_startup_wm_class(l->data),
+                icon);
+  }
+
+  for (GList *l = apps; l; l = l->next) {
+    GIcon *icon = g_app_info_get_icon(l->data);
+    const gchar *id = g_app_info_get_id(l->data);
+    if (!icon || !id)
+      continue;
+
+    g_autofree gchar *name = g_strdup(id);
+    if (g_str_has_suffix(name, ".desktop"))
+      name[strlen(name) - strlen(".desktop")] = '\0';
+    index_add(&builder, name, icon);
+    // org.gnome.Nautilus also matches the class nautilus
+    const gchar *last = strrchr(name, '.');
+    if (last)
+      index_add(&builder, last + 1, icon);
+  }
+
+  for (GList *l = apps; l; l = l->next) {
+    GIcon *icon = g_app_info_get_icon(l->data);
+    const gchar *executable = g_app_info_get_executable(l->data);
+    if (!icon || !executable)
+      continue;
+
+    g_autofree gchar *name = g_path_get_basename(executable);
+    index_add(&builder, name, icon);
+  }
+
+  g_list_free_full(apps, g_object_unref);
+  g_hash_table_unref(builder.resolved);
+  g_task_return_pointer(task, builder.index,
+                        (GDestroyNotify)g_hash_table_unref);
+}
+
+static void on_index_built(GObject *source_object, GAsyncResult *result,
+                           gpointer user_data) {
+  AppIcons *self = APP_ICONS_ICONS(source_object);
+
+  // Cancelled by a new theme, whose build replaces this one
+  GHashTable *index = g_task_propagate_pointer(G_TASK(result), NULL);
+  if (!index)
+    return;
+
+  g_clear_object(&self->cancellable);
+  self->index = index;
+  // Lookups before the index was ready all got fallbacks
+  g_hash_table_remove_all(self->cache);
+  g_signal_emit(self, signals[SIGNAL_READY], 0);
+}
+
+static void app_icons_build_index(AppIcons *self) {
+  if (self->cancellable) {
+    g_cancellable_cancel(self->cancellable);
+    g_object_unref(self->cancellable);
+  }
+  self->cancellable = g_cancellable_new();
+
+  GTask *task = g_task_new(self, self->cancellable, on_index_built, NULL);
+  g_task_set_name(task, "app-icons-index");
+  g_task_set_task_data(task, g_object_ref(self->theme), g_object_unref);
+  g_task_run_in_thread(task, build_index);
+  g_object_unref(task);
+}
+
+static void on_theme_changed(GtkIconTheme *theme, gpointer user_data) {
+  AppIcons *self = user_data;
+
+  g_clear_pointer(&self->index, g_hash_table_unref);
+  g_hash_table_remove_all(self->cache);
+  g_clear_object(&self->fallback);
+  app_icons_build_index(self);
+}
+
+static void app_icons_init(AppIcons *self) {
+  self->cache =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+
+  self->theme =
+      g_object_ref(gtk_icon_theme_get_for_display(gdk_display_get_default()));
+  g_signal_connect(self->theme, "changed", G_CALLBACK(on_theme_changed), self);
+  app_icons_build_index(self);
+}
+
+static AppIcons *app_icons = NULL;
+
+// Client should unref
+AppIcons *app_icons_get_default(void) {
+  if (NULL != app_icons) {
+    return g_object_ref(app_icons);
+  }
+
+  app_icons = (AppIcons *)g_object_new(APP_ICONS_TYPE, NULL);
+
+  return g_object_ref(app_icons);
+}
+
+static GdkPaintable *get_fallback(AppIcons *self) {
+  if (!self->fallback)
+    self->fallback = GDK_PAINTABLE(
+        gtk_icon_theme_lookup_icon(self->theme, FALLBACK_ICON, NULL,
+                                   APP_ICON_SIZE, 1, GTK_TEXT_DIR_NONE, 0));
+  return self->fallback;
+}
+
+/*
+ * The icon of the application with the window class.
+ * Unknown classes get the icon named after the class, falling back to a
+ * generic application icon.
+ *
+ * Owned by the cache
+ */
+GdkPaintable *app_icons_lookup(AppIcons *self, const gchar *class) {
+  GdkPaintable *icon = g_hash_table_lookup(self->cache, class);
+  if (icon)
+    return icon;
+
+  g_autofree gchar *key = g_ascii_strdown(class, -1);
+  icon = self->index ? g_hash_table_lookup(self->index, key) : NULL;
+  if (icon)
+    icon = g_object_ref(icon);
+  else if (self->index && *key && gtk_icon_theme_has_icon(self->theme, key))
+    icon = GDK_PAINTABLE(gtk_icon_theme_lookup_icon(
+        self->theme, key, NULL, APP_ICON_SIZE, 1, GTK_TEXT_DIR_NONE, 0));
+  else
+    icon = g_object_ref(get_fallback(self));
+
+  g_hash_table_insert(self->cache, g_strdup(class), icon);
+  return icon;
+}
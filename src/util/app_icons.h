@@ -0,0 +1,19 @@
+#ifndef APP_ICONS_H
+#define APP_ICONS_H
+
+#include <gdk/gdk.h>
+#include <glib-object.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define APP_ICONS_TYPE app_icons_get_type()
+G_DECLARE_FINAL_TYPE(AppIcons, app_icons, APP_ICONS /*Module*/,
+                     ICONS /*Object name*/, GObject)
+
+AppIcons *app_icons_get_default(void);
+GdkPaintable *app_icons_lookup(AppIcons *self, const gchar *class);
+
+G_END_DECLS
+
+#endif // !APP_ICONS_H
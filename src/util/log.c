@@ -0,0 +1,393 @@
+#include "log.h"
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <glib/gstdio.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Messages waiting for the writer, a power of two
+#define RING_SIZE 1024
+// Longer messages are copied to the heap
+#define MESSAGE_MAX 256
+#define DOMAIN_MAX 32
+// The writer wakes up this often, or right away for warnings
+#define WRITE_INTERVAL_MS 1000
+// Rotated to <file>.1 beyond this, CWIDGETS_LOG_MAX_KB, 0 never rotates
+#define DEFAULT_MAX_KB 4096
+
+/*
+ * One logger for the whole process, glib messages included.
+ *
+ * Logging a message formats it into a slot of a lock-free ring buffer,
+ * there is no syscall and no lock, so the main loop can log on hot paths.
+ * A writer thread drains the ring every second, or right away for
+ * warnings and once it is half full, and writes the lines with one write.
+ * If the ring is full, messages are dropped and counted instead of waiting.
+ * Messages that do not fit into a slot, like the metrics dump, are the only
+ * ones that allocate.
+ *
+ * The writer leaves out repeats of the same message and writes how often it
+ * was repeated instead, and rotates the file once it gets too big.
+ *
+ * The ring is the bounded MPMC queue by Dmitry Vyukov: every slot has a
+ * sequence number telling whether it is free for the producer at that
+ * position or filled for the consumer.
+ */
+typedef struct {
+  _Atomic guint64 seq;
+  gint64 time; // Wall clock, µs
+  LogLevel level;
+  gchar domain[DOMAIN_MAX]; // Empty for LOG_ calls
+  gchar text[MESSAGE_MAX];
+  // The whole message if it does not fit into text, or NULL
+  gchar *long_text;
+} LogSlot;
+
+typedef struct {
+  LogSlot *slots;
+  _Atomic guint64 tail;
+  // Only advanced by the drain, read by producers to tell how full it is
+  _Atomic guint64 head;
+  _Atomic guint64 dropped;
+  _Atomic gboolean running;
+
+  GThread *writer;
+  GMutex wake_mutex;
+  GCond wake;
+  gboolean wake_pending;
+  gboolean quit;
+
+  // Everything below is only touched while draining
+  GMutex drain_mutex;
+  FILE *file;
+  gchar *path;
+  gsize written;
+  gsize max_size;
+  // The last message written, to leave out repeats
+  LogSlot last;
+  gboolean has_last;
+  guint repeats;
+} Logger;
+
+static Logger logger = {0};
+
+static const gchar *level_names[] = {
+    [LOG_LEVEL_DEBUG] = "DEBUG",
+    [LOG_LEVEL_INFO] = "INFO",
+    [LOG_LEVEL_WARNING] = "WARNING",
+    [LOG_LEVEL_CRITICAL] = "CRITICAL",
+    [LOG_LEVEL_ERROR] = "ERROR",
+};
+
+static void write_line(gint64 time, LogLevel level, const gchar *domain,
+                       const gchar *text) {
+  time_t seconds = time / G_USEC_PER_SEC;
+  struct tm tm;
+  localtime_r(&seconds, &tm);
+
+  int n;
+  if (domain[0])
+    n = fprintf(logger.file, "[%02d:%02d:%02d] [%s] %s: %s\n", tm.tm_hour,
+                tm.tm_min, tm.tm_sec, domain, level_names[level], text);
+  else if (level == LOG_LEVEL_INFO)
+    n = fprintf(logger.file, "[%02d:%02d:%02d] %s\n", tm.tm_hour, tm.tm_min,
+                tm.tm_sec, text);
+  else
+    n = fprintf(logger.file, "[%02d:%02d:%02d] %s: %s\n", tm.tm_hour,
+                tm.tm_min, tm.tm_sec, level_names[level], text);
+  if (n > 0)
+    logger.written += n;
+}
+
+static void write_repeats(void) {
+  if (logger.repeats == 0)
+    return;
+  g_autofree gchar *text = g_strdup_printf("Last message repeated %u times",
+                                           logger.repeats);
+  write_line(logger.last.time, logger.last.level, logger.last.domain, text);
+  logger.repeats = 0;
+}
+
+static const gchar *slot_text(LogSlot *slot) {
+  return slot->long_text ? slot->long_text : slot->text;
+}
+
+// Leaves the slot without long_text
+static void write_slot(LogSlot *slot) {
+  if (logger.has_last && slot->level == logger.last.level &&
+      strcmp(slot->domain, logger.last.domain) == 0 &&
+      strcmp(slot_text(slot), slot_text(&logger.last)) == 0) {
+    logger.repeats++;
+    logger.last.time = slot->time;
+    g_clear_pointer(&slot->long_text, g_free);
+    return;
+  }
+
+  write_repeats();
+  write_line(slot->time, slot->level, slot->domain, slot_text(slot));
+  logger.last.time = slot->time;
+  logger.last.level = slot->level;
+  memcpy(logger.last.domain, slot->domain, sizeof(slot->domain));
+  memcpy(logger.last.text, slot->text, sizeof(slot->text));
+  g_free(logger.last.long_text);
+  logger.last.long_text = g_steal_pointer(&slot->long_text);
+  logger.has_last = TRUE;
+}
+
+static gboolean open_file(void) {
+  logger.file = fopen(logger.path, "a");
+  if (!logger.file)
+    return FALSE;
+  // Written out once per drain
+  setvbuf(logger.file, NULL, _IOFBF, 64 * 1024);
+
+  struct stat st;
+  logger.written = fstat(fileno(logger.file), &st) == 0 ? st.st_size : 0;
+  // For whatever writes to stderr itself, like sanitizer reports
+  dup2(fileno(logger.file), STDERR_FILENO);
+  return TRUE;
+}
+
+static void rotate(void) {
+  if (logger.max_size == 0 || logger.written < logger.max_size)
+    return;
+
+  fclose(logger.file);
+  g_autofree gchar *rotated = g_strconcat(logger.path, ".1", NULL);
+  g_rename(logger.path, rotated);
+  if (!open_file())
+    // Nowhere to write to, the ring just fills up and drops
+    logger.file = NULL;
+}
+
+// Writes out every message logged so far, from any thread
+void flush_logger(void) {
+  g_mutex_lock(&logger.drain_mutex);
+  if (!logger.file || !logger.slots) {
+    g_mutex_unlock(&logger.drain_mutex);
+    return;
+  }
+
+  guint64 head = atomic_load_explicit(&logger.head, memory_order_relaxed);
+  for (;;) {
+    LogSlot *slot = &logger.slots[head & (RING_SIZE - 1)];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != head + 1)
+      break;
+    write_slot(slot);
+    // Free for the producer one lap later
+    atomic_store_explicit(&slot->seq, head + RING_SIZE, memory_order_release);
+    head++;
+    atomic_store_explicit(&logger.head, head, memory_order_relaxed);
+  }
+
+  guint64 dropped = atomic_exchange(&logger.dropped, 0);
+  if (dropped > 0) {
+    g_autofree gchar *text = g_strdup_printf(
+        "%" G_GUINT64_FORMAT " messages dropped, the log buffer was full",
+        dropped);
+    write_repeats();
+    write_line(g_get_real_time(), LOG_LEVEL_WARNING, "", text);
+  }
+
+  fflush(logger.file);
+  rotate();
+  g_mutex_unlock(&logger.drain_mutex);
+}
+
+static void wake_writer(void) {
+  g_mutex_lock(&logger.wake_mutex);
+  logger.wake_pending = TRUE;
+  g_cond_signal(&logger.wake);
+  g_mutex_unlock(&logger.wake_mutex);
+}
+
+static gpointer writer_thread(gpointer user_data) {
+  g_mutex_lock(&logger.wake_mutex);
+  while (!logger.quit) {
+    gint64 end = g_get_monotonic_time() +
+                 WRITE_INTERVAL_MS * G_TIME_SPAN_MILLISECOND;
+    while (!logger.wake_pending && !logger.quit &&
+           g_cond_wait_until(&logger.wake, &logger.wake_mutex, end))
+      ;
+    logger.wake_pending = FALSE;
+    g_mutex_unlock(&logger.wake_mutex);
+
+    flush_logger();
+    g_mutex_lock(&logger.wake_mutex);
+  }
+  g_mutex_unlock(&logger.wake_mutex);
+  return NULL;
+}
+
+// Reserves the slot at the tail, NULL if the ring is full
+static LogSlot *claim_slot(guint64 *position) {
+  guint64 pos = atomic_load_explicit(&logger.tail, memory_order_relaxed);
+  for (;;) {
+    LogSlot *slot = &logger.slots[pos & (RING_SIZE - 1)];
+    guint64 seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    gint64 diff = (gint64)(seq - pos);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&logger.tail, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        *position = pos;
+        return slot;
+      }
+    } else if (diff < 0) {
+      return NULL; // Not drained since the last lap
+    } else {
+      pos = atomic_load_explicit(&logger.tail, memory_order_relaxed);
+    }
+  }
+}
+
+/*
+ * Use the LOG_ macros, which leave out levels below LOG_MIN_LEVEL.
+ * domain is NULL for messages of our own.
+ */
+void log_write(LogLevel level, const gchar *domain, const gchar *format,
+               ...) {
+  va_list args;
+
+  // Before init_logger or after close_logger
+  if (!atomic_load_explicit(&logger.running, memory_order_acquire)) {
+    va_start(args, format);
+    g_vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    return;
+  }
+
+  guint64 pos;
+  LogSlot *slot = claim_slot(&pos);
+  if (!slot) {
+    atomic_fetch_add_explicit(&logger.dropped, 1, memory_order_relaxed);
+    return;
+  }
+
+  slot->time = g_get_real_time();
+  slot->level = level;
+  g_strlcpy(slot->domain, domain ? domain : "", sizeof(slot->domain));
+  va_start(args, format);
+  gint length = g_vsnprintf(slot->text, sizeof(slot->text), format, args);
+  va_end(args);
+  slot->long_text = NULL;
+  if (length >= (gint)sizeof(slot->text)) {
+    va_start(args, format);
+    slot->long_text = g_strdup_vprintf(format, args);
+    va_end(args);
+  }
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+  guint64 head = atomic_load_explicit(&logger.head, memory_order_relaxed);
+  if (level >= LOG_LEVEL_WARNING || pos - head >= RING_SIZE / 2)
+    wake_writer();
+}
+
+static LogLevel level_from_glib(GLogLevelFlags flags) {
+  if (flags & G_LOG_LEVEL_ERROR)
+    return LOG_LEVEL_ERROR;
+  if (flags & G_LOG_LEVEL_CRITICAL)
+    return LOG_LEVEL_CRITICAL;
+  if (flags & G_LOG_LEVEL_WARNING)
+    return LOG_LEVEL_WARNING;
+  if (flags & G_LOG_LEVEL_DEBUG)
+    return LOG_LEVEL_DEBUG;
+  return LOG_LEVEL_INFO;
+}
+
+static GLogWriterOutput glib_log_writer(GLogLevelFlags flags,
+                                        const GLogField *fields,
+                                        gsize n_fields, gpointer user_data) {
+  const gchar *domain = NULL;
+  const gchar *message = "";
+  gssize message_length = -1;
+
+  for (gsize i = 0; i < n_fields; i++) {
+    if (g_str_equal(fields[i].key, "GLIB_DOMAIN")) {
+      domain = fields[i].value;
+    } else if (g_str_equal(fields[i].key, "MESSAGE")) {
+      message = fields[i].value;
+      message_length = fields[i].length;
+    }
+  }
+
+  // Debug messages only with G_MESSAGES_DEBUG, like the default writer
+  if (g_log_writer_default_would_drop(flags, domain))
+    return G_LOG_WRITER_HANDLED;
+
+  LogLevel level = level_from_glib(flags);
+  if (level >= LOG_MIN_LEVEL)
+    log_write(level, domain ? domain : "APP", "%.*s",
+              message_length < 0 ? (int)strlen(message) : (int)message_length,
+              message);
+
+  // Aborts right after
+  if (flags & (G_LOG_FLAG_FATAL | G_LOG_LEVEL_ERROR))
+    flush_logger();
+  return G_LOG_WRITER_HANDLED;
+}
+
+static void glib_printerr(const gchar *string) {
+  gsize length = strlen(string);
+  while (length > 0 && string[length - 1] == '\n')
+    length--;
+  log_write(LOG_LEVEL_WARNING, NULL, "%.*s", (int)length, string);
+}
+
+void init_logger(const char *filename) {
+  logger.path = g_strdup(filename);
+  const gchar *max_kb = g_getenv("CWIDGETS_LOG_MAX_KB");
+  logger.max_size =
+      (max_kb ? g_ascii_strtoull(max_kb, NULL, 10) : DEFAULT_MAX_KB) * 1024;
+  if (!open_file()) {
+    perror("Failed to open log file");
+    exit(EXIT_FAILURE);
+  }
+
+  logger.slots = g_new0(LogSlot, RING_SIZE);
+  for (guint i = 0; i < RING_SIZE; i++)
+    atomic_init(&logger.slots[i].seq, i);
+  atomic_store_explicit(&logger.running, TRUE, memory_order_release);
+  logger.writer = g_thread_new("logger", writer_thread, NULL);
+
+  LOG("%s", "");
+  LOG("========NEW LOGGER========");
+}
+
+// Writes out the rest, later messages go to stderr
+void close_logger(void) {
+  if (!logger.writer)
+    return;
+
+  g_mutex_lock(&logger.wake_mutex);
+  logger.quit = TRUE;
+  g_cond_signal(&logger.wake);
+  g_mutex_unlock(&logger.wake_mutex);
+  g_thread_join(logger.writer);
+  logger.writer = NULL;
+
+  atomic_store_explicit(&logger.running, FALSE, memory_order_release);
+  flush_logger();
+
+  g_mutex_lock(&logger.drain_mutex);
+  if (logger.file) {
+    write_repeats();
+    fclose(logger.file);
+    logger.file = NULL;
+  }
+  g_clear_pointer(&logger.last.long_text, g_free);
+  g_mutex_unlock(&logger.drain_mutex);
+}
+
+// glib messages and g_printerr go to the log too
+void redirect_glib_logs(void) {
+  g_log_set_writer_func(glib_log_writer, NULL, NULL);
+  g_set_printerr_handler(glib_printerr);
+}
@@ -0,0 +1,113 @@
+#include "metrics.h"
+#include <glib-unix.h>
+#include <glib.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/*
+ * Counters cheap enough to always count, and gauges read when dumping.
+ *
+ * Counting is a relaxed atomic add on a global, from any thread. kill -USR1
+ * logs every counter with its increase since the last dump, and every gauge.
+ * GTK free, gauges that need GTK are added with metrics_add_gauge.
+ */
+_Atomic guint64 metrics_counters[METRICS_N_COUNTERS];
+
+static const gchar *counter_names[METRICS_N_COUNTERS] = {
+    [METRICS_HYPRLAND_EVENTS] = "hyprland.events",
+    [METRICS_HYPRLAND_EVENT_BYTES] = "hyprland.event_bytes",
+    [METRICS_HYPRLAND_IPC_REQUESTS] = "hyprland.ipc_requests",
+    [METRICS_HYPRLAND_IPC_BYTES] = "hyprland.ipc_bytes",
+    [METRICS_WORKSPACES_REBUILDS] = "workspaces.rebuilds",
+    [METRICS_WORKSPACES_BUTTONS_CREATED] = "workspaces.buttons_created",
+    [METRICS_BAR_UPDATES_APPLIED] = "bar.updates_applied",
+    [METRICS_AUDIO_SIGNALS] = "audio.signals",
+    [METRICS_NETWORK_SIGNALS] = "network.signals",
+    [METRICS_BATTERY_SIGNALS] = "battery.signals",
+    [METRICS_BLUETOOTH_SIGNALS] = "bluetooth.signals",
+    [METRICS_DBUS_CALLS] = "dbus.calls",
+    [METRICS_SPAWNS] = "util.spawns",
+};
+
+typedef struct {
+  const gchar *name;
+  MetricsGaugeFunc func;
+} Gauge;
+
+typedef struct {
+  GArray *gauges; // Gauge
+  // Counters at the last dump
+  guint64 last[METRICS_N_COUNTERS];
+  gint64 last_time;
+} Metrics;
+
+static Metrics metrics = {0};
+
+static guint64 rss_kb(void) {
+  g_autofree gchar *statm = NULL;
+  if (!g_file_get_contents("/proc/self/statm", &statm, NULL, NULL))
+    return 0;
+  guint64 size, resident;
+  if (sscanf(statm, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT, &size,
+             &resident) != 2)
+    return 0;
+  return resident * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static guint64 open_fds(void) {
+  GDir *dir = g_dir_open("/proc/self/fd", 0, NULL);
+  if (!dir)
+    return 0;
+  guint64 n = 0;
+  while (g_dir_read_name(dir))
+    n++;
+  g_dir_close(dir);
+  // Without the one of the GDir itself
+  return n > 0 ? n - 1 : 0;
+}
+
+void metrics_add_gauge(const gchar *name, MetricsGaugeFunc func) {
+  Gauge gauge = {.name = name, .func = func};
+  g_array_append_val(metrics.gauges, gauge);
+}
+
+// Logs every counter and gauge
+void metrics_dump(void) {
+  gint64 now = g_get_monotonic_time();
+  g_autoptr(GString) dump = g_string_new("Metrics:");
+  g_string_append_printf(dump, " %.1f s since the last dump,",
+                         (now - metrics.last_time) / (double)G_USEC_PER_SEC);
+
+  for (guint i = 0; i < METRICS_N_COUNTERS; i++) {
+    guint64 value =
+        atomic_load_explicit(&metrics_counters[i], memory_order_relaxed);
+    g_string_append_printf(dump,
+                           " %s %" G_GUINT64_FORMAT " (+%" G_GUINT64_FORMAT
+                           "),",
+                           counter_names[i], value, value - metrics.last[i]);
+    metrics.last[i] = value;
+  }
+  for (guint i = 0; i < metrics.gauges->len; i++) {
+    Gauge *gauge = &g_array_index(metrics.gauges, Gauge, i);
+    g_string_append_printf(dump, " %s %" G_GUINT64_FORMAT ",", gauge->name,
+                           gauge->func());
+  }
+  g_string_truncate(dump, dump->len - 1);
+  g_message("%s", dump->str);
+  metrics.last_time = now;
+}
+
+static gboolean on_dump_signal(gpointer user_data) {
+  metrics_dump();
+  return G_SOURCE_CONTINUE;
+}
+
+// Dumps on SIGUSR1, counting works without it
+void metrics_init(void) {
+  metrics.gauges = g_array_new(FALSE, FALSE, sizeof(Gauge));
+  metrics.last_time = g_get_monotonic_time();
+  metrics_add_gauge("rss_kb", rss_kb);
+  metrics_add_gauge("open_fds", open_fds);
+  g_unix_signal_add(SIGUSR1, on_dump_signal, NULL);
+}
@@ -0,0 +1,48 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <glib.h>
+#include <stdatomic.h>
+
+// Named "module.counter" in the dump, see counter_names in metrics.c
+typedef enum {
+  METRICS_HYPRLAND_EVENTS,
+  METRICS_HYPRLAND_EVENT_BYTES,
+  METRICS_HYPRLAND_IPC_REQUESTS,
+  METRICS_HYPRLAND_IPC_BYTES,
+  METRICS_WORKSPACES_REBUILDS,
+  METRICS_WORKSPACES_BUTTONS_CREATED,
+  METRICS_BAR_UPDATES_APPLIED,
+  METRICS_AUDIO_SIGNALS,
+  METRICS_NETWORK_SIGNALS,
+  METRICS_BATTERY_SIGNALS,
+  METRICS_BLUETOOTH_SIGNALS,
+  METRICS_DBUS_CALLS,
+  METRICS_SPAWNS,
+  METRICS_N_COUNTERS,
+} MetricsCounter;
+
+typedef guint64 (*MetricsGaugeFunc)(void);
+
+extern _Atomic guint64 metrics_counters[METRICS_N_COUNTERS];
+
+// Safe from any thread, a relaxed atomic add
+static inline void metrics_add(MetricsCounter counter, guint64 n) {
+  atomic_fetch_add_explicit(&metrics_counters[counter], n,
+                            memory_order_relaxed);
+}
+
+static inline void metrics_inc(MetricsCounter counter) {
+  metrics_add(counter, 1);
+}
+
+static inline guint64 metrics_get(MetricsCounter counter) {
+  return atomic_load_explicit(&metrics_counters[counter],
+                              memory_order_relaxed);
+}
+
+void metrics_init(void);
+void metrics_add_gauge(const gchar *name, MetricsGaugeFunc func);
+void metrics_dump(void);
+
+#endif // !METRICS_H
@@ -0,0 +1,242 @@
+#include "snapshot.h"
+#include "hyprland.h"
+#include "state.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define SNAPSHOT_MAGIC 0x50414e53 // "SNAP"
+#define SNAPSHOT_VERSION 1
+// Changes within this time go to disk in one write
+#define SNAPSHOT_WRITE_DELAY_SECONDS 5
+
+/*
+ * Remembers the last known state across restarts, so the first frame shows
+ * real values instead of placeholders until the backends answer.
+ *
+ * The file is mapped and copied once at startup. Afterwards the widgets
+ * report what they show, and every change within SNAPSHOT_WRITE_DELAY_SECONDS
+ * is written at once, by writing a new file and renaming it over the old one.
+ * Nothing is written if the state ended up where it was.
+ */
+typedef struct {
+  SnapshotChangedFunc func;
+  gpointer user_data;
+} SnapshotListener;
+
+typedef struct {
+  Snapshot current;
+  // What is on disk, to skip writes that would not change it
+  Snapshot written;
+  gchar *path;
+  guint write_id;
+  Hyprland *hyprland;
+  GPtrArray *workspaces;
+  GArray *listeners; // SnapshotListener
+} SnapshotStore;
+
+static SnapshotStore store = {0};
+
+static void snapshot_load(void) {
+  GError *error = NULL;
+  GMappedFile *file = g_mapped_file_new(store.path, FALSE, &error);
+  if (!file) {
+    if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      g_message("Could not read snapshot: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  const Snapshot *s = (const Snapshot *)g_mapped_file_get_contents(file);
+  if (g_mapped_file_get_length(file) == sizeof(Snapshot) &&
+      s->magic == SNAPSHOT_MAGIC && s->version == SNAPSHOT_VERSION &&
+      s->size == sizeof(Snapshot)) {
+    store.current = *s;
+    store.written = *s;
+  } else {
+    g_message("Ignoring snapshot of another version");
+  }
+  g_mapped_file_unref(file);
+
+  // Written by this program, but the strings are used as such
+  Snapshot *c = &store.current;
+  c->wifi_ssid[sizeof(c->wifi_ssid) - 1] = '\0';
+  c->n_workspaces = MIN(c->n_workspaces, SNAPSHOT_MAX_WORKSPACES);
+  for (guint i = 0; i < c->n_workspaces; i++) {
+    SnapshotWorkspace *w = &c->workspaces[i];
+    w->name[sizeof(w->name) - 1] = '\0';
+    w->monitor[sizeof(w->monitor) - 1] = '\0';
+  }
+}
+
+static void snapshot_write(void) {
+  GError *error = NULL;
+
+  if (memcmp(&store.current, &store.written, sizeof(Snapshot)) == 0)
+    return;
+
+  g_autofree gchar *dir = g_path_get_dirname(store.path);
+  g_mkdir_with_parents(dir, 0700);
+  if (!g_file_set_contents_full(store.path, (const gchar *)&store.current,
+                                sizeof(Snapshot),
+                                G_FILE_SET_CONTENTS_CONSISTENT, 0600,
+                                &error)) {
+    g_message("Could not write snapshot: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+  store.written = store.current;
+}
+
+static gboolean on_write_timeout(gpointer user_data) {
+  store.write_id = 0;
+  snapshot_write();
+  return G_SOURCE_REMOVE;
+}
+
+static void snapshot_changed(SnapshotField field) {
+  store.current.known |= field;
+  for (guint i = 0; store.listeners && i < store.listeners->len; i++) {
+    SnapshotListener *l = &g_array_index(store.listeners, SnapshotListener, i);
+    l->func(field, l->user_data);
+  }
+  if (!store.write_id && store.path) {
+    store.write_id = g_timeout_add_seconds(SNAPSHOT_WRITE_DELAY_SECONDS,
+                                           on_write_timeout, NULL);
+    g_source_set_name_by_id(store.write_id, "snapshot-write");
+  }
+}
+
+static void restore_workspaces(HyprlandState *hs) {
+  const Snapshot *s = &store.current;
+  if (!(s->known & SNAPSHOT_WORKSPACES))
+    return;
+
+  for (guint i = 0; i < s->n_workspaces; i++) {
+    const SnapshotWorkspace *w = &s->workspaces[i];
+    hyprland_state_restore_workspace(hs, w->id, w->name, w->monitor,
+                                     w->active,
+                                     w->id == s->active_workspace_id);
+  }
+}
+
+static void on_hyprland_changed(Hyprland *hyprland, guint changes,
+                                gpointer user_data) {
+  if (!(changes & (HYPRLAND_CHANGED_WORKSPACES | HYPRLAND_CHANGED_ACTIVE)))
+    return;
+
+  HyprlandState *hs = hyprland_get_state(hyprland);
+  Snapshot *s = &store.current;
+  hyprland_state_get_workspaces(hs, NULL, store.workspaces);
+
+  s->n_workspaces = MIN(store.workspaces->len, SNAPSHOT_MAX_WORKSPACES);
+  s->active_workspace_id = hs->active_workspace_id;
+  for (guint i = 0; i < s->n_workspaces; i++) {
+    HyprlandWorkspace *w = g_ptr_array_index(store.workspaces, i);
+    HyprlandMonitor *m = hyprland_state_get_monitor(hs, w->monitor->str);
+    SnapshotWorkspace *out = &s->workspaces[i];
+
+    // Zeroed first, so equal states compare equal
+    memset(out, 0, sizeof(*out));
+    out->id = w->id;
+    out->active = m && m->active_workspace_id == w->id;
+    g_strlcpy(out->name, w->name->str, sizeof(out->name));
+    g_strlcpy(out->monitor, w->monitor->str, sizeof(out->monitor));
+  }
+  memset(&s->workspaces[s->n_workspaces], 0,
+         (SNAPSHOT_MAX_WORKSPACES - s->n_workspaces) *
+             sizeof(SnapshotWorkspace));
+  snapshot_changed(SNAPSHOT_WORKSPACES);
+}
+
+/*
+ * Loads the snapshot of the last run and puts its workspaces into the
+ * hyprland state. Call it before creating the widgets.
+ */
+void snapshot_init(void) {
+  store.path = g_build_filename(g_get_user_runtime_dir(), "cwidgets",
+                                "state.bin", NULL);
+  store.current.magic = SNAPSHOT_MAGIC;
+  store.current.version = SNAPSHOT_VERSION;
+  store.current.size = sizeof(Snapshot);
+  snapshot_load();
+
+  store.workspaces = g_ptr_array_new();
+  store.hyprland = hyprland_get_default();
+  restore_workspaces(hyprland_get_state(store.hyprland));
+  g_signal_connect(store.hyprland, "changed", G_CALLBACK(on_hyprland_changed),
+                   NULL);
+}
+
+// The last known values, check known before using one
+const Snapshot *snapshot_get(void) { return &store.current; }
+
+// func is called after every change of the current state
+void snapshot_connect_changed(SnapshotChangedFunc func, gpointer user_data) {
+  if (!store.listeners)
+    store.listeners = g_array_new(FALSE, FALSE, sizeof(SnapshotListener));
+  SnapshotListener listener = {.func = func, .user_data = user_data};
+  g_array_append_val(store.listeners, listener);
+}
+
+void snapshot_disconnect_changed(SnapshotChangedFunc func,
+                                 gpointer user_data) {
+  for (guint i = 0; store.listeners && i < store.listeners->len; i++) {
+    SnapshotListener *l = &g_array_index(store.listeners, SnapshotListener, i);
+    if (l->func == func && l->user_data == user_data) {
+      g_array_remove_index(store.listeners, i);
+      return;
+    }
+  }
+}
+
+// Writes what is still pending, for the exit
+void snapshot_flush(void) {
+  g_clear_handle_id(&store.write_id, g_source_remove);
+  if (store.path)
+    snapshot_write();
+}
+
+void snapshot_set_battery(gint percentage, gboolean charging) {
+  Snapshot *s = &store.current;
+  if ((s->known & SNAPSHOT_BATTERY) && s->battery_percentage == percentage &&
+      s->battery_charging == !!charging)
+    return;
+  s->battery_percentage = percentage;
+  s->battery_charging = !!charging;
+  snapshot_changed(SNAPSHOT_BATTERY);
+}
+
+void snapshot_set_audio(gboolean muted, gint level) {
+  Snapshot *s = &store.current;
+  if ((s->known & SNAPSHOT_AUDIO) && s->audio_muted == !!muted &&
+      s->audio_level == level)
+    return;
+  s->audio_muted = !!muted;
+  s->audio_level = level;
+  snapshot_changed(SNAPSHOT_AUDIO);
+}
+
+// ssid is NULL while disconnected, strength is only kept in steps of 20
+void snapshot_set_wifi(const gchar *ssid, guint8 strength) {
+  Snapshot *s = &store.current;
+  gchar buffer[sizeof(s->wifi_ssid)] = {0};
+  if (ssid)
+    g_strlcpy(buffer, ssid, sizeof(buffer));
+  strength = strength / 20 * 20;
+
+  if ((s->known & SNAPSHOT_WIFI) && s->wifi_strength == strength &&
+      memcmp(s->wifi_ssid, buffer, sizeof(buffer)) == 0)
+    return;
+  memcpy(s->wifi_ssid, buffer, sizeof(buffer));
+  s->wifi_strength = strength;
+  snapshot_changed(SNAPSHOT_WIFI);
+}
+
+void snapshot_set_bluetooth(gboolean connected) {
+  Snapshot *s = &store.current;
+  if ((s->known & SNAPSHOT_BLUETOOTH) && s->bluetooth_connected == !!connected)
+    return;
+  s->bluetooth_connected = !!connected;
+  snapshot_changed(SNAPSHOT_BLUETOOTH);
+}
@@ -0,0 +1,63 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <glib.h>
+
+#define SNAPSHOT_MAX_WORKSPACES 16
+
+// Which parts of the snapshot hold a value
+typedef enum {
+  SNAPSHOT_BATTERY = 1 << 0,
+  SNAPSHOT_AUDIO = 1 << 1,
+  SNAPSHOT_WIFI = 1 << 2,
+  SNAPSHOT_BLUETOOTH = 1 << 3,
+  SNAPSHOT_WORKSPACES = 1 << 4,
+} SnapshotField;
+
+typedef struct {
+  gint32 id;
+  // Shown on its monitor
+  guint8 active;
+  gchar name[31];
+  gchar monitor[32];
+} SnapshotWorkspace;
+
+/*
+ * The last known state, written to disk as is. Only fixed size fields, the
+ * file is only read by the same version.
+ */
+typedef struct {
+  guint32 magic;
+  guint32 version;
+  guint32 size;
+  guint32 known; // SnapshotField
+  gint32 battery_percentage;
+  gint32 audio_level;
+  gint32 active_workspace_id;
+  guint8 battery_charging;
+  guint8 audio_muted;
+  // Empty ssid if disconnected
+  guint8 wifi_strength;
+  guint8 bluetooth_connected;
+  gchar wifi_ssid[33];
+  guint8 n_workspaces;
+  guint8 padding[2];
+  SnapshotWorkspace workspaces[SNAPSHOT_MAX_WORKSPACES];
+} Snapshot;
+
+// fields holds the SnapshotField that changed
+typedef void (*SnapshotChangedFunc)(guint32 fields, gpointer user_data);
+
+void snapshot_init(void);
+const Snapshot *snapshot_get(void);
+void snapshot_flush(void);
+void snapshot_connect_changed(SnapshotChangedFunc func, gpointer user_data);
+void snapshot_disconnect_changed(SnapshotChangedFunc func,
+                                 gpointer user_data);
+
+void snapshot_set_battery(gint percentage, gboolean charging);
+void snapshot_set_audio(gboolean muted, gint level);
+void snapshot_set_wifi(const gchar *ssid, guint8 strength);
+void snapshot_set_bluetooth(gboolean connected);
+
+#endif // !SNAPSHOT_H
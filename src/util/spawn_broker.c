@@ -0,0 +1,469 @@
+#define _GNU_SOURCE
+#include "spawn_broker.h"
+#include "metrics.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <glib-unix.h>
+#include <glib.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Requests and replies, longer command lines are refused
+#define MESSAGE_MAX 4096
+#define OUTPUT_MAX (MESSAGE_MAX - sizeof(SpawnReply))
+
+extern char **environ;
+
+/*
+ * Processes are started by a broker, a copy of this process forked in
+ * spawn_init before GTK, the backends or any thread exist. Forking the bar
+ * itself copies its page tables and, with ASan, its shadow memory, every time
+ * a button runs wpctl or nmcli. The broker stays a few MiB.
+ *
+ * The two talk over a SOCK_SEQPACKET socketpair, one message per request or
+ * reply. A request is the argv, the broker starts it with posix_spawnp, no
+ * shell is involved. Our stderr goes along with it, so the output of the
+ * programs ends up in the log like before. The broker polls a pidfd per
+ * child, reaps it and replies with the wait status and the captured stdout.
+ * Only the parent of a process can collect its exit status, so the pidfds
+ * live in the broker and the main loop only watches the socket.
+ */
+typedef struct {
+  guint32 id;
+  guint32 flags; // SpawnFlags
+  // Followed by the argv, every argument NUL terminated
+} SpawnRequest;
+
+typedef struct {
+  guint32 id;
+  gint32 error; // errno, 0 when it ran
+  gint32 wait_status;
+  // Followed by the captured stdout
+} SpawnReply;
+
+typedef struct {
+  guint32 id;
+  pid_t pid;
+  int pidfd;
+  int out; // -1 when not captured or at EOF
+  gchar output[OUTPUT_MAX];
+  gsize output_length;
+} Child;
+
+typedef struct {
+  SpawnDoneFunc done;
+  gpointer user_data;
+  gchar *command; // For the log
+} PendingSpawn;
+
+typedef struct {
+  int fd; // -1 without a broker
+  pid_t pid;
+  guint32 next_id;
+  GHashTable *pending; // id -> PendingSpawn
+} SpawnBroker;
+
+static SpawnBroker broker = {.fd = -1};
+
+/* The broker */
+
+static void broker_reply(int sock, guint32 id, gint error, gint wait_status,
+                         const gchar *output, gsize output_length) {
+  gchar buf[MESSAGE_MAX];
+  SpawnReply reply = {.id = id, .error = error, .wait_status = wait_status};
+  memcpy(buf, &reply, sizeof(reply));
+  if (output_length > 0)
+    memcpy(buf + sizeof(reply), output, output_length);
+  while (send(sock, buf, sizeof(reply) + output_length, MSG_NOSIGNAL) < 0 &&
+         errno == EINTR)
+    ;
+}
+
+static void read_output(Child *child) {
+  while (child->out >= 0) {
+    gchar discard[512];
+    gsize room = OUTPUT_MAX - child->output_length;
+    gchar *buf = room > 0 ? child->output + child->output_length : discard;
+    ssize_t n = read(child->out, buf, room > 0 ? room : sizeof(discard));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno == EAGAIN)
+      return;
+    if (n <= 0) {
+      close(child->out);
+      child->out = -1;
+      return;
+    }
+    if (room > 0)
+      child->output_length += n;
+  }
+}
+
+static void reap_child(int sock, Child *child) {
+  int status = 0;
+  while (waitpid(child->pid, &status, 0) < 0 && errno == EINTR)
+    ;
+  // Whatever it wrote right before exiting
+  read_output(child);
+  if (child->out >= 0)
+    close(child->out);
+  close(child->pidfd);
+  broker_reply(sock, child->id, 0, status, child->output,
+               child->output_length);
+}
+
+static Child *start_child(int sock, const SpawnRequest *request, char **argv,
+                          int err_fd) {
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  int out[2] = {-1, -1};
+
+  if ((request->flags & SPAWN_CAPTURE_STDOUT) && pipe2(out, O_CLOEXEC) < 0) {
+    broker_reply(sock, request->id, errno, 0, NULL, 0);
+    return NULL;
+  }
+
+  posix_spawn_file_actions_init(&actions);
+  if (out[1] >= 0)
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+  if (err_fd >= 0)
+    posix_spawn_file_actions_adddup2(&actions, err_fd, STDERR_FILENO);
+
+  sigset_t none, all;
+  sigemptyset(&none);
+  sigfillset(&all);
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setsigmask(&attr, &none);
+  posix_spawnattr_setsigdefault(&attr, &all);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+                                      POSIX_SPAWN_SETSIGDEF);
+
+  pid_t pid;
+  int error = posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  if (out[1] >= 0)
+    close(out[1]);
+
+  int pidfd = -1;
+  if (!error) {
+    pidfd = syscall(SYS_pidfd_open, pid, 0);
+    // Before Linux 5.3, it is left a zombie until the broker exits
+    if (pidfd < 0)
+      error = errno;
+  }
+  if (error) {
+    if (out[0] >= 0)
+      close(out[0]);
+    broker_reply(sock, request->id, error, 0, NULL, 0);
+    return NULL;
+  }
+
+  Child *child = g_new0(Child, 1);
+  child->id = request->id;
+  child->pid = pid;
+  child->pidfd = pidfd;
+  child->out = out[0];
+  if (child->out >= 0)
+    fcntl(child->out, F_SETFL, O_NONBLOCK);
+  return child;
+}
+
+// FALSE once the bar is gone
+static gboolean broker_receive(int sock, GPtrArray *children) {
+  gchar buf[MESSAGE_MAX];
+  union {
+    struct cmsghdr align;
+    gchar buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  struct iovec iov = {.iov_base = buf, .iov_len = sizeof(buf)};
+  struct msghdr msg = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = control.buf,
+      .msg_controllen = sizeof(control.buf),
+  };
+
+  ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  if (n < 0)
+    return errno == EINTR || errno == EAGAIN;
+  if (n == 0)
+    return FALSE;
+
+  int err_fd = -1;
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    memcpy(&err_fd, CMSG_DATA(cmsg), sizeof(err_fd));
+
+  SpawnRequest request;
+  if ((gsize)n > sizeof(request) && buf[n - 1] == '\0') {
+    memcpy(&request, buf, sizeof(request));
+    // The arguments are terminated in place
+    GPtrArray *argv = g_ptr_array_new();
+    for (gchar *arg = buf + sizeof(request); arg < buf + n;
+         arg += strlen(arg) + 1)
+      g_ptr_array_add(argv, arg);
+    g_ptr_array_add(argv, NULL);
+
+    Child *child = start_child(sock, &request, (char **)argv->pdata, err_fd);
+    if (child)
+      g_ptr_array_add(children, child);
+    g_ptr_array_free(argv, TRUE);
+  }
+
+  if (err_fd >= 0)
+    close(err_fd);
+  return TRUE;
+}
+
+static void G_GNUC_NORETURN broker_main(int sock) {
+  prctl(PR_SET_NAME, "cwidgets-spawn");
+  // Ctrl-C in the terminal is for the bar, which closes the socket on exit
+  signal(SIGINT, SIG_IGN);
+  GPtrArray *children = g_ptr_array_new_with_free_func(g_free);
+  GArray *fds = g_array_new(FALSE, FALSE, sizeof(struct pollfd));
+
+  for (;;) {
+    g_array_set_size(fds, 0);
+    struct pollfd fd = {.fd = sock, .events = POLLIN};
+    g_array_append_val(fds, fd);
+    for (guint i = 0; i < children->len; i++) {
+      Child *child = children->pdata[i];
+      struct pollfd child_fds[2] = {
+          {.fd = child->pidfd, .events = POLLIN},
+          // Ignored once negative
+          {.fd = child->out, .events = POLLIN},
+      };
+      g_array_append_vals(fds, child_fds, 2);
+    }
+
+    if (poll((struct pollfd *)fds->data, fds->len, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    struct pollfd *polled = (struct pollfd *)fds->data;
+    // Before receiving, which adds children
+    for (guint i = children->len; i-- > 0;) {
+      Child *child = children->pdata[i];
+      if (polled[1 + 2 * i + 1].revents)
+        read_output(child);
+      if (polled[1 + 2 * i].revents) {
+        reap_child(sock, child);
+        g_ptr_array_remove_index(children, i);
+      }
+    }
+
+    if (polled[0].revents & POLLIN) {
+      if (!broker_receive(sock, children))
+        break;
+    } else if (polled[0].revents & (POLLHUP | POLLERR)) {
+      break;
+    }
+  }
+  // Children still running are left to init
+  _exit(0);
+}
+
+/* The bar */
+
+static void pending_spawn_free(gpointer data) {
+  PendingSpawn *pending = data;
+  g_free(pending->command);
+  g_free(pending);
+}
+
+static void spawn_failed(const gchar *command, GError *error,
+                         SpawnDoneFunc done, gpointer user_data) {
+  g_printerr("Failed to call '%s': %s\n", command, error->message);
+  if (done)
+    done(error, 0, "", user_data);
+}
+
+static void spawn_failed_errno(const gchar *command, int errsv,
+                               SpawnDoneFunc done, gpointer user_data) {
+  GError *error = g_error_new_literal(G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                                      g_strerror(errsv));
+  spawn_failed(command, error, done, user_data);
+  g_error_free(error);
+}
+
+static void broker_lost(void) {
+  g_warning("Spawn broker exited, commands can not be run anymore");
+  close(broker.fd);
+  broker.fd = -1;
+  waitpid(broker.pid, NULL, WNOHANG);
+
+  GHashTableIter iter;
+  PendingSpawn *pending;
+  g_hash_table_iter_init(&iter, broker.pending);
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&pending)) {
+    g_hash_table_iter_steal(&iter);
+    spawn_failed_errno(pending->command, EPIPE, pending->done,
+                       pending->user_data);
+    pending_spawn_free(pending);
+  }
+}
+
+static gboolean on_broker_reply(gint fd, GIOCondition condition,
+                                gpointer user_data) {
+  gchar buf[MESSAGE_MAX + 1];
+  for (;;) {
+    ssize_t n = recv(fd, buf, MESSAGE_MAX, MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno == EAGAIN)
+      return G_SOURCE_CONTINUE;
+    if (n <= 0) {
+      broker_lost();
+      return G_SOURCE_REMOVE;
+    }
+    if ((gsize)n < sizeof(SpawnReply))
+      continue;
+
+    SpawnReply reply;
+    memcpy(&reply, buf, sizeof(reply));
+    buf[n] = '\0';
+    PendingSpawn *pending = NULL;
+    if (!g_hash_table_steal_extended(broker.pending,
+                                     GUINT_TO_POINTER(reply.id), NULL,
+                                     (gpointer *)&pending))
+      continue;
+
+    if (reply.error)
+      spawn_failed_errno(pending->command, reply.error, pending->done,
+                         pending->user_data);
+    else if (pending->done)
+      pending->done(NULL, reply.wait_status, buf + sizeof(reply),
+                    pending->user_data);
+    pending_spawn_free(pending);
+  }
+}
+
+static gboolean send_request(const gchar *buf, gsize length) {
+  union {
+    struct cmsghdr align;
+    gchar buf[CMSG_SPACE(sizeof(int))];
+  } control = {0};
+  struct iovec iov = {.iov_base = (gpointer)buf, .iov_len = length};
+  struct msghdr msg = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = control.buf,
+      .msg_controllen = sizeof(control.buf),
+  };
+
+  // Our stderr, the log by now
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  int err_fd = STDERR_FILENO;
+  memcpy(CMSG_DATA(cmsg), &err_fd, sizeof(err_fd));
+
+  ssize_t n;
+  do {
+    n = sendmsg(broker.fd, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  return n >= 0;
+}
+
+/*
+ * Runs argv[0], looked up in PATH, with the arguments as they are. done may
+ * be NULL, otherwise it is called exactly once, from the main loop or right
+ * away if the request could not even be sent.
+ */
+void spawn_argv(const gchar *const *argv, SpawnFlags flags, SpawnDoneFunc done,
+                gpointer user_data) {
+  metrics_inc(METRICS_SPAWNS);
+  g_autofree gchar *command = g_strjoinv(" ", (gchar **)argv);
+
+  gchar buf[MESSAGE_MAX];
+  SpawnRequest request = {.flags = flags};
+  gsize length = sizeof(request);
+  int error = argv[0] ? 0 : EINVAL;
+  for (guint i = 0; !error && argv[i]; i++) {
+    gsize size = strlen(argv[i]) + 1;
+    if (length + size > sizeof(buf)) {
+      error = E2BIG;
+      break;
+    }
+    memcpy(buf + length, argv[i], size);
+    length += size;
+  }
+  if (!error && broker.fd < 0)
+    error = ENOTCONN;
+
+  if (!error) {
+    // 0 is never used
+    if (++broker.next_id == 0)
+      broker.next_id++;
+    request.id = broker.next_id;
+    memcpy(buf, &request, sizeof(request));
+    if (!send_request(buf, length))
+      error = errno;
+  }
+  if (error) {
+    spawn_failed_errno(command, error, done, user_data);
+    return;
+  }
+
+  PendingSpawn *pending = g_new0(PendingSpawn, 1);
+  pending->done = done;
+  pending->user_data = user_data;
+  pending->command = g_steal_pointer(&command);
+  g_hash_table_insert(broker.pending, GUINT_TO_POINTER(request.id), pending);
+}
+
+// Splits command like a shell would, without running one
+void spawn_command(const gchar *command, SpawnFlags flags, SpawnDoneFunc done,
+                   gpointer user_data) {
+  g_auto(GStrv) argv = NULL;
+  GError *error = NULL;
+  if (!g_shell_parse_argv(command, NULL, &argv, &error)) {
+    metrics_inc(METRICS_SPAWNS);
+    spawn_failed(command, error, done, user_data);
+    g_error_free(error);
+    return;
+  }
+  spawn_argv((const gchar *const *)argv, flags, done, user_data);
+}
+
+// Forks the broker, before any thread is started
+void spawn_init(void) {
+  if (broker.fd >= 0)
+    return;
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+    g_warning("Could not start the spawn broker: %s", g_strerror(errno));
+    return;
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    g_warning("Could not start the spawn broker: %s", g_strerror(errno));
+    close(fds[0]);
+    close(fds[1]);
+    return;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    broker_main(fds[1]);
+  }
+
+  close(fds[1]);
+  broker.fd = fds[0];
+  broker.pid = pid;
+  broker.pending = g_hash_table_new_full(NULL, NULL, NULL, pending_spawn_free);
+  guint id = g_unix_fd_add(broker.fd, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                           on_broker_reply, NULL);
+  g_source_set_name_by_id(id, "spawn-broker");
+}
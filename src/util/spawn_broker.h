@@ -0,0 +1,31 @@
+#ifndef SPAWN_BROKER_H
+#define SPAWN_BROKER_H
+
+#include <glib.h>
+
+typedef enum {
+  SPAWN_DEFAULT = 0,
+  // Passes the start of stdout to the done func
+  SPAWN_CAPTURE_STDOUT = 1 << 0,
+} SpawnFlags;
+
+/*
+ * Called once the process exited, with its wait status and the captured
+ * stdout ("" without SPAWN_CAPTURE_STDOUT), or with error set when it could
+ * not be started. Failures are logged either way.
+ */
+typedef void (*SpawnDoneFunc)(GError *error, gint wait_status,
+                              const gchar *output, gpointer user_data);
+
+void spawn_init(void);
+void spawn_argv(const gchar *const *argv, SpawnFlags flags, SpawnDoneFunc done,
+                gpointer user_data);
+void spawn_command(const gchar *command, SpawnFlags flags, SpawnDoneFunc done,
+                   gpointer user_data);
+
+// Runs a program with the given arguments and forgets about it
+#define SPAWN(...)                                                             \
+  spawn_argv((const gchar *const[]){__VA_ARGS__, NULL}, SPAWN_DEFAULT, NULL,   \
+             NULL)
+
+#endif // !SPAWN_BROKER_H
@@ -0,0 +1,160 @@
+#include "state_export.h"
+#include "snapshot.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Publishes the snapshot in /dev/shm, so status scripts and the lock screen
+ * can read battery, volume, wifi and workspaces without asking upower, wpctl
+ * or hyprctl themselves.
+ *
+ * Every change of the snapshot, which the widgets update from their signal
+ * handlers, is copied into the mapping under a seqlock: the sequence is odd
+ * while writing, and readers retry if it was odd or changed while copying.
+ * There is one writer, the main loop, so writing takes no lock.
+ *
+ * There is also one writing process: the file is flock()ed for as long as it
+ * is exported, and a cWidgets or cwidgets-backend that finds it locked does
+ * not export at all. Both bumping the sequence could leave it odd or tear the
+ * state, and the first one to exit would unlink the file of the other.
+ */
+typedef struct {
+  StateExport *shared;
+  gchar *path;
+  gchar *env_path;
+  // Holds the lock until state_export_stop
+  int fd;
+} StateExporter;
+
+static StateExporter exporter = {0};
+
+static void publish(void) {
+  StateExport *e = exporter.shared;
+  guint64 sequence = atomic_load_explicit(&e->sequence, memory_order_relaxed);
+
+  atomic_store_explicit(&e->sequence, sequence + 1, memory_order_relaxed);
+  // The odd sequence is visible before any of the state changes
+  atomic_thread_fence(memory_order_release);
+  e->state = *snapshot_get();
+  e->updated = g_get_real_time();
+  atomic_store_explicit(&e->sequence, sequence + 2, memory_order_release);
+}
+
+static void on_snapshot_changed(guint32 fields, gpointer user_data) {
+  if (exporter.shared)
+    publish();
+}
+
+static gboolean write_env_file(GError **error) {
+  g_autofree gchar *contents =
+      g_strdup_printf("CWIDGETS_STATE_PATH=%s\n"
+                      "CWIDGETS_STATE_VERSION=%d\n"
+                      "CWIDGETS_STATE_SIZE=%zu\n"
+                      "CWIDGETS_PID=%d\n",
+                      exporter.path, STATE_EXPORT_VERSION,
+                      sizeof(StateExport), getpid());
+  return g_file_set_contents_full(exporter.env_path, contents, -1,
+                                  G_FILE_SET_CONTENTS_CONSISTENT, 0600,
+                                  error);
+}
+
+// Where the state of this user is mapped from, caller should free
+gchar *state_export_path(void) {
+  return g_strdup_printf("/dev/shm/cwidgets-%u-state", getuid());
+}
+
+// The file locked by this process, or -1 with errno set
+static int open_locked(void) {
+  while (TRUE) {
+    struct stat fd_st, path_st;
+    int fd = open(exporter.path, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW,
+                  0600);
+    if (fd < 0)
+      return -1;
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0 || fstat(fd, &fd_st) < 0) {
+      int saved_errno = errno;
+      close(fd);
+      errno = saved_errno;
+      return -1;
+    }
+
+    // The last writer unlinks it before letting go of the lock
+    if (stat(exporter.path, &path_st) == 0 && fd_st.st_dev == path_st.st_dev &&
+        fd_st.st_ino == path_st.st_ino)
+      return fd;
+    close(fd);
+  }
+}
+
+/*
+ * Call it after snapshot_init. Returns FALSE if the state is not exported,
+ * like when another process writes it
+ */
+gboolean state_export_init(void) {
+  GError *error = NULL;
+  exporter.path = state_export_path();
+  exporter.env_path = g_build_filename(g_get_user_runtime_dir(), "cwidgets",
+                                       "state.env", NULL);
+
+  int fd = open_locked();
+  if (fd < 0 && errno == EWOULDBLOCK) {
+    g_warning("State export: %s is written by another cWidgets or "
+              "cwidgets-backend, not exporting", exporter.path);
+    return FALSE;
+  }
+  if (fd < 0 || ftruncate(fd, sizeof(StateExport)) < 0) {
+    g_warning("State export: could not create %s: %s", exporter.path,
+              g_strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return FALSE;
+  }
+  void *map = mmap(NULL, sizeof(StateExport), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    g_warning("State export: could not map %s: %s", exporter.path,
+              g_strerror(errno));
+    close(fd);
+    return FALSE;
+  }
+
+  exporter.fd = fd;
+  exporter.shared = map;
+  exporter.shared->magic = STATE_EXPORT_MAGIC;
+  exporter.shared->version = STATE_EXPORT_VERSION;
+  exporter.shared->size = sizeof(StateExport);
+  exporter.shared->pid = getpid();
+  // The file may be left over by a crash in the middle of a write
+  atomic_fetch_and_explicit(&exporter.shared->sequence, ~(guint64)1,
+                            memory_order_relaxed);
+  publish();
+
+  g_autofree gchar *dir = g_path_get_dirname(exporter.env_path);
+  g_mkdir_with_parents(dir, 0700);
+  if (!write_env_file(&error)) {
+    g_warning("State export: could not write %s: %s", exporter.env_path,
+              error->message);
+    g_error_free(error);
+  }
+
+  snapshot_connect_changed(on_snapshot_changed, NULL);
+  return TRUE;
+}
+
+// Removes the mapping and env file, readers keep what they mapped
+void state_export_stop(void) {
+  if (!exporter.shared)
+    return;
+  munmap(exporter.shared, sizeof(StateExport));
+  exporter.shared = NULL;
+  g_unlink(exporter.env_path);
+  g_unlink(exporter.path);
+  // Lets go of the lock after the unlink, so no writer takes the old file
+  close(exporter.fd);
+}
@@ -0,0 +1,62 @@
+#ifndef STATE_EXPORT_H
+#define STATE_EXPORT_H
+
+#include "snapshot.h"
+#include <glib.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define STATE_EXPORT_MAGIC 0x54535743 // "CWST"
+// Bumped with every change to this struct or to Snapshot
+#define STATE_EXPORT_VERSION 1
+// Readers give up on a writer that died halfway
+#define STATE_EXPORT_READ_TRIES 1000
+
+/*
+ * The live state, shared read-only with other processes. The path is in
+ * $XDG_RUNTIME_DIR/cwidgets/state.env as CWIDGETS_STATE_PATH, mmap it and
+ * read it with state_export_read.
+ */
+typedef struct {
+  guint32 magic;
+  guint32 version;
+  guint32 size; // sizeof(StateExport)
+  gint32 pid;   // Of the writer
+  // Odd while the state is being written
+  _Atomic guint64 sequence;
+  gint64 updated; // g_get_real_time of the last change
+  Snapshot state;
+} StateExport;
+
+/*
+ * Copies a consistent state out of the mapping, without a syscall.
+ *
+ * Returns FALSE if it is not written by this version or no consistent copy
+ * could be made
+ */
+static inline gboolean state_export_read(const StateExport *shared,
+                                         Snapshot *out) {
+  if (shared->magic != STATE_EXPORT_MAGIC ||
+      shared->version != STATE_EXPORT_VERSION ||
+      shared->size != sizeof(StateExport))
+    return FALSE;
+
+  for (guint i = 0; i < STATE_EXPORT_READ_TRIES; i++) {
+    guint64 before =
+        atomic_load_explicit(&shared->sequence, memory_order_acquire);
+    if (before & 1)
+      continue;
+    memcpy(out, &shared->state, sizeof(*out));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&shared->sequence, memory_order_relaxed) ==
+        before)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+gchar *state_export_path(void);
+gboolean state_export_init(void);
+void state_export_stop(void);
+
+#endif // !STATE_EXPORT_H
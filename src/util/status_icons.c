@@ -0,0 +1,209 @@
+#include "status_icons.h"
+#include <glib-object.h>
+#include <glib.h>
+#include <gtk/gtk.h>
+
+// Size the icons are looked up at, GtkImage scales them to its icon size
+#define STATUS_ICON_SIZE 24
+
+#define BATTERY_LEVELS 11 // 0, 10, ..., 100
+#define WIFI_OFFLINE 5
+
+static const guint set_sizes[STATUS_ICONS_N_SETS] = {
+    [STATUS_ICONS_BATTERY] = BATTERY_LEVELS * 2,
+    [STATUS_ICONS_WIFI] = WIFI_OFFLINE + 1,
+    [STATUS_ICONS_AUDIO] = 5,
+};
+
+static const gchar *const wifi_names[] = {
+    "network-wireless-signal-none-symbolic",
+    "network-wireless-signal-weak-symbolic",
+    "network-wireless-signal-ok-symbolic",
+    "network-wireless-signal-good-symbolic",
+    "network-wireless-signal-excellent-symbolic",
+    "network-wireless-offline-symbolic",
+};
+
+static const gchar *const audio_names[] = {
+    "audio-volume-muted-symbolic",  "audio-volume-low-symbolic",
+    "audio-volume-medium-symbolic", "audio-volume-high-symbolic",
+    "audio-volume-overamplified-symbolic",
+};
+
+/*
+ * Status icons change with every battery, signal or volume update, but only
+ * ever show a few fixed icons.
+ *
+ * The first use at a scale factor looks up every icon of the set once, later
+ * updates swap in a paintable by index, and an image already showing the
+ * icon is not touched at all. A new icon theme drops the paintables and
+ * reloads every image that shows one, an image moved to another scale
+ * reloads itself.
+ */
+typedef struct {
+  GtkIconTheme *theme;
+  // scale -> GtkIconPaintable *[] per set, NULL until used at that scale
+  GHashTable *scales[STATUS_ICONS_N_SETS];
+  // Images showing a status icon, not holding a ref
+  GHashTable *images;
+} StatusIcons;
+
+static StatusIcons icons = {0};
+
+// What an image shows, to skip setting it again
+typedef struct {
+  StatusIconSet set;
+  guint index;
+  gint scale;
+} ShownIcon;
+
+static gchar *icon_name(StatusIconSet set, guint index) {
+  switch (set) {
+  case STATUS_ICONS_BATTERY:
+    return g_strdup_printf("battery-level-%u%s-symbolic",
+                           index % BATTERY_LEVELS * 10,
+                           index >= BATTERY_LEVELS ? "-charging" : "");
+  case STATUS_ICONS_WIFI:
+    return g_strdup(wifi_names[index]);
+  case STATUS_ICONS_AUDIO:
+    return g_strdup(audio_names[index]);
+  default:
+    g_return_val_if_reached(NULL);
+  }
+}
+
+static void paintables_free(gpointer data) {
+  GtkIconPaintable **paintables = data;
+  for (GtkIconPaintable **p = paintables; *p; p++)
+    g_object_unref(*p);
+  g_free(paintables);
+}
+
+// NULL terminated, resolved all at once
+static GtkIconPaintable **resolve_set(StatusIconSet set, gint scale) {
+  GtkIconPaintable **paintables =
+      g_new0(GtkIconPaintable *, set_sizes[set] + 1);
+
+  for (guint i = 0; i < set_sizes[set]; i++) {
+    g_autofree gchar *name = icon_name(set, i);
+    paintables[i] =
+        gtk_icon_theme_lookup_icon(icons.theme, name, NULL, STATUS_ICON_SIZE,
+                                   scale, GTK_TEXT_DIR_NONE, 0);
+  }
+  return paintables;
+}
+
+static GtkIconPaintable *lookup(StatusIconSet set, guint index, gint scale) {
+  GtkIconPaintable **paintables =
+      g_hash_table_lookup(icons.scales[set], GINT_TO_POINTER(scale));
+  if (!paintables) {
+    paintables = resolve_set(set, scale);
+    g_hash_table_insert(icons.scales[set], GINT_TO_POINTER(scale), paintables);
+  }
+  return paintables[index];
+}
+
+static void show(GtkWidget *image, ShownIcon *shown) {
+  gtk_image_set_from_paintable(
+      GTK_IMAGE(image),
+      GDK_PAINTABLE(lookup(shown->set, shown->index, shown->scale)));
+}
+
+static void on_theme_changed(GtkIconTheme *theme, gpointer user_data) {
+  for (guint i = 0; i < STATUS_ICONS_N_SETS; i++)
+    g_hash_table_remove_all(icons.scales[i]);
+
+  GHashTableIter iter;
+  gpointer image;
+  g_hash_table_iter_init(&iter, icons.images);
+  while (g_hash_table_iter_next(&iter, &image, NULL))
+    show(image, g_object_get_data(image, "status-icon"));
+}
+
+static void on_scale_changed(GtkWidget *image, GParamSpec *pspec,
+                             gpointer user_data) {
+  ShownIcon *shown = g_object_get_data(G_OBJECT(image), "status-icon");
+  shown->scale = gtk_widget_get_scale_factor(image);
+  show(image, shown);
+}
+
+static void on_image_finalized(gpointer data, GObject *image) {
+  g_hash_table_remove(icons.images, image);
+}
+
+static void status_icons_init(GtkWidget *image) {
+  if (icons.theme)
+    return;
+
+  icons.theme = gtk_icon_theme_get_for_display(gtk_widget_get_display(image));
+  g_signal_connect(icons.theme, "changed", G_CALLBACK(on_theme_changed), NULL);
+  for (guint i = 0; i < STATUS_ICONS_N_SETS; i++)
+    icons.scales[i] = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                            NULL, paintables_free);
+  icons.images = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+// Rounds to the nearest of the 11 battery levels
+guint status_icons_battery_index(int percentage, gboolean charging) {
+  int level = (percentage / 10) + (percentage % 10 >= 5 ? 1 : 0);
+  level = CLAMP(level, 0, BATTERY_LEVELS - 1);
+  return level + (charging ? BATTERY_LEVELS : 0);
+}
+
+guint status_icons_wifi_index(gboolean connected, guint8 strength) {
+  if (!connected)
+    return WIFI_OFFLINE;
+  return MIN(strength / 20, 4);
+}
+
+// level in percent
+guint status_icons_audio_index(gboolean muted, gdouble level) {
+  if (muted || level == 0)
+    return 0;
+  if (level < 33)
+    return 1;
+  if (level < 66)
+    return 2;
+  if (level <= 100)
+    return 3;
+  return 4;
+}
+
+/*
+ * Shows icon index of set in image, which should only be set through here
+ * from then on
+ */
+void status_icons_set(GtkWidget *image, StatusIconSet set, guint index) {
+  g_return_if_fail(index < set_sizes[set]);
+  status_icons_init(image);
+
+  ShownIcon *shown = g_object_get_data(G_OBJECT(image), "status-icon");
+  if (!shown) {
+    shown = g_new0(ShownIcon, 1);
+    g_object_set_data_full(G_OBJECT(image), "status-icon", shown, g_free);
+    g_object_weak_ref(G_OBJECT(image), on_image_finalized, NULL);
+    g_hash_table_add(icons.images, image);
+    g_signal_connect(image, "notify::scale-factor",
+                     G_CALLBACK(on_scale_changed), NULL);
+  } else if (shown->set == set && shown->index == index) {
+    return;
+  }
+
+  shown->set = set;
+  shown->index = index;
+  shown->scale = gtk_widget_get_scale_factor(image);
+  show(image, shown);
+}
+
+/*
+ * The icon for drawing it yourself, at the scale of widget. Owned by the
+ * cache and only valid until the icon theme changes, so look it up again for
+ * every frame
+ */
+GdkPaintable *status_icons_lookup(GtkWidget *widget, StatusIconSet set,
+                                  guint index) {
+  g_return_val_if_fail(index < set_sizes[set], NULL);
+  status_icons_init(widget);
+  return GDK_PAINTABLE(
+      lookup(set, index, gtk_widget_get_scale_factor(widget)));
+}
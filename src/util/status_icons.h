@@ -0,0 +1,24 @@
+#ifndef STATUS_ICONS_H
+#define STATUS_ICONS_H
+
+#include <gtk/gtk.h>
+
+typedef enum {
+  // battery-level-0 to battery-level-100, then the same charging
+  STATUS_ICONS_BATTERY,
+  // network-wireless-signal-none to excellent, then offline
+  STATUS_ICONS_WIFI,
+  // audio-volume-muted, low, medium, high, overamplified
+  STATUS_ICONS_AUDIO,
+  STATUS_ICONS_N_SETS,
+} StatusIconSet;
+
+guint status_icons_battery_index(int percentage, gboolean charging);
+guint status_icons_wifi_index(gboolean connected, guint8 strength);
+guint status_icons_audio_index(gboolean muted, gdouble level);
+
+void status_icons_set(GtkWidget *image, StatusIconSet set, guint index);
+GdkPaintable *status_icons_lookup(GtkWidget *widget, StatusIconSet set,
+                                  guint index);
+
+#endif // !STATUS_ICONS_H
@@ -0,0 +1,152 @@
+#include "trace.h"
+#include <glib-unix.h>
+#include <glib.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+// The latest events kept, a power of two
+#define TRACE_CAPACITY (1 << 16)
+#define TRACE_FILE "cWidgets.trace.json"
+
+/*
+ * Records spans and flows into a ring buffer, the oldest are overwritten.
+ * Recording is a fetch_add and a few stores, nothing is formatted until the
+ * buffer is written as Chrome trace event JSON, which ui.perfetto.dev and
+ * chrome://tracing open. That happens on SIGUSR2 and on exit.
+ *
+ * Timestamps are g_get_monotonic_time, the clock of GdkFrameClock too.
+ */
+typedef struct {
+  const gchar *name; // NULL for flows
+  gint64 ts;
+  gint64 dur;
+  guint64 id;
+  guint tid;
+  gchar phase;
+} TraceEvent;
+
+typedef struct {
+  TraceEvent *events;
+  _Atomic guint64 head;
+  _Atomic guint64 next_flow;
+  _Atomic guint next_tid;
+} Trace;
+
+static Trace trace = {0};
+
+static _Thread_local guint thread_id = 0;
+
+static TraceEvent *trace_event_new(gchar phase) {
+  if (G_UNLIKELY(!trace.events))
+    return NULL;
+  if (G_UNLIKELY(!thread_id))
+    thread_id = atomic_fetch_add(&trace.next_tid, 1) + 1;
+
+  guint64 index = atomic_fetch_add(&trace.head, 1);
+  TraceEvent *event = &trace.events[index & (TRACE_CAPACITY - 1)];
+  event->phase = phase;
+  event->tid = thread_id;
+  return event;
+}
+
+TraceSpan trace_span_begin(const gchar *name) {
+  return (TraceSpan){.name = name, .start = g_get_monotonic_time()};
+}
+
+void trace_span_end(TraceSpan *span) {
+  trace_complete(span->name, span->start, g_get_monotonic_time());
+}
+
+void trace_complete(const gchar *name, gint64 start, gint64 end) {
+  TraceEvent *event = trace_event_new('X');
+  if (!event)
+    return;
+  event->name = name;
+  event->ts = start;
+  event->dur = end - start;
+}
+
+void trace_flow(gchar phase, guint64 id) {
+  TraceEvent *event = trace_event_new(phase);
+  if (!event)
+    return;
+  event->name = NULL;
+  event->ts = g_get_monotonic_time();
+  event->id = id;
+}
+
+// Starts a flow in the current span
+guint64 trace_flow_new(void) {
+  guint64 id = atomic_fetch_add(&trace.next_flow, 1) + 1;
+  trace_flow('s', id);
+  return id;
+}
+
+static void append_json_string(GString *out, const gchar *s) {
+  g_string_append_c(out, '"');
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      g_string_append_c(out, '\\');
+    if ((guchar)*s >= 0x20)
+      g_string_append_c(out, *s);
+  }
+  g_string_append_c(out, '"');
+}
+
+// Writes the buffered events to TRACE_FILE
+void trace_write(void) {
+  if (!trace.events)
+    return;
+
+  guint64 head = atomic_load(&trace.head);
+  guint64 first = head > TRACE_CAPACITY ? head - TRACE_CAPACITY : 0;
+  pid_t pid = getpid();
+  g_autoptr(GString) out = g_string_new("{\"traceEvents\":[\n");
+
+  for (guint64 i = first; i < head; i++) {
+    TraceEvent *event = &trace.events[i & (TRACE_CAPACITY - 1)];
+    if (i > first)
+      g_string_append(out, ",\n");
+
+    g_string_append_printf(out,
+                           "{\"ph\":\"%c\",\"pid\":%d,\"tid\":%u,"
+                           "\"ts\":%" G_GINT64_FORMAT ",\"name\":",
+                           event->phase, pid, event->tid, event->ts);
+    if (event->phase == 'X') {
+      append_json_string(out, event->name);
+      g_string_append_printf(out, ",\"dur\":%" G_GINT64_FORMAT "}",
+                             event->dur);
+    } else {
+      // Flows bind to the span they are in
+      g_string_append_printf(out,
+                             "\"update\",\"cat\":\"flow\",\"bp\":\"e\","
+                             "\"id\":%" G_GUINT64_FORMAT "}",
+                             event->id);
+    }
+  }
+  g_string_append(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  GError *error = NULL;
+  if (!g_file_set_contents(TRACE_FILE, out->str, out->len, &error)) {
+    g_warning("Could not write trace: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+  g_message("Trace: wrote %" G_GUINT64_FORMAT " events to %s", head - first,
+            TRACE_FILE);
+}
+
+static gboolean on_write_signal(gpointer user_data) {
+  trace_write();
+  return G_SOURCE_CONTINUE;
+}
+
+// Starts recording, until then every event is dropped
+void trace_init(void) {
+  if (trace.events)
+    return;
+  trace.events = g_new0(TraceEvent, TRACE_CAPACITY);
+  g_unix_signal_add(SIGUSR2, on_write_signal, NULL);
+  g_message("Trace: recording, kill -USR2 %d writes %s", getpid(), TRACE_FILE);
+}
@@ -0,0 +1,54 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <glib.h>
+
+/*
+ * Tracing spans, only built with meson setup -Dtracing=true. Without it
+ * every macro compiles to nothing, arguments included.
+ *
+ * TRACE_SPAN(name) traces the rest of the enclosing block. Names are kept
+ * as pointers, so they have to be literals or g_intern_string.
+ * Flows connect the spans of one update across callbacks: TRACE_FLOW_NEW
+ * takes an id in a span, TRACE_FLOW_STEP and TRACE_FLOW_END continue it in
+ * later ones.
+ */
+#ifdef CWIDGETS_TRACE
+
+typedef struct {
+  const gchar *name;
+  gint64 start;
+} TraceSpan;
+
+void trace_init(void);
+void trace_write(void);
+TraceSpan trace_span_begin(const gchar *name);
+void trace_span_end(TraceSpan *span);
+void trace_complete(const gchar *name, gint64 start, gint64 end);
+guint64 trace_flow_new(void);
+void trace_flow(gchar phase, guint64 id);
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(TraceSpan, trace_span_end)
+
+#define TRACE_INIT() trace_init()
+#define TRACE_WRITE() trace_write()
+#define TRACE_SPAN(name)                                                       \
+  g_auto(TraceSpan) G_PASTE(trace_span_, __LINE__) = trace_span_begin(name)
+#define TRACE_COMPLETE(name, start, end) trace_complete(name, start, end)
+#define TRACE_FLOW_NEW(id) (id) = trace_flow_new()
+#define TRACE_FLOW_STEP(id) trace_flow('t', id)
+#define TRACE_FLOW_END(id) trace_flow('f', id)
+
+#else
+
+#define TRACE_INIT()
+#define TRACE_WRITE()
+#define TRACE_SPAN(name)
+#define TRACE_COMPLETE(name, start, end)
+#define TRACE_FLOW_NEW(id)
+#define TRACE_FLOW_STEP(id)
+#define TRACE_FLOW_END(id)
+
+#endif // CWIDGETS_TRACE
+
+#endif // !TRACE_H
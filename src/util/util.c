@@ -1,4 +1,6 @@
 #include "util.h"
+#include "snapshot.h"
+#include "spawn_broker.h"
 #include <gdk/gdk.h>
 #include <gtk/gtk.h>
 #include <stdio.h>
@@ -66,13 +68,8 @@ void remove_children_start(GtkWidget *box, guint start) {
   }
 }
 
-void sh(const gchar *cmd) {
-  GError *error = NULL;
-  if (!g_spawn_command_line_async(cmd, &error)) {
-    g_printerr("Failed to call '%s': %s\n", cmd, error->message);
-    g_error_free(error);
-  }
-}
+// Runs a fixed command line, arguments built at runtime go through SPAWN
+void sh(const gchar *cmd) { spawn_command(cmd, SPAWN_DEFAULT, NULL, NULL); }
 
 gchar *truncate_string(gchar *ssid, gulong max_len) {
   gulong length = g_utf8_strlen(ssid, -1);
@@ -91,3 +88,36 @@ gchar *truncate_string(gchar *ssid, gulong max_len) {
 
   return g_strdup(ssid);
 }
+
+/*
+ * Like g_signal_connect, but the handler is disconnected when owner is
+ * disposed. For handlers on backends that outlive the widget they update,
+ * like when the bar of an unplugged monitor is destroyed.
+ */
+gulong signal_connect_owned(gpointer instance, const gchar *signal,
+                            GCallback handler, gpointer data, gpointer owner) {
+  GClosure *closure = g_cclosure_new(handler, data, NULL);
+  g_object_watch_closure(G_OBJECT(owner), closure);
+  return g_signal_connect_closure(instance, signal, closure, FALSE);
+}
+
+typedef struct {
+  SnapshotChangedFunc func;
+  gpointer data;
+} OwnedListener;
+
+static void on_listener_owner_disposed(gpointer user_data, GObject *owner) {
+  OwnedListener *listener = user_data;
+  snapshot_disconnect_changed(listener->func, listener->data);
+  g_free(listener);
+}
+
+// Like signal_connect_owned, for changes of the snapshot
+void snapshot_connect_owned(SnapshotChangedFunc func, gpointer data,
+                            gpointer owner) {
+  OwnedListener *listener = g_new(OwnedListener, 1);
+  listener->func = func;
+  listener->data = data;
+  snapshot_connect_changed(func, data);
+  g_object_weak_ref(G_OBJECT(owner), on_listener_owner_disposed, listener);
+}
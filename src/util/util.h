@@ -1,6 +1,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include "snapshot.h"
 #include <gdk/gdk.h>
 #include <gtk/gtk.h>
 
@@ -17,6 +18,11 @@ void remove_children_start(GtkWidget *box, guint start);
 
 void sh(const gchar *cmd);
 
+gulong signal_connect_owned(gpointer instance, const gchar *signal,
+                            GCallback handler, gpointer data, gpointer owner);
+void snapshot_connect_owned(SnapshotChangedFunc func, gpointer data,
+                            gpointer owner);
+
 gchar *truncate_string(gchar *ssid, gulong max_len);
 
 #endif /* !UTIL_H */
@@ -0,0 +1,218 @@
+#include "watchdog.h"
+#include <glib.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+
+// Stalls are summed up and reset this often
+#define REPORT_INTERVAL_SECONDS 60
+#define DEFAULT_THRESHOLD_MS 8
+// Iterations taking < 1 ms, < 2 ms, < 4 ms, ..., and the rest
+#define N_BUCKETS 10
+
+/*
+ * Finds what blocks the main loop, disabled with CWIDGETS_WATCHDOG_MS=0.
+ *
+ * The poll function of the default main context is wrapped, so everything
+ * between two polls is one iteration: the dispatch of the sources that were
+ * ready, plus their prepare and check. Iteration times go into a histogram.
+ *
+ * A thread waits while the main loop polls. Once an iteration runs longer
+ * than the threshold (CWIDGETS_WATCHDOG_MS, 8 by default), it interrupts the
+ * main thread with a signal whose handler takes the source being dispatched.
+ * At the end of the iteration the stall is logged with the name of that
+ * source, and summed up by source for the report. Give sources telling names
+ * with g_source_set_name, unnamed ones are all "unnamed source".
+ *
+ * An idle main loop costs the thread a wakeup per iteration, a busy one at
+ * most one per threshold.
+ */
+typedef struct {
+  gint64 threshold; // In µs
+  pthread_t main_thread;
+  GPollFunc poll;
+
+  // Written by the main thread, 0 while it polls
+  _Atomic gint64 busy_since;
+  _Atomic guint iteration;
+  // Taken by the signal handler with a ref, NULL if there was none
+  _Atomic(GSource *) culprit;
+
+  // Wakes the thread once the main loop stops polling
+  GMutex mutex;
+  GCond cond;
+  _Atomic gboolean parked;
+
+  // Only touched by the main thread
+  guint64 histogram[N_BUCKETS];
+  // Source name -> Stall
+  GHashTable *stalls;
+} Watchdog;
+
+typedef struct {
+  guint count;
+  gint64 total; // In µs
+  gint64 max;
+} Stall;
+
+static Watchdog watchdog = {0};
+
+static void on_sample(int signum) {
+  if (!atomic_load(&watchdog.busy_since))
+    return;
+  // Only reads the dispatch state of this thread, set up in watchdog_start
+  GSource *source = g_main_current_source();
+  GSource *expected = NULL;
+  if (source &&
+      atomic_compare_exchange_strong(&watchdog.culprit, &expected, source))
+    g_source_ref(source);
+}
+
+static guint bucket(gint64 duration) {
+  guint b = 0;
+  for (gint64 ms = duration / 1000; ms > 0 && b < N_BUCKETS - 1; ms >>= 1)
+    b++;
+  return b;
+}
+
+static void record_stall(gint64 duration, GSource *culprit) {
+  const gchar *name = "unknown";
+  if (culprit)
+    name = g_source_get_name(culprit) ? g_source_get_name(culprit)
+                                      : "unnamed source";
+  g_message("Watchdog: main loop stalled for %.1f ms in %s",
+            duration / 1000.0, name);
+
+  Stall *stall = g_hash_table_lookup(watchdog.stalls, name);
+  if (!stall) {
+    stall = g_new0(Stall, 1);
+    g_hash_table_insert(watchdog.stalls, g_strdup(name), stall);
+  }
+  stall->count++;
+  stall->total += duration;
+  stall->max = MAX(stall->max, duration);
+}
+
+static void iteration_done(void) {
+  gint64 since = atomic_exchange(&watchdog.busy_since, 0);
+  GSource *culprit = atomic_exchange(&watchdog.culprit, NULL);
+  if (since) {
+    gint64 duration = g_get_monotonic_time() - since;
+    watchdog.histogram[bucket(duration)]++;
+    if (duration >= watchdog.threshold)
+      record_stall(duration, culprit);
+  }
+  if (culprit)
+    g_source_unref(culprit);
+}
+
+static gint watchdog_poll(GPollFD *fds, guint nfds, gint timeout) {
+  iteration_done();
+  gint ret = watchdog.poll(fds, nfds, timeout);
+
+  atomic_fetch_add(&watchdog.iteration, 1);
+  atomic_store(&watchdog.busy_since, g_get_monotonic_time());
+  if (atomic_load(&watchdog.parked)) {
+    g_mutex_lock(&watchdog.mutex);
+    g_cond_signal(&watchdog.cond);
+    g_mutex_unlock(&watchdog.mutex);
+  }
+  return ret;
+}
+
+static gpointer watchdog_thread(gpointer user_data) {
+  guint sampled = 0;
+
+  for (;;) {
+    g_mutex_lock(&watchdog.mutex);
+    while (!atomic_load(&watchdog.busy_since)) {
+      atomic_store(&watchdog.parked, TRUE);
+      g_cond_wait(&watchdog.cond, &watchdog.mutex);
+    }
+    atomic_store(&watchdog.parked, FALSE);
+    g_mutex_unlock(&watchdog.mutex);
+
+    guint iteration = atomic_load(&watchdog.iteration);
+    gint64 since = atomic_load(&watchdog.busy_since);
+    gint64 remaining = since + watchdog.threshold - g_get_monotonic_time();
+    if (remaining > 0)
+      g_usleep(remaining);
+
+    if (atomic_load(&watchdog.iteration) != iteration ||
+        !atomic_load(&watchdog.busy_since))
+      continue;
+    // Once per stall, then only checks back every threshold
+    if (sampled != iteration) {
+      sampled = iteration;
+      pthread_kill(watchdog.main_thread, SIGRTMIN);
+    }
+    g_usleep(watchdog.threshold);
+  }
+  return NULL;
+}
+
+static void report(void) {
+  g_autoptr(GString) report = g_string_new("Watchdog: iterations");
+  for (guint i = 0; i < N_BUCKETS; i++) {
+    if (i < N_BUCKETS - 1)
+      g_string_append_printf(report, " <%ums", 1u << i);
+    else
+      g_string_append_printf(report, " >=%ums", 1u << (i - 1));
+    g_string_append_printf(report, " %" G_GUINT64_FORMAT,
+                           watchdog.histogram[i]);
+  }
+  g_string_append(report, ", stalls:");
+
+  GHashTableIter iter;
+  gpointer name, value;
+  g_hash_table_iter_init(&iter, watchdog.stalls);
+  while (g_hash_table_iter_next(&iter, &name, &value)) {
+    Stall *stall = value;
+    g_string_append_printf(report, " %s %u times %.1f ms max %.1f ms,",
+                           (const gchar *)name, stall->count,
+                           stall->total / 1000.0, stall->max / 1000.0);
+  }
+  g_string_truncate(report, report->len - 1);
+  g_message("%s", report->str);
+}
+
+// Quiet without stalls
+static gboolean on_report(gpointer user_data) {
+  if (g_hash_table_size(watchdog.stalls) > 0)
+    report();
+  memset(watchdog.histogram, 0, sizeof(watchdog.histogram));
+  g_hash_table_remove_all(watchdog.stalls);
+  return G_SOURCE_CONTINUE;
+}
+
+// Call from the thread running the default main context
+void watchdog_start(void) {
+  const gchar *env = g_getenv("CWIDGETS_WATCHDOG_MS");
+  guint64 threshold_ms = env ? g_ascii_strtoull(env, NULL, 10)
+                             : DEFAULT_THRESHOLD_MS;
+  if (threshold_ms == 0 || watchdog.poll)
+    return;
+
+  watchdog.threshold = threshold_ms * 1000;
+  watchdog.main_thread = pthread_self();
+  watchdog.stalls =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  // Sets up the dispatch state the signal handler reads
+  g_main_current_source();
+
+  struct sigaction action = {0};
+  action.sa_handler = on_sample;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGRTMIN, &action, NULL);
+
+  GMainContext *context = g_main_context_default();
+  watchdog.poll = g_main_context_get_poll_func(context);
+  g_main_context_set_poll_func(context, watchdog_poll);
+
+  g_thread_unref(g_thread_new("watchdog", watchdog_thread, NULL));
+  g_timeout_add_seconds(REPORT_INTERVAL_SECONDS, on_report, NULL);
+  g_message("Watchdog: logging main loop stalls over %" G_GUINT64_FORMAT " ms",
+            threshold_ms);
+}
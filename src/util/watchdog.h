@@ -0,0 +1,8 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <glib.h>
+
+void watchdog_start(void);
+
+#endif // !WATCHDOG_H
@@ -0,0 +1,147 @@
+#include "control_protocol.h"
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Controls a running cWidgets over its control socket
+ *
+ *   cwidgetsctl toggle [MONITOR]
+ *   cwidgetsctl page audio|wifi|bluetooth [MONITOR]
+ *   cwidgetsctl hide
+ *   cwidgetsctl state
+ *   cwidgetsctl subscribe
+ *
+ * MONITOR is a connector like DP-1, hyprland's focused monitor by default.
+ * subscribe prints the state as one JSON line per change until cWidgets
+ * exits.
+ */
+
+#define READ_CHUNK 4096
+
+static const struct {
+  const gchar *name;
+  ControlType type;
+  guint min_args;
+  guint max_args;
+} commands[] = {
+    {"toggle", CONTROL_TOGGLE, 0, 1},
+    {"page", CONTROL_SHOW_PAGE, 1, 2},
+    {"hide", CONTROL_HIDE, 0, 0},
+    {"state", CONTROL_GET_STATE, 0, 0},
+    {"subscribe", CONTROL_SUBSCRIBE, 0, 0},
+};
+
+static int usage(void) {
+  fprintf(stderr, "Usage: cwidgetsctl toggle [MONITOR]\n"
+                  "       cwidgetsctl page audio|wifi|bluetooth [MONITOR]\n"
+                  "       cwidgetsctl hide\n"
+                  "       cwidgetsctl state\n"
+                  "       cwidgetsctl subscribe\n");
+  return 2;
+}
+
+static GSocket *connect_control(GError **error) {
+  g_autofree gchar *path = control_socket_path();
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new(path);
+  g_autoptr(GSocket) socket =
+      g_socket_new(G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM,
+                   G_SOCKET_PROTOCOL_DEFAULT, error);
+  if (!socket || !g_socket_connect(socket, address, NULL, error))
+    return NULL;
+  return g_steal_pointer(&socket);
+}
+
+static gboolean send_all(GSocket *socket, GByteArray *data, GError **error) {
+  gsize sent = 0;
+  while (sent < data->len) {
+    gssize n = g_socket_send(socket, (gchar *)data->data + sent,
+                             data->len - sent, NULL, error);
+    if (n < 0)
+      return FALSE;
+    sent += n;
+  }
+  return TRUE;
+}
+
+// Prints the replies, returns the exit code
+static int read_replies(GSocket *socket, gboolean subscribe) {
+  g_autoptr(GByteArray) buffer = g_byte_array_new();
+  GError *error = NULL;
+
+  while (TRUE) {
+    guint old_len = buffer->len;
+    g_byte_array_set_size(buffer, old_len + READ_CHUNK);
+    gssize len = g_socket_receive(socket, (gchar *)buffer->data + old_len,
+                                  READ_CHUNK, NULL, &error);
+    g_byte_array_set_size(buffer, old_len + MAX(len, 0));
+    if (len < 0) {
+      fprintf(stderr, "cwidgetsctl: %s\n", error->message);
+      g_error_free(error);
+      return 1;
+    }
+    if (len == 0) {
+      fprintf(stderr, "cwidgetsctl: cWidgets closed the connection\n");
+      return 1;
+    }
+
+    gssize n;
+    guint8 type;
+    g_auto(GStrv) args = NULL;
+    while ((n = control_frame_parse(buffer->data, buffer->len, &type,
+                                    &args)) > 0) {
+      g_byte_array_remove_range(buffer, 0, n);
+      const gchar *payload = args[0];
+
+      if (type == CONTROL_ERROR) {
+        fprintf(stderr, "cwidgetsctl: %s\n", payload ? payload : "Failed");
+        return 1;
+      }
+      if (payload) {
+        printf("%s\n", payload);
+        fflush(stdout);
+      }
+      g_clear_pointer(&args, g_strfreev);
+      if (!subscribe)
+        return 0;
+    }
+    if (n < 0) {
+      fprintf(stderr, "cwidgetsctl: invalid reply\n");
+      return 1;
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2)
+    return usage();
+
+  guint i = 0;
+  while (i < G_N_ELEMENTS(commands) && g_strcmp0(commands[i].name, argv[1]))
+    i++;
+  guint n_args = argc - 2;
+  if (i == G_N_ELEMENTS(commands) || n_args < commands[i].min_args ||
+      n_args > commands[i].max_args)
+    return usage();
+
+  GError *error = NULL;
+  g_autoptr(GSocket) socket = connect_control(&error);
+  if (!socket) {
+    fprintf(stderr, "cwidgetsctl: is cWidgets running? %s\n", error->message);
+    g_error_free(error);
+    return 1;
+  }
+
+  g_autoptr(GByteArray) request = g_byte_array_new();
+  control_frame_append(request, commands[i].type,
+                       (const gchar *const *)argv + 2);
+  if (!send_all(socket, request, &error)) {
+    fprintf(stderr, "cwidgetsctl: %s\n", error->message);
+    g_error_free(error);
+    return 1;
+  }
+
+  return read_replies(socket, commands[i].type == CONTROL_SUBSCRIBE);
+}
@@ -0,0 +1,268 @@
+#define _GNU_SOURCE // RUSAGE_THREAD
+#include "hyprland.h"
+#include "metrics.h"
+#include "mock.h"
+#include "recording.h"
+#include "state.h"
+#include "workspaces.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+/*
+ * Replays hyprland traffic from a mock server on another thread through the
+ * hyprland service and the workspaces widget, and reports the cpu time of
+ * the main thread, the event-to-model latency from an event being sent until
+ * the main loop iteration that handled it is done, and the allocations on the
+ * main thread.
+ *
+ * The widget is not in a window, so it applies changes right away instead of
+ * on the next frame, and the latency does not include waiting for the frame
+ * clock. Without a display the widget is left out and only the model is
+ * measured.
+ */
+
+// Allocations are counted by wrapping malloc, which the sanitizers already do
+#if defined(__SANITIZE_ADDRESS__)
+#define COUNT_ALLOCATIONS 0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define COUNT_ALLOCATIONS 0
+#endif
+#endif
+#if !defined(COUNT_ALLOCATIONS) && defined(__GLIBC__)
+#define COUNT_ALLOCATIONS 1
+#endif
+#ifndef COUNT_ALLOCATIONS
+#define COUNT_ALLOCATIONS 0
+#endif
+
+#define SYNTHETIC_CYCLES 100
+#define SYNC_TIMEOUT_SECONDS 5
+#define DRAIN_TIMEOUT_SECONDS 10
+
+static __thread gboolean count_allocations = FALSE;
+static guint64 n_allocations = 0;
+
+#if COUNT_ALLOCATIONS
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+  if (count_allocations)
+    n_allocations++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+  if (count_allocations)
+    n_allocations++;
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  if (count_allocations)
+    n_allocations++;
+  return __libc_realloc(ptr, size);
+}
+#endif
+
+static gchar *recording_path = NULL;
+static gint rate = 10000;
+static gint n_events = 50000;
+static gboolean no_ui = FALSE;
+static gint max_p99_us = 0;
+
+static GOptionEntry entries[] = {
+    {"recording", 'r', 0, G_OPTION_ARG_FILENAME, &recording_path,
+     "Recording made by hyprland-record, generated traffic if not set",
+     "FILE"},
+    {"rate", 0, 0, G_OPTION_ARG_INT, &rate,
+     "Events per second, 0 keeps the recorded timing", "N"},
+    {"events", 'n', 0, G_OPTION_ARG_INT, &n_events,
+     "Number of events to replay", "N"},
+    {"no-ui", 0, 0, G_OPTION_ARG_NONE, &no_ui,
+     "Only measure the model, without the workspaces widget", NULL},
+    {"max-p99", 0, 0, G_OPTION_ARG_INT, &max_p99_us,
+     "Fail if the 99th percentile latency is above this many microseconds",
+     "US"},
+    {NULL},
+};
+
+static gpointer mock_thread(gpointer user_data) {
+  GMainLoop *loop = user_data;
+  GMainContext *context = g_main_loop_get_context(loop);
+
+  g_main_context_push_thread_default(context);
+  g_main_loop_run(loop);
+  g_main_context_pop_thread_default(context);
+  return NULL;
+}
+
+// Wakes the main loop up, so a stalled replay can time out
+static gboolean on_heartbeat(gpointer user_data) { return G_SOURCE_CONTINUE; }
+
+static gint compare_gint64(gconstpointer a_p, gconstpointer b_p) {
+  gint64 a = *(const gint64 *)a_p;
+  gint64 b = *(const gint64 *)b_p;
+  return (a > b) - (a < b);
+}
+
+static gint64 percentile(gint64 *sorted, guint64 n, guint p) {
+  if (n == 0)
+    return 0;
+  return sorted[MIN(n * p / 100, n - 1)];
+}
+
+static gint64 thread_cpu_time(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return (gint64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+             G_USEC_PER_SEC +
+         usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+int main(int argc, char *argv[]) {
+  GError *error = NULL;
+  g_autoptr(GOptionContext) options =
+      g_option_context_new("- benchmark the hyprland workspaces path");
+  g_option_context_add_main_entries(options, entries, NULL);
+  if (!g_option_context_parse(options, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+  if (n_events <= 0 || rate < 0) {
+    g_printerr("--events has to be positive and --rate not negative\n");
+    return 1;
+  }
+
+  HyprlandRecording *recording =
+      recording_path ? hyprland_recording_load(recording_path, &error)
+                     : hyprland_recording_new_synthetic(SYNTHETIC_CYCLES);
+  if (!recording) {
+    g_printerr("Could not load %s: %s\n", recording_path, error->message);
+    return 1;
+  }
+
+  // Keeps the benchmark away from a running hyprland
+  g_autofree gchar *runtime_dir = g_dir_make_tmp("cwidgets-bench-XXXXXX", NULL);
+  g_setenv("XDG_RUNTIME_DIR", runtime_dir, TRUE);
+  g_setenv("HYPRLAND_INSTANCE_SIGNATURE", "bench", TRUE);
+
+  GMainContext *mock_context = g_main_context_new();
+  HyprlandMock *mock = hyprland_mock_new(recording, mock_context, &error);
+  if (!mock) {
+    g_printerr("Could not start mock: %s\n", error->message);
+    return 1;
+  }
+  GMainLoop *mock_loop = g_main_loop_new(mock_context, FALSE);
+  GThread *thread = g_thread_new("hyprland-mock", mock_thread, mock_loop);
+
+  gboolean ui = !no_ui && gtk_init_check();
+  Hyprland *hyprland = hyprland_get_default();
+  GtkWidget *box = NULL;
+  if (ui) {
+    box = g_object_ref_sink(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0));
+    gtk_box_append(GTK_BOX(box), gtk_label_new("Workspaces"));
+    start_workspaces_widget(box, NULL);
+  }
+  g_timeout_add(100, on_heartbeat, NULL);
+
+  HyprlandState *state = hyprland_get_state(hyprland);
+  gint64 deadline =
+      g_get_monotonic_time() + SYNC_TIMEOUT_SECONDS * G_USEC_PER_SEC;
+  while (g_hash_table_size(state->workspaces) == 0 &&
+         g_get_monotonic_time() < deadline)
+    g_main_context_iteration(NULL, TRUE);
+  if (g_hash_table_size(state->workspaces) == 0) {
+    g_printerr("Hyprland service did not sync with the mock\n");
+    return 1;
+  }
+
+  guint64 n = n_events;
+  gint64 *sent_at = g_new0(gint64, n);
+  gint64 *latencies = g_new0(gint64, n);
+  guint64 done = 0;
+  guint64 base = metrics_get(METRICS_HYPRLAND_EVENTS);
+
+  gint64 replay_time = rate > 0 ? (gint64)n * G_USEC_PER_SEC / rate : 0;
+  if (rate == 0) {
+    guint per_pass = hyprland_recording_get_n_events(recording);
+    const HyprlandRecord *last =
+        hyprland_recording_get_event(recording, per_pass - 1);
+    replay_time = (n / per_pass + 1) * last->time;
+  }
+
+  gint64 cpu_start = thread_cpu_time();
+  gint64 start = g_get_monotonic_time();
+  deadline = start + replay_time + DRAIN_TIMEOUT_SECONDS * G_USEC_PER_SEC;
+  count_allocations = TRUE;
+  hyprland_mock_replay(mock, rate, n, sent_at);
+
+  while (done < n && g_get_monotonic_time() < deadline) {
+    g_main_context_iteration(NULL, TRUE);
+
+    gint64 now = g_get_monotonic_time();
+    guint64 handled = MIN(metrics_get(METRICS_HYPRLAND_EVENTS) - base, n);
+    for (; done < handled; done++)
+      latencies[done] = now - sent_at[done];
+  }
+
+  count_allocations = FALSE;
+  gint64 wall_time = g_get_monotonic_time() - start;
+  gint64 cpu_time = thread_cpu_time() - cpu_start;
+
+  qsort(latencies, done, sizeof(gint64), compare_gint64);
+  gint64 p99 = percentile(latencies, done, 99);
+
+  printf("path:        %s\n", ui ? "hyprland service and workspaces widget"
+                                   : "hyprland service only");
+  printf("events:      %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+         " in %.1f ms\n",
+         done, n, wall_time / 1000.0);
+  printf("cpu:         %.1f ms, %.2f us per event\n", cpu_time / 1000.0,
+         done ? (gdouble)cpu_time / done : 0.0);
+  printf("latency:     event-to-model p50 %" G_GINT64_FORMAT
+         " us, p90 %" G_GINT64_FORMAT
+         " us, p99 %" G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us\n",
+         percentile(latencies, done, 50), percentile(latencies, done, 90), p99,
+         done ? latencies[done - 1] : 0);
+  if (COUNT_ALLOCATIONS)
+    printf("allocations: %" G_GUINT64_FORMAT ", %.2f per event\n",
+           n_allocations, done ? (gdouble)n_allocations / done : 0.0);
+  else
+    printf("allocations: not counted, configure with -Db_sanitize=none\n");
+
+  int status = 0;
+  if (done < n) {
+    g_printerr("Only %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+               " events were handled\n",
+               done, n);
+    status = 1;
+  } else if (max_p99_us > 0 && p99 > max_p99_us) {
+    g_printerr("p99 event-to-model latency %" G_GINT64_FORMAT
+               " us is above %d us\n",
+               p99, max_p99_us);
+    status = 1;
+  }
+
+  g_clear_object(&box);
+  g_object_unref(hyprland);
+  g_main_loop_quit(mock_loop);
+  g_thread_join(thread);
+  hyprland_mock_free(mock);
+  g_main_loop_unref(mock_loop);
+  g_main_context_unref(mock_context);
+  hyprland_recording_free(recording);
+  g_free(sent_at);
+  g_free(latencies);
+
+  g_autofree gchar *hypr_dir = g_build_filename(runtime_dir, "hypr", NULL);
+  g_rmdir(hypr_dir);
+  g_rmdir(runtime_dir);
+  return status;
+}
@@ -0,0 +1,78 @@
+#include "mock.h"
+#include "recording.h"
+#include <glib-unix.h>
+#include <glib.h>
+#include <signal.h>
+#include <stdio.h>
+
+static gchar *recording_path = NULL;
+static gchar *signature = "cwidgets-mock";
+static gint rate = 0;
+static gint cycles = 100;
+static gboolean loop = FALSE;
+
+static GOptionEntry entries[] = {
+    {"recording", 'r', 0, G_OPTION_ARG_FILENAME, &recording_path,
+     "Recording made by hyprland-record, generated traffic if not set",
+     "FILE"},
+    {"signature", 's', 0, G_OPTION_ARG_STRING, &signature,
+     "HYPRLAND_INSTANCE_SIGNATURE to serve", "SIG"},
+    {"rate", 0, 0, G_OPTION_ARG_INT, &rate,
+     "Events per second, 0 keeps the recorded timing", "N"},
+    {"cycles", 0, 0, G_OPTION_ARG_INT, &cycles,
+     "Rounds of generated traffic without a recording", "N"},
+    {"loop", 'l', 0, G_OPTION_ARG_NONE, &loop,
+     "Start over at the end of the recording", NULL},
+    {NULL},
+};
+
+static gboolean on_signal(gpointer user_data) {
+  g_main_loop_quit(user_data);
+  return G_SOURCE_REMOVE;
+}
+
+int main(int argc, char *argv[]) {
+  GError *error = NULL;
+  g_autoptr(GOptionContext) options =
+      g_option_context_new("- serve recorded hyprland traffic");
+  g_option_context_add_main_entries(options, entries, NULL);
+  if (!g_option_context_parse(options, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+
+  HyprlandRecording *recording =
+      recording_path ? hyprland_recording_load(recording_path, &error)
+                     : hyprland_recording_new_synthetic(MAX(cycles, 1));
+  if (!recording) {
+    g_printerr("Could not load %s: %s\n", recording_path, error->message);
+    return 1;
+  }
+
+  g_setenv("HYPRLAND_INSTANCE_SIGNATURE", signature, TRUE);
+  HyprlandMock *mock =
+      hyprland_mock_new(recording, g_main_context_default(), &error);
+  if (!mock) {
+    g_printerr("Could not start mock: %s\n", error->message);
+    hyprland_recording_free(recording);
+    return 1;
+  }
+
+  guint64 n_events =
+      loop ? G_MAXUINT64 : hyprland_recording_get_n_events(recording);
+  hyprland_mock_replay(mock, MAX(rate, 0), n_events, NULL);
+
+  printf("Serving %u events, run cWidgets with\n"
+         "  HYPRLAND_INSTANCE_SIGNATURE=%s\n",
+         hyprland_recording_get_n_events(recording), signature);
+
+  GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
+  g_unix_signal_add(SIGINT, on_signal, main_loop);
+  g_unix_signal_add(SIGTERM, on_signal, main_loop);
+  g_main_loop_run(main_loop);
+
+  g_main_loop_unref(main_loop);
+  hyprland_mock_free(mock);
+  hyprland_recording_free(recording);
+  return 0;
+}
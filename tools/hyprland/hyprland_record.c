@@ -0,0 +1,245 @@
+#include "recording.h"
+#include "socket.h"
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib-unix.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#define READ_CHUNK 8192
+
+/*
+ * Records the traffic between cWidgets and hyprland.
+ *
+ * Serves a second set of sockets under another instance signature and
+ * forwards everything to the real hyprland sockets, writing a copy of each
+ * event, request and reply to the recording. Every connection is handled
+ * with blocking io on its own thread.
+ */
+typedef struct {
+  GOutputStream *out;
+  GMutex lock;
+  gint64 start_time;
+  gboolean failed;
+} Recorder;
+
+static Recorder recorder;
+
+static gchar *output_path = NULL;
+static gchar *signature = NULL;
+
+static GOptionEntry entries[] = {
+    {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_path,
+     "File to write the recording to", "FILE"},
+    {"signature", 's', 0, G_OPTION_ARG_STRING, &signature,
+     "Instance signature of the recording sockets, defaults to the current "
+     "one with -record appended",
+     "SIG"},
+    {NULL},
+};
+
+// Must be called with the lock held
+static void record(HyprlandRecordKind kind, const gchar *data, gsize len) {
+  GError *error = NULL;
+
+  if (recorder.failed)
+    return;
+
+  gint64 time = g_get_monotonic_time() - recorder.start_time;
+  if (!hyprland_recording_write(recorder.out, kind, time, data, len, &error)) {
+    g_warning("Could not write recording: %s", error->message);
+    g_error_free(error);
+    recorder.failed = TRUE;
+  }
+}
+
+static GSocket *connect_upstream(const gchar *name, GError **error) {
+  GSocket *socket = hyprland_socket_connect(name, error);
+  if (socket)
+    g_socket_set_blocking(socket, TRUE);
+  return socket;
+}
+
+static gboolean on_event_client(GThreadedSocketService *service,
+                                GSocketConnection *connection,
+                                GObject *source_object, gpointer user_data) {
+  GError *error = NULL;
+  g_autoptr(GSocket) upstream =
+      connect_upstream(HYPRLAND_EVENT_SOCKET, &error);
+  if (!upstream) {
+    g_warning("%s", error->message);
+    g_error_free(error);
+    return TRUE;
+  }
+
+  GOutputStream *client = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+  g_autoptr(GByteArray) pending = g_byte_array_new();
+  gchar buffer[READ_CHUNK];
+  gssize len;
+
+  while ((len = g_socket_receive(upstream, buffer, sizeof(buffer), NULL,
+                                 NULL)) > 0) {
+    if (!g_output_stream_write_all(client, buffer, len, NULL, NULL, NULL))
+      break; // cWidgets went away
+
+    g_byte_array_append(pending, (const guint8 *)buffer, len);
+    gchar *data = (gchar *)pending->data;
+    gsize consumed = 0;
+    gchar *end;
+
+    g_mutex_lock(&recorder.lock);
+    while ((end = memchr(data + consumed, '\n', pending->len - consumed))) {
+      record(HYPRLAND_RECORD_EVENT, data + consumed, end - data - consumed);
+      consumed = end - data + 1;
+    }
+    g_mutex_unlock(&recorder.lock);
+
+    g_byte_array_remove_range(pending, 0, consumed);
+  }
+
+  g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+  return TRUE;
+}
+
+static gboolean on_request_client(GThreadedSocketService *service,
+                                  GSocketConnection *connection,
+                                  GObject *source_object, gpointer user_data) {
+  GError *error = NULL;
+  GInputStream *in = g_io_stream_get_input_stream(G_IO_STREAM(connection));
+  GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+  gchar request[READ_CHUNK];
+
+  // Hyprland reads the request with a single read as well
+  gssize len = g_input_stream_read(in, request, sizeof(request), NULL, NULL);
+  if (len <= 0)
+    return TRUE;
+
+  g_autoptr(GSocket) upstream =
+      connect_upstream(HYPRLAND_REQUEST_SOCKET, &error);
+  if (!upstream) {
+    g_warning("%s", error->message);
+    g_error_free(error);
+    return TRUE;
+  }
+
+  g_autoptr(GByteArray) reply = g_byte_array_new();
+  gchar buffer[READ_CHUNK];
+  gssize n;
+
+  g_socket_send(upstream, request, len, NULL, NULL);
+  while ((n = g_socket_receive(upstream, buffer, sizeof(buffer), NULL, NULL)) >
+         0)
+    g_byte_array_append(reply, (const guint8 *)buffer, n);
+
+  g_output_stream_write_all(out, reply->data, reply->len, NULL, NULL, NULL);
+  g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+
+  g_mutex_lock(&recorder.lock);
+  record(HYPRLAND_RECORD_REQUEST, request, len);
+  record(HYPRLAND_RECORD_REPLY, (const gchar *)reply->data, reply->len);
+  g_mutex_unlock(&recorder.lock);
+  return TRUE;
+}
+
+static GSocketService *listen_on(const gchar *dir, const gchar *name,
+                                 GCallback on_client, GError **error) {
+  g_autofree gchar *path = g_build_filename(dir, name, NULL);
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new(path);
+  g_unlink(path);
+
+  GSocketService *service = g_threaded_socket_service_new(-1);
+  if (!g_socket_listener_add_address(G_SOCKET_LISTENER(service), address,
+                                     G_SOCKET_TYPE_STREAM,
+                                     G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL,
+                                     error)) {
+    g_object_unref(service);
+    return NULL;
+  }
+
+  g_signal_connect(service, "run", on_client, NULL);
+  return service;
+}
+
+static gboolean on_signal(gpointer user_data) {
+  g_main_loop_quit(user_data);
+  return G_SOURCE_REMOVE;
+}
+
+int main(int argc, char *argv[]) {
+  GError *error = NULL;
+  g_autoptr(GOptionContext) options =
+      g_option_context_new("- record hyprland socket traffic");
+  g_option_context_add_main_entries(options, entries, NULL);
+  if (!g_option_context_parse(options, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+
+  const gchar *runtime_dir = g_getenv("XDG_RUNTIME_DIR");
+  const gchar *instance = g_getenv("HYPRLAND_INSTANCE_SIGNATURE");
+  if (!output_path || !runtime_dir || !instance) {
+    g_printerr("Needs --output and a running hyprland\n");
+    return 1;
+  }
+  if (!signature)
+    signature = g_strconcat(instance, "-record", NULL);
+
+  g_autoptr(GFile) file = g_file_new_for_path(output_path);
+  recorder.out = G_OUTPUT_STREAM(g_file_replace(
+      file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error));
+  if (!recorder.out) {
+    g_printerr("Could not open %s: %s\n", output_path, error->message);
+    return 1;
+  }
+  g_output_stream_write_all(recorder.out, HYPRLAND_RECORDING_HEADER,
+                            strlen(HYPRLAND_RECORDING_HEADER), NULL, NULL,
+                            NULL);
+  g_mutex_init(&recorder.lock);
+  recorder.start_time = g_get_monotonic_time();
+
+  g_autofree gchar *dir = g_build_filename(runtime_dir, "hypr", signature, NULL);
+  g_mkdir_with_parents(dir, 0700);
+
+  GSocketService *events = listen_on(dir, HYPRLAND_EVENT_SOCKET,
+                                     G_CALLBACK(on_event_client), &error);
+  GSocketService *requests =
+      events ? listen_on(dir, HYPRLAND_REQUEST_SOCKET,
+                         G_CALLBACK(on_request_client), &error)
+             : NULL;
+  if (!requests) {
+    g_printerr("Could not listen in %s: %s\n", dir, error->message);
+    return 1;
+  }
+
+  printf("Recording to %s, run cWidgets with\n"
+         "  HYPRLAND_INSTANCE_SIGNATURE=%s\n",
+         output_path, signature);
+
+  GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
+  g_unix_signal_add(SIGINT, on_signal, main_loop);
+  g_unix_signal_add(SIGTERM, on_signal, main_loop);
+  g_main_loop_run(main_loop);
+
+  g_socket_service_stop(events);
+  g_socket_service_stop(requests);
+  g_socket_listener_close(G_SOCKET_LISTENER(events));
+  g_socket_listener_close(G_SOCKET_LISTENER(requests));
+
+  g_mutex_lock(&recorder.lock);
+  g_output_stream_close(recorder.out, NULL, NULL);
+  recorder.failed = TRUE; // Threads still forwarding must not write anymore
+  g_mutex_unlock(&recorder.lock);
+
+  g_autofree gchar *event_path =
+      g_build_filename(dir, HYPRLAND_EVENT_SOCKET, NULL);
+  g_autofree gchar *request_path =
+      g_build_filename(dir, HYPRLAND_REQUEST_SOCKET, NULL);
+  g_unlink(event_path);
+  g_unlink(request_path);
+  g_rmdir(dir);
+  g_main_loop_unref(main_loop);
+  return 0;
+}
@@ -0,0 +1,306 @@
+#include "mock.h"
+#include "recording.h"
+#include "socket.h"
+#include <errno.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#define READ_CHUNK 8192
+#define TICK_MS 1
+
+/*
+ * Stands in for hyprland on $XDG_RUNTIME_DIR/hypr/$HYPRLAND_INSTANCE_SIGNATURE.
+ * Requests on .socket.sock are answered with the recorded replies, and the
+ * recorded events are written to every client of .socket2.sock.
+ *
+ * Everything runs on the given main context, so the mock can live on its own
+ * thread next to the client it is measuring.
+ */
+struct _HyprlandMock {
+  HyprlandRecording *recording;
+  GMainContext *context;
+  gchar *dir;
+  gchar *event_path;
+  gchar *request_path;
+  GSocket *event_listener;
+  GSocket *request_listener;
+  GSource *event_source;
+  GSource *request_source;
+  GSource *tick_source;
+  GPtrArray *clients; // GSocket on .socket2.sock
+  // The events sent in one tick, reused
+  GString *batch;
+
+  // Set by hyprland_mock_replay
+  gboolean replay_requested;
+  guint rate;
+  guint64 n_events;
+  gint64 *sent_at;
+
+  guint64 sent;
+  gint64 start_time;
+  // Length of one pass through the recording with the recorded timing
+  gint64 duration;
+};
+
+static gboolean send_all(GSocket *socket, const gchar *data, gsize len) {
+  while (len > 0) {
+    gssize written = g_socket_send(socket, data, len, NULL, NULL);
+    if (written <= 0)
+      return FALSE;
+    data += written;
+    len -= written;
+  }
+  return TRUE;
+}
+
+// Microseconds after the start of the replay when the event is due
+static gint64 mock_event_due(HyprlandMock *mock, guint64 index) {
+  if (mock->rate > 0)
+    return index * G_USEC_PER_SEC / mock->rate;
+
+  guint n = hyprland_recording_get_n_events(mock->recording);
+  const HyprlandRecord *first = hyprland_recording_get_event(mock->recording, 0);
+  const HyprlandRecord *event =
+      hyprland_recording_get_event(mock->recording, index % n);
+  return (index / n) * mock->duration + event->time - first->time;
+}
+
+static gboolean on_tick(gpointer user_data) {
+  HyprlandMock *mock = user_data;
+  guint n = hyprland_recording_get_n_events(mock->recording);
+  gint64 now = g_get_monotonic_time();
+  gint64 elapsed = now - mock->start_time;
+  guint64 first = mock->sent;
+
+  g_string_truncate(mock->batch, 0);
+  while (mock->sent < mock->n_events &&
+         mock_event_due(mock, mock->sent) <= elapsed) {
+    const HyprlandRecord *event =
+        hyprland_recording_get_event(mock->recording, mock->sent % n);
+    g_string_append_len(mock->batch, event->data, event->len);
+    g_string_append_c(mock->batch, '\n');
+    mock->sent++;
+  }
+
+  if (mock->sent_at) {
+    for (guint64 i = first; i < mock->sent; i++)
+      mock->sent_at[i] = now;
+  }
+
+  for (guint i = 0; i < mock->clients->len && mock->batch->len > 0;) {
+    GSocket *client = g_ptr_array_index(mock->clients, i);
+    if (send_all(client, mock->batch->str, mock->batch->len))
+      i++;
+    else
+      g_ptr_array_remove_index_fast(mock->clients, i);
+  }
+
+  if (mock->sent < mock->n_events)
+    return G_SOURCE_CONTINUE;
+
+  g_clear_pointer(&mock->tick_source, g_source_unref);
+  return G_SOURCE_REMOVE;
+}
+
+static void mock_start_ticking(HyprlandMock *mock) {
+  if (mock->tick_source || mock->clients->len == 0)
+    return;
+
+  guint n = hyprland_recording_get_n_events(mock->recording);
+  if (n == 0) {
+    g_warning("Recording has no events to replay");
+    return;
+  }
+
+  const HyprlandRecord *first = hyprland_recording_get_event(mock->recording, 0);
+  const HyprlandRecord *last =
+      hyprland_recording_get_event(mock->recording, n - 1);
+  mock->duration = last->time - first->time + TICK_MS * 1000;
+  mock->start_time = g_get_monotonic_time();
+
+  mock->tick_source = g_timeout_source_new(TICK_MS);
+  g_source_set_callback(mock->tick_source, on_tick, mock, NULL);
+  g_source_attach(mock->tick_source, mock->context);
+}
+
+static gboolean on_event_client(GSocket *listener, GIOCondition condition,
+                                gpointer user_data) {
+  HyprlandMock *mock = user_data;
+  GSocket *client;
+
+  while ((client = g_socket_accept(listener, NULL, NULL))) {
+    // A slow client slows the replay down instead of losing events
+    g_socket_set_blocking(client, TRUE);
+    g_ptr_array_add(mock->clients, client);
+  }
+
+  if (mock->replay_requested)
+    mock_start_ticking(mock);
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_request_client(GSocket *listener, GIOCondition condition,
+                                  gpointer user_data) {
+  HyprlandMock *mock = user_data;
+  GSocket *client;
+
+  while ((client = g_socket_accept(listener, NULL, NULL))) {
+    gchar request[READ_CHUNK];
+
+    // Like hyprland, the request is read with a single read
+    g_socket_set_blocking(client, TRUE);
+    g_socket_set_timeout(client, 1);
+    gssize len = g_socket_receive(client, request, sizeof(request) - 1, NULL,
+                                  NULL);
+    if (len > 0) {
+      request[len] = '\0';
+      const HyprlandRecord *reply =
+          hyprland_recording_next_reply(mock->recording, request);
+      if (reply)
+        send_all(client, reply->data, reply->len);
+      else if (g_str_has_prefix(request, "dispatch"))
+        send_all(client, "ok", 2);
+      else
+        send_all(client, "unknown request", 15);
+    }
+
+    g_socket_close(client, NULL);
+    g_object_unref(client);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static GSocket *mock_listen(const gchar *path, GError **error) {
+  g_unlink(path);
+
+  GSocket *socket = g_socket_new(G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM,
+                                 G_SOCKET_PROTOCOL_DEFAULT, error);
+  if (!socket)
+    return NULL;
+
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new(path);
+  if (!g_socket_bind(socket, address, TRUE, error) ||
+      !g_socket_listen(socket, error)) {
+    g_object_unref(socket);
+    return NULL;
+  }
+
+  g_socket_set_blocking(socket, FALSE);
+  return socket;
+}
+
+static GSource *mock_watch(HyprlandMock *mock, GSocket *socket,
+                           GSocketSourceFunc func) {
+  GSource *source = g_socket_create_source(socket, G_IO_IN, NULL);
+  g_source_set_callback(source, G_SOURCE_FUNC(func), mock, NULL);
+  g_source_attach(source, mock->context);
+  return source;
+}
+
+/*
+ * Creates the hyprland sockets for the current environment and starts
+ * answering requests. Events are only sent after hyprland_mock_replay.
+ *
+ * The recording has to outlive the mock
+ */
+HyprlandMock *hyprland_mock_new(HyprlandRecording *recording,
+                                GMainContext *context, GError **error) {
+  g_autofree gchar *event_path = hyprland_socket_path(HYPRLAND_EVENT_SOCKET);
+  if (!event_path) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                        "Hyprland environment variables not set");
+    return NULL;
+  }
+
+  HyprlandMock *mock = g_new0(HyprlandMock, 1);
+  mock->recording = recording;
+  mock->context = g_main_context_ref(context);
+  mock->clients = g_ptr_array_new_with_free_func(g_object_unref);
+  mock->batch = g_string_new(NULL);
+  mock->event_path = g_steal_pointer(&event_path);
+  mock->request_path = hyprland_socket_path(HYPRLAND_REQUEST_SOCKET);
+  mock->dir = g_path_get_dirname(mock->event_path);
+
+  if (g_mkdir_with_parents(mock->dir, 0700) < 0) {
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                "Could not create %s: %s", mock->dir, g_strerror(errno));
+    hyprland_mock_free(mock);
+    return NULL;
+  }
+
+  mock->event_listener = mock_listen(mock->event_path, error);
+  if (!mock->event_listener) {
+    hyprland_mock_free(mock);
+    return NULL;
+  }
+  mock->request_listener = mock_listen(mock->request_path, error);
+  if (!mock->request_listener) {
+    hyprland_mock_free(mock);
+    return NULL;
+  }
+
+  mock->event_source = mock_watch(mock, mock->event_listener, on_event_client);
+  mock->request_source =
+      mock_watch(mock, mock->request_listener, on_request_client);
+  return mock;
+}
+
+static gboolean mock_replay(gpointer user_data) {
+  HyprlandMock *mock = user_data;
+  mock->replay_requested = TRUE;
+  mock_start_ticking(mock);
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Sends n_events events from the recording, starting over at the end,
+ * at rate events per second or with the recorded timing if rate is 0.
+ * The replay starts once a client is connected to the event socket.
+ *
+ * If sent_at is not NULL it has room for n_events and gets the monotonic time
+ * each event was sent at.
+ *
+ * Can be called from any thread
+ */
+void hyprland_mock_replay(HyprlandMock *mock, guint rate, guint64 n_events,
+                          gint64 *sent_at) {
+  mock->rate = rate;
+  mock->n_events = n_events;
+  mock->sent_at = sent_at;
+  mock->sent = 0;
+  g_main_context_invoke(mock->context, mock_replay, mock);
+}
+
+static void mock_source_clear(GSource **source) {
+  if (!*source)
+    return;
+  g_source_destroy(*source);
+  g_clear_pointer(source, g_source_unref);
+}
+
+void hyprland_mock_free(HyprlandMock *mock) {
+  if (!mock)
+    return;
+
+  mock_source_clear(&mock->tick_source);
+  mock_source_clear(&mock->event_source);
+  mock_source_clear(&mock->request_source);
+  g_clear_object(&mock->event_listener);
+  g_clear_object(&mock->request_listener);
+  g_ptr_array_unref(mock->clients);
+
+  g_unlink(mock->event_path);
+  g_unlink(mock->request_path);
+  g_rmdir(mock->dir);
+
+  g_string_free(mock->batch, TRUE);
+  g_main_context_unref(mock->context);
+  g_free(mock->event_path);
+  g_free(mock->request_path);
+  g_free(mock->dir);
+  g_free(mock);
+}
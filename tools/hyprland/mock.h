@@ -0,0 +1,15 @@
+#ifndef HYPRLAND_MOCK_H
+#define HYPRLAND_MOCK_H
+
+#include "recording.h"
+#include <glib.h>
+
+typedef struct _HyprlandMock HyprlandMock;
+
+HyprlandMock *hyprland_mock_new(HyprlandRecording *recording,
+                                GMainContext *context, GError **error);
+void hyprland_mock_replay(HyprlandMock *mock, guint rate, guint64 n_events,
+                          gint64 *sent_at);
+void hyprland_mock_free(HyprlandMock *mock);
+
+#endif // !HYPRLAND_MOCK_H
@@ -0,0 +1,265 @@
+#include "recording.h"
+#include "state.h"
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SYNTHETIC_MONITOR "BENCH-1"
+#define SYNTHETIC_WORKSPACES 5
+#define SYNTHETIC_STEP_US 1000
+
+static const gchar *const kind_names[] = {
+    [HYPRLAND_RECORD_EVENT] = "event",
+    [HYPRLAND_RECORD_REQUEST] = "request",
+    [HYPRLAND_RECORD_REPLY] = "reply",
+};
+
+// The replies recorded for one request, handed out in order and then again
+typedef struct {
+  GPtrArray *replies; // HyprlandRecord
+  guint next;
+} Exchange;
+
+struct _HyprlandRecording {
+  gchar *contents;
+  GArray *events;       // HyprlandRecord
+  GHashTable *requests; // request -> Exchange
+};
+
+static void exchange_free(gpointer data) {
+  Exchange *exchange = data;
+  g_ptr_array_unref(exchange->replies);
+  g_free(exchange);
+}
+
+static gboolean parse_kind(const gchar *name, HyprlandRecordKind *kind) {
+  for (guint i = 0; i < G_N_ELEMENTS(kind_names); i++) {
+    if (g_str_equal(kind_names[i], name)) {
+      *kind = i;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+// Takes ownership of contents, the records point into it
+static HyprlandRecording *hyprland_recording_parse(gchar *contents, gsize len,
+                                                   GError **error) {
+  HyprlandRecording *recording = g_new0(HyprlandRecording, 1);
+  recording->contents = contents;
+  recording->events = g_array_new(FALSE, FALSE, sizeof(HyprlandRecord));
+  recording->requests =
+      g_hash_table_new_full(g_str_hash, g_str_equal, NULL, exchange_free);
+
+  gchar *pos = contents;
+  gchar *end = contents + len;
+  const gchar *request = NULL;
+
+  if (g_str_has_prefix(pos, HYPRLAND_RECORDING_HEADER))
+    pos += strlen(HYPRLAND_RECORDING_HEADER);
+
+  while (pos < end) {
+    gchar *newline = memchr(pos, '\n', end - pos);
+    if (!newline)
+      break;
+    *newline = '\0';
+
+    gchar name[16] = {0};
+    gint64 time = 0;
+    guint64 size = 0;
+    HyprlandRecordKind kind;
+    if (sscanf(pos, "%15s %" G_GINT64_FORMAT " %" G_GUINT64_FORMAT, name,
+               &time, &size) != 3 ||
+        !parse_kind(name, &kind) || size > (guint64)(end - newline - 1)) {
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                  "Invalid record at byte %td", pos - contents);
+      hyprland_recording_free(recording);
+      return NULL;
+    }
+
+    HyprlandRecord record = {.time = time, .data = newline + 1, .len = size};
+    pos = newline + 1 + size;
+    *pos++ = '\0'; // Replaces the newline after the payload
+
+    switch (kind) {
+    case HYPRLAND_RECORD_EVENT:
+      g_array_append_val(recording->events, record);
+      break;
+    case HYPRLAND_RECORD_REQUEST:
+      request = record.data;
+      break;
+    case HYPRLAND_RECORD_REPLY: {
+      if (!request)
+        break; // Reply without request, the recording started mid request
+      Exchange *exchange = g_hash_table_lookup(recording->requests, request);
+      if (!exchange) {
+        exchange = g_new0(Exchange, 1);
+        exchange->replies = g_ptr_array_new_with_free_func(g_free);
+        g_hash_table_insert(recording->requests, (gpointer)request, exchange);
+      }
+      g_ptr_array_add(exchange->replies, g_memdup2(&record, sizeof(record)));
+      request = NULL;
+      break;
+    }
+    }
+  }
+
+  return recording;
+}
+
+/*
+ * Loads a recording made by hyprland-record
+ *
+ * Ownership is given to caller
+ */
+HyprlandRecording *hyprland_recording_load(const gchar *path, GError **error) {
+  gchar *contents = NULL;
+  gsize len = 0;
+
+  if (!g_file_get_contents(path, &contents, &len, error))
+    return NULL;
+  return hyprland_recording_parse(contents, len, error);
+}
+
+static void append_record(GString *out, HyprlandRecordKind kind, gint64 time,
+                          const gchar *data) {
+  g_string_append_printf(out, "%s %" G_GINT64_FORMAT " %zu\n%s\n",
+                         kind_names[kind], time, strlen(data), data);
+}
+
+static void append_sync_reply(GString *out) {
+  g_autoptr(GString) request = g_string_new("[[BATCH]]");
+  for (guint i = 0; hyprland_state_sync_requests[i]; i++) {
+    if (i > 0)
+      g_string_append_c(request, ';');
+    g_string_append(request, hyprland_state_sync_requests[i]);
+  }
+
+  g_autoptr(GString) reply = g_string_new(NULL);
+  g_string_append(reply,
+                  "[{\"id\": 0, \"name\": \"" SYNTHETIC_MONITOR "\", "
+                  "\"activeWorkspace\": {\"id\": 1, \"name\": \"1\"}, "
+                  "\"focused\": true}]\n\n\n[");
+  for (guint id = 1; id <= SYNTHETIC_WORKSPACES; id++) {
+    g_string_append_printf(reply,
+                           "%s{\"id\": %u, \"name\": \"%u\", "
+                           "\"monitor\": \"" SYNTHETIC_MONITOR "\", "
+                           "\"windows\": 1, "
+                           "\"lastwindowtitle\": \"%u\"}",
+                           id > 1 ? ", " : "", id, id, id);
+  }
+  g_string_append(reply, "]\n\n\n{\"id\": 1, \"name\": \"1\", "
+                         "\"monitor\": \"" SYNTHETIC_MONITOR "\"}\n\n\n[");
+  for (guint id = 1; id <= SYNTHETIC_WORKSPACES; id++) {
+    g_string_append_printf(reply,
+                           "%s{\"address\": \"0x%x\", \"mapped\": true, "
+                           "\"workspace\": {\"id\": %u, \"name\": \"%u\"}, "
+                           "\"class\": \"kitty\", \"fullscreen\": 0}",
+                           id > 1 ? ", " : "", 0x1000 + id, id, id);
+  }
+  g_string_append(reply, "]\n\n\n{\"address\": \"0x1001\", "
+                         "\"class\": \"kitty\", \"title\": \"~\", "
+                         "\"fullscreen\": 0}");
+
+  append_record(out, HYPRLAND_RECORD_REQUEST, 0, request->str);
+  append_record(out, HYPRLAND_RECORD_REPLY, 0, reply->str);
+
+  // Asked for the mode after fullscreen>>1, always the firefox of the cycle
+  append_record(out, HYPRLAND_RECORD_REQUEST, 0, "j/activewindow");
+  append_record(out, HYPRLAND_RECORD_REPLY, 0,
+                "{\"address\": \"0x5a1b2c3d\", \"class\": \"firefox\", "
+                "\"title\": \"Mozilla Firefox\", \"fullscreen\": 2}");
+}
+
+/*
+ * Generated traffic for benchmarks without a recording: one monitor with a
+ * few workspaces, and n_cycles rounds of switching, creating, renaming,
+ * going fullscreen in and destroying a workspace. Every cycle ends in the
+ * state it started from.
+ *
+ * Ownership is given to caller
+ */
+HyprlandRecording *hyprland_recording_new_synthetic(guint n_cycles) {
+  static const gchar *const cycle[] = {
+      "workspacev2>>2,2",
+      "activewindow>>kitty,~/src/cWidgets",
+      "createworkspacev2>>6,6",
+      "workspacev2>>6,6",
+      "openwindow>>5a1b2c3d,6,firefox,Mozilla Firefox",
+      "activewindow>>firefox,Mozilla Firefox",
+      "fullscreen>>1",
+      "renameworkspace>>6,web",
+      "fullscreen>>0",
+      "workspacev2>>1,1",
+      "closewindow>>5a1b2c3d",
+      "destroyworkspacev2>>6,web",
+      "focusedmonv2>>" SYNTHETIC_MONITOR ",1",
+      "activewindow>>kitty,~",
+  };
+
+  GString *out = g_string_new(HYPRLAND_RECORDING_HEADER);
+  append_sync_reply(out);
+
+  gint64 time = 0;
+  for (guint i = 0; i < n_cycles; i++) {
+    for (guint j = 0; j < G_N_ELEMENTS(cycle); j++) {
+      time += SYNTHETIC_STEP_US;
+      append_record(out, HYPRLAND_RECORD_EVENT, time, cycle[j]);
+    }
+  }
+
+  gsize len = out->len;
+  return hyprland_recording_parse(g_string_free(out, FALSE), len, NULL);
+}
+
+void hyprland_recording_free(HyprlandRecording *recording) {
+  if (!recording)
+    return;
+  g_array_unref(recording->events);
+  g_hash_table_unref(recording->requests);
+  g_free(recording->contents);
+  g_free(recording);
+}
+
+guint hyprland_recording_get_n_events(HyprlandRecording *recording) {
+  return recording->events->len;
+}
+
+const HyprlandRecord *hyprland_recording_get_event(HyprlandRecording *recording,
+                                                   guint index) {
+  return &g_array_index(recording->events, HyprlandRecord, index);
+}
+
+/*
+ * The next recorded reply to request, replies to the same request are
+ * returned in the order they were recorded and start over after the last
+ *
+ * Returns NULL if the request was never recorded
+ */
+const HyprlandRecord *hyprland_recording_next_reply(HyprlandRecording *recording,
+                                                    const gchar *request) {
+  Exchange *exchange = g_hash_table_lookup(recording->requests, request);
+  if (!exchange)
+    return NULL;
+
+  const HyprlandRecord *reply = g_ptr_array_index(exchange->replies,
+                                                  exchange->next);
+  exchange->next = (exchange->next + 1) % exchange->replies->len;
+  return reply;
+}
+
+// Appends one record to a recording file
+gboolean hyprland_recording_write(GOutputStream *out, HyprlandRecordKind kind,
+                                  gint64 time, const gchar *data, gsize len,
+                                  GError **error) {
+  gchar header[64];
+  gint header_len = g_snprintf(header, sizeof(header),
+                               "%s %" G_GINT64_FORMAT " %" G_GSIZE_FORMAT "\n",
+                               kind_names[kind], time, len);
+
+  return g_output_stream_write_all(out, header, header_len, NULL, NULL,
+                                   error) &&
+         g_output_stream_write_all(out, data, len, NULL, NULL, error) &&
+         g_output_stream_write_all(out, "\n", 1, NULL, NULL, error);
+}
@@ -0,0 +1,50 @@
+#ifndef HYPRLAND_RECORDING_H
+#define HYPRLAND_RECORDING_H
+
+#include <gio/gio.h>
+#include <glib.h>
+
+/*
+ * Captured hyprland socket traffic.
+ *
+ * The file is a header line followed by records of the form
+ *
+ *   KIND TIME LENGTH\n
+ *   PAYLOAD\n
+ *
+ * where KIND is "event", "request" or "reply", TIME is in microseconds since
+ * the recording started and PAYLOAD is LENGTH raw bytes. An event is one line
+ * from .socket2.sock without the newline, a reply always follows its request.
+ */
+#define HYPRLAND_RECORDING_HEADER "# cwidgets hyprland recording v1\n"
+
+typedef enum {
+  HYPRLAND_RECORD_EVENT,
+  HYPRLAND_RECORD_REQUEST,
+  HYPRLAND_RECORD_REPLY,
+} HyprlandRecordKind;
+
+typedef struct {
+  gint64 time;
+  // Points into the recording and is NUL terminated
+  const gchar *data;
+  gsize len;
+} HyprlandRecord;
+
+typedef struct _HyprlandRecording HyprlandRecording;
+
+HyprlandRecording *hyprland_recording_load(const gchar *path, GError **error);
+HyprlandRecording *hyprland_recording_new_synthetic(guint n_cycles);
+void hyprland_recording_free(HyprlandRecording *recording);
+
+guint hyprland_recording_get_n_events(HyprlandRecording *recording);
+const HyprlandRecord *hyprland_recording_get_event(HyprlandRecording *recording,
+                                                   guint index);
+const HyprlandRecord *hyprland_recording_next_reply(HyprlandRecording *recording,
+                                                    const gchar *request);
+
+gboolean hyprland_recording_write(GOutputStream *out, HyprlandRecordKind kind,
+                                  gint64 time, const gchar *data, gsize len,
+                                  GError **error);
+
+#endif // !HYPRLAND_RECORDING_H